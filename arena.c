@@ -0,0 +1,177 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "arena.h"
+#include <string.h>
+
+
+#define	ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+// Room taken by the header of a block, keeping its data aligned.
+#define	ARENA_HEADER ARENA_ROUND(sizeof(arenablock_t))
+
+/**
+ * Chains to `a' a new block of at least `size' bytes, making it the current
+ * one.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_arena_add_block(arena_t *a, size_t size);
+
+
+arena_t* n2t_arena_alloc(size_t capacity) {
+	arena_t *o;
+
+	if ((o = malloc(sizeof(arena_t))) == NULL)
+		return NULL;
+
+	o->block = NULL;
+	o->next = o->end = o->last = NULL;
+	o->capacity = o->used = o->nblocks = 0;
+
+	if (n2t_arena_add_block(o, capacity)) {
+		free(o);
+		return NULL;
+	}
+
+	return o;
+}
+
+void* n2t_arena_push(arena_t *a, size_t size) {
+	size_t const rounded = ARENA_ROUND(size);
+
+	if (rounded < size)
+		return NULL;
+
+	// Geometric growth keeps the number of blocks logarithmic in the total.
+	if (
+		rounded > (size_t) (a->end - a->next) &&
+		n2t_arena_add_block(a, rounded > a->capacity ? rounded: a->capacity)
+	)
+		return NULL;
+
+	a->last = a->next;
+	a->next += rounded;
+	a->used += rounded;
+
+	return a->last;
+}
+
+void* n2t_arena_zeroed(arena_t *a, size_t n, size_t size) {
+	void *p;
+
+	if (size > 0 && n > SIZE_MAX / size)
+		return NULL;
+
+	if ((p = n2t_arena_push(a, n * size)) != NULL)
+		memset(p, 0, n * size);
+
+	return p;
+}
+
+void* n2t_arena_resize(arena_t *a, void *p, size_t size, size_t new_size) {
+	size_t const rounded = ARENA_ROUND(size);
+	size_t const new_rounded = ARENA_ROUND(new_size);
+	void *q;
+
+	if (p == NULL)
+		return n2t_arena_push(a, new_size);
+	if (new_rounded <= rounded)
+		return p;
+
+	if (
+		p == a->last &&
+		new_rounded - rounded <= (size_t) (a->end - a->next)
+	) {
+		a->next += new_rounded - rounded;
+		a->used += new_rounded - rounded;
+
+		return p;
+	}
+
+	if ((q = n2t_arena_push(a, new_size)) != NULL)
+		memcpy(q, p, size);
+
+	return q;
+}
+
+void n2t_arena_reset(arena_t *a) {
+	arenablock_t *b, *prev;
+	size_t const capacity = a->capacity;
+
+	// An arena left without blocks by a failed reset gets one on its next push.
+	if (a->block != NULL && a->block->prev != NULL) {
+		for (b = a->block; b != NULL; b = prev) {
+			prev = b->prev;
+			free(b);
+		}
+
+		a->block = NULL;
+		a->capacity = 0;
+
+		// Without room for a single block, a smaller one still serves.
+		if (
+			n2t_arena_add_block(a, capacity) &&
+			n2t_arena_add_block(a, ARENA_MIN_BLOCK)
+		) {
+			a->next = a->end = NULL;
+		}
+	}
+
+	if (a->block != NULL)
+		a->next = (char*) a->block + ARENA_HEADER;
+
+	a->last = NULL;
+	a->used = 0;
+}
+
+void n2t_arena_free(arena_t *a) {
+	arenablock_t *b, *prev;
+
+	for (b = a->block; b != NULL; b = prev) {
+		prev = b->prev;
+		free(b);
+	}
+
+	free(a);
+}
+
+
+static int n2t_arena_add_block(arena_t *a, size_t size) {
+	arenablock_t *b;
+
+	size = ARENA_ROUND(size < ARENA_MIN_BLOCK ? ARENA_MIN_BLOCK: size);
+
+	if (size > SIZE_MAX - ARENA_HEADER)
+		return 1;
+	if ((b = malloc(ARENA_HEADER + size)) == NULL)
+		return 1;
+
+	b->prev = a->block;
+	b->size = size;
+
+	a->block = b;
+	a->next = (char*) b + ARENA_HEADER;
+	a->end = a->next + size;
+	a->capacity += size;
+	a->nblocks++;
+
+	return 0;
+}
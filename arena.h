@@ -0,0 +1,97 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+
+// Alignment of every allocation, enough for any type the assembler stores.
+#define	ARENA_ALIGN 16
+// Smallest block an `arena_t' allocates.
+#define	ARENA_MIN_BLOCK (64 * 1024)
+
+/**
+ * A block of memory of an `arena_t', `size' bytes long once past its header.
+ * Blocks are chained from the newest one to the oldest.
+ */
+typedef struct arenablock {
+	struct arenablock *prev;
+	size_t size;
+} arenablock_t;
+
+/**
+ * A bump-pointer allocator: objects are carved out of `block' one after the
+ * other, from `next' up to `end', and released all at once. A full block is
+ * followed by one at least as large as all the previous ones together.
+ *
+ * `last' is the most recent allocation, the only one that can grow in place.
+ * `capacity' sums up the sizes of the blocks, `used' the bytes handed out
+ * since the last reset and `nblocks' the blocks ever allocated.
+ *
+ * An `arena_t' is not thread-safe.
+ */
+typedef struct {
+	arenablock_t *block;
+	char *next, *end, *last;
+	size_t capacity, used, nblocks;
+} arena_t;
+
+
+/**
+ * Allocates an arena whose first block holds at least `capacity' bytes.
+ *
+ * Returns: the arena, or `NULL' if an error occurs.
+ */
+arena_t* n2t_arena_alloc(size_t capacity);
+/**
+ * Reserves `size' bytes of `a', aligned to `ARENA_ALIGN'. Their contents are
+ * undefined.
+ *
+ * Returns: a pointer to them, or `NULL' if an error occurs.
+ */
+void* n2t_arena_push(arena_t *a, size_t size);
+/**
+ * Same as `n2t_arena_push()', for `n' objects of `size' bytes each, all
+ * initialized to zero.
+ */
+void* n2t_arena_zeroed(arena_t *a, size_t n, size_t size);
+/**
+ * Grows to `new_size' bytes the allocation of `size' bytes at `p', which is
+ * extended in place if it is the last one made from `a' and there is room
+ * for it, and moved otherwise.
+ *
+ * Returns: a pointer to the allocation, or `NULL' if an error occurs, in
+ * which case `p' is left untouched.
+ */
+void* n2t_arena_resize(arena_t *a, void *p, size_t size, size_t new_size);
+/**
+ * Releases every allocation of `a' at once. Should `a' span several blocks,
+ * they are replaced by a single one as large as all of them, so that the
+ * same work fits in it without further allocations the next time.
+ */
+void n2t_arena_reset(arena_t *a);
+void n2t_arena_free(arena_t *a);
+
+
+#endif
@@ -21,73 +21,1748 @@
 // SOFTWARE.
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <glob.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <signal.h>
 #include "lexer.h"
 #include "parser.h"
+#include "romimage.h"
+#include "hackasm.h"
+#include "pool.h"
+#include "hash.h"
+#include "cache.h"
+#include "incremental.h"
+#include "arena.h"
+#include "stats.h"
+
+
+#define	OPT_PREDEF "--predef"
+#define	OPT_STATS "--stats"
+#define	OPT_FORMAT "--format"
+#define	OPT_ENDIAN "--endian"
+#define	OPT_HEADER "--header"
+#define	OPT_STREAM "--stream"
+#define	OPT_THREADS "--threads"
+#define	OPT_JOBS "--jobs"
+#define	OPT_SERVE "--serve"
+#define	OPT_CONNECT "--connect"
+#define	OPT_CACHE "--cache"
+#define	OPT_CACHE_LIMIT "--cache-limit"
+#define	OPT_INCREMENTAL "--incremental"
+
+// Appended to the path of an output to name its incremental state.
+#define	STATE_EXTENSION ".state"
+
+// Seconds a connection to the daemon may stay idle before being closed.
+#define	SERVER_IDLE_TIMEOUT 10
+// Largest inline source accepted by the daemon, in bytes.
+#define	SERVER_MAX_SOURCE (1UL << 30)
+// Number of requests a client has the daemon serve at once.
+#define	CLIENT_WINDOW 64
+
+// Forms of the report printed by `OPT_STATS'.
+#define	REPORT_TEXT 1
+#define	REPORT_JSON 2
+
+#define	USAGE "[" OPT_PREDEF " NAME=ADDR]... [" OPT_STATS "[=json]] " \
+	"[" OPT_JOBS "=N] [" OPT_STREAM " | [" OPT_THREADS "=N] " \
+	"[" OPT_CACHE "=DIR [" OPT_CACHE_LIMIT "=SIZE] | " OPT_INCREMENTAL "]] " \
+	"[" OPT_FORMAT "=hack|bin [" OPT_ENDIAN "=little|big] [" OPT_HEADER "]] " \
+	"<file, directory or pattern>..."
+#define	USAGE_SERVE "[<options>]... " OPT_SERVE " SOCKET"
+#define	USAGE_CONNECT "[" OPT_STATS "[=json]] " OPT_CONNECT " SOCKET " \
+	"<file, directory or pattern>..."
+
+/**
+ * Destination of the assembled program, as requested on the command line.
+ * `nwords' and `length' count the words and bytes written so far, `checksum'
+ * is that of the words written so far. If `fd' is `-1', the output is kept in
+ * memory at `data' instead, to be freed by the caller.
+ *
+ * While formatted by `n2t_output_tokenseq()', the output is held at `data',
+ * `capacity' bytes large, which maps the output file if `mapped' is set.
+ */
+typedef struct {
+	int fd;
+	emitopts_t format;
+
+	size_t nwords, length;
+	uint32_t checksum;
+	char *data;
+	size_t capacity;
+	int mapped;
+} output_t;
+
+/**
+ * Settings shared by all the files assembled by a single invocation. `salt'
+ * sums up those affecting the output. If `cache' is not `NULL', outputs are
+ * first looked up there by the contents of their source and by `salt'. If
+ * `incremental' is set, the state of each assembly is kept alongside its
+ * output, for the next one to start from. If `stats' is set, the statistics
+ * of each assembly are collected.
+ */
+typedef struct {
+	parseopts_t opts;
+	emitopts_t format;
+	int stream, incremental, stats;
+	cache_t *cache;
+	uint64_t salt;
+} settings_t;
+
+/**
+ * A source file to assemble into `output_path' and the outcome of its
+ * assembly: if it fails, `error' is set and `errmsg' tells why, otherwise
+ * `nwords' and `length' count the words and bytes written. `size' is that of
+ * the source file, `-1' if it cannot be read.
+ *
+ * If `source' is not `NULL', the program is read from its `source_length'
+ * bytes rather than from `input'. If `output_path' is empty, the output is
+ * kept at `result' rather than written to a file.
+ */
+typedef struct {
+	char *input, *source, *result;
+	char output_path[PATH_MAX], errmsg[BUFFSIZE_VLARGE];
+	settings_t const *settings;
+	off_t size;
+	size_t source_length;
+	int error;
+	size_t nwords, length;
+	// Lines of the source and lines scanned, then instructions written, by
+	// an incremental assembly.
+	size_t nlines, nscanned, nrewritten;
+	asmstats_t stats;
+} asmfile_t;
+
+/**
+ * A client connection accepted by `n2t_serve()'. Its requests are read from
+ * `fd' and answered in turn until the client closes it, with the following
+ * line-based protocol:
+ *
+ * 	request     = source destination
+ * 	source      = "PATH " path "\n" | "SOURCE " length "\n" bytes
+ * 	destination = "PATH " path "\n" | "STEM " path "\n" | "INLINE\n"
+ * 	response    = "OK " nwords " " length [" " path] "\n" [bytes] |
+ * 	              "ERROR " message "\n"
+ *
+ * A `SOURCE' line is followed by the `length' bytes of the program. A `STEM'
+ * destination is completed with the extension of the format of the daemon.
+ * Outputs written to a file are named by the `OK' line. With an `INLINE'
+ * destination, the `length' bytes of the output follow the `OK' line instead
+ * of being written to a file.
+ */
+typedef struct {
+	int fd;
+	settings_t const *settings;
+} connection_t;
+
+// Cleared by `n2t_stop_serving()' to stop the daemon.
+static volatile sig_atomic_t serving = 1;
+// The arena of each thread assembling files, kept from one file to the next.
+static pthread_key_t arena_key;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+static int arena_keyed = 0;
+
+/**
+ * A `wordsink_t' formatting and writing `words' to the `output_t' pointed to
+ * by `output', as `n2t_parse_stream()' produces them.
+ */
+static int n2t_output_stream(word_t const *words, size_t n, void *output);
+/**
+ * Completes an output produced through `n2t_output_stream()', filling in the
+ * image header if requested.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_output_finish(output_t *o);
+/**
+ * Assembles the whole of `s' into `o' with `nthreads' threads, through
+ * `n2t_emit_tokenseq()'. With several threads, the output file is memory
+ * mapped for them to format their shares of instructions in place. Otherwise,
+ * the output is formatted in memory and written with a single write.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_output_tokenseq(
+	output_t *o, tokenseq_t const *s, unsigned nthreads
+);
+/**
+ * An `emitreserve_t' making room for the `length' bytes of the `output_t' at
+ * `output', mapping its file if it is to be mapped.
+ */
+static char* n2t_output_reserve(size_t length, void *output);
+/**
+ * Pool task assembling the `asmfile_t' at `file' into its output file.
+ */
+static void n2t_assemble_file(void *file);
+/**
+ * Assembles `f' through the cache of its settings: its output is copied from
+ * the cache if there, otherwise assembled in memory and stored into the cache.
+ * The output file is only written if its contents change.
+ */
+static void n2t_assemble_cached(asmfile_t *f);
+/**
+ * Assembles `f' starting from the state of its last assembly, if any, saved
+ * alongside its output. Only the changed lines are scanned again and, if the
+ * number of instructions is unchanged, only the changed instructions are
+ * written, in place. The state is then saved for the next assembly.
+ */
+static void n2t_assemble_incremental(asmfile_t *f);
+/**
+ * Returns: the arena of the calling thread, emptied and holding at least
+ * `capacity' bytes in a single block, or `NULL' if it cannot be allocated.
+ * It is allocated on first use, replaced only by a larger one, and freed as
+ * the thread exits.
+ */
+static arena_t* n2t_thread_arena(size_t capacity);
+/**
+ * Creates `arena_key', once.
+ */
+static void n2t_create_arena_key(void);
+/**
+ * Frees the arena of the calling thread, if any.
+ */
+static void n2t_free_thread_arena(void);
+/**
+ * Writes into the output file `fd' the words of `s' differing from those of
+ * the previous assembly, which `fd' holds. `*nrewritten' receives the number
+ * of words written.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_patch_output(
+	int fd, asmstate_t const *s, settings_t const *settings,
+	size_t *nrewritten
+);
+/**
+ * Writes the whole program of `s' into the output file `fd', from scratch.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_rewrite_output(
+	int fd, asmstate_t const *s, settings_t const *settings
+);
+/**
+ * Returns: the salt of the cache keys and incremental states of the files
+ * assembled with `settings', telling apart outputs of the same source with
+ * different settings.
+ */
+static uint64_t n2t_settings_salt(settings_t const *settings);
+/**
+ * Returns: the extension of the output files of `format', such as ".hack".
+ */
+static char const* n2t_output_extension(emitopts_t const *format);
+/**
+ * Names the output file of `f' after its source file, in the current
+ * directory, with extension `extension'. `f' is marked as failed if it is not
+ * an assembly file.
+ */
+static void n2t_prepare_output(asmfile_t *f, char const *extension);
+/**
+ * Appends the files named by the command line argument `arg' to the `nfiles'
+ * ones at `files', which has room for `capacity' of them. `arg' is either
+ * a file, a directory whose `.asm' files are taken in name order, or a glob
+ * pattern matching any of those.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_add_inputs(
+	char *arg, asmfile_t **files, size_t *nfiles, size_t *capacity
+);
+/**
+ * As `n2t_add_inputs()', for the file or directory at `path'.
+ */
+static int n2t_add_path(
+	char const *path, asmfile_t **files, size_t *nfiles, size_t *capacity
+);
+/**
+ * As `n2t_add_inputs()', for the single file at `path'.
+ */
+static int n2t_add_file(
+	char const *path, asmfile_t **files, size_t *nfiles, size_t *capacity
+);
+/**
+ * Frees the `nfiles' files at `files', as listed by `n2t_add_inputs()'.
+ */
+static void n2t_free_inputs(asmfile_t *files, size_t nfiles);
+/**
+ * `scandir()' filter keeping the non hidden `.asm' files of a directory.
+ */
+static int n2t_is_asm_entry(struct dirent const *entry);
+/**
+ * `qsort()' comparator ordering pointers to `asmfile_t' by decreasing size.
+ */
+static int n2t_compare_sizes(void const *a, void const *b);
+/**
+ * Serves the assembly requests of `connection_t' clients on the Unix socket
+ * at `socket_path', `njobs' at a time (as many as processors if `0'), with
+ * `settings', until interrupted by `SIGINT' or `SIGTERM'. A socket left over
+ * by a previous daemon is replaced.
+ *
+ * Returns: `1' if an error occurs, described in `errmsg', `0' otherwise.
+ */
+static int n2t_serve(
+	char const *socket_path, settings_t const *settings, unsigned njobs,
+	char errmsg[], size_t maxwrite
+);
+/**
+ * Signal handler stopping `n2t_serve()'.
+ */
+static void n2t_stop_serving(int signum);
+/**
+ * Pool task answering the requests of the `connection_t' at `connection',
+ * then closing and freeing it.
+ */
+static void n2t_serve_connection(void *connection);
+/**
+ * Reads the next request from `in' into `dest', using the `*capacity' bytes
+ * at `*line' as line buffer. The source and input path of `dest' are
+ * allocated and must be freed by the caller. The settings of `dest' give the
+ * extension of a `STEM' destination.
+ *
+ * Returns: `0' on success, `-1' if the client has no more requests, `1' if the
+ * request is malformed, describing why in the error message of `dest'.
+ */
+static int n2t_read_request(
+	FILE *in, char **line, size_t *capacity, asmfile_t *dest
+);
+/**
+ * Has the daemon serving at `socket_path' assemble the `nfiles' files at
+ * `files', as `n2t_assemble_file()' would.
+ */
+static void n2t_request_files(
+	char const *socket_path, asmfile_t *files, size_t nfiles
+);
+/**
+ * Reads the response of the daemon to the request for `f' from `fd', which is
+ * closed afterwards.
+ */
+static void n2t_read_response(int fd, asmfile_t *f);
+/**
+ * Returns: a socket connected to `socket_path', or `-1' if an error occurs.
+ */
+static int n2t_connect(char const *socket_path);
+/**
+ * Parses a `NAME=ADDR' predefined variable specification, as given on the
+ * command line. `spec' is split in place.
+ *
+ * Returns: `1' if `spec' is malformed, `0' otherwise.
+ */
+static int n2t_parse_predef(char *spec, ramvar_t *dest);
+/**
+ * Returns: the value of `arg' if it has the form `<option>=<value>', `NULL'
+ * otherwise.
+ */
+static char* n2t_option_value(char *arg, char const *option);
+/**
+ * Parses a size in bytes such as `4096', `512K', `64M' or `2G'.
+ *
+ * Returns: `1' if `spec' is malformed, `0' otherwise.
+ */
+static int n2t_parse_size(char const *spec, uint64_t *dest);
+/**
+ * Prints to the standard output, as lines prefixed by `program', the
+ * statistics of the assembly of `f'.
+ */
+static void n2t_print_stats(char const *program, asmfile_t const *f);
+/**
+ * Prints to the standard output a JSON document reporting on the assembly of
+ * the `nfiles' files at `files', on `cache' unless `NULL', and on the peak
+ * memory use of the process.
+ */
+static void n2t_print_stats_json(
+	asmfile_t const *files, size_t nfiles, cache_t const *cache
+);
+/**
+ * Prints `s' to the standard output as a JSON string.
+ */
+static void n2t_print_json_string(char const *s);
 
 
 int main (int argc, char *argv[]) {
-	FILE *output;
-	char output_path[BUFFSIZE_LARGE], buff[BITSTR_BUFFSIZE];
-	tokenseq_t *s;
-	token_t *t;
-	size_t i;
+	char *spec, *value, *end, *serve = NULL, *connect_to = NULL;
+	char *cache_dir = NULL;
+	char errmsg[BUFFSIZE_VLARGE];
+	ramvar_t predefs[argc];
+	settings_t settings = {
+		{predefs, 0}, {0, 0, ROMIMAGE_LITTLE}, 0, 0, 0, NULL, 0
+	};
+	cache_t cache;
+	uint64_t cache_limit = CACHE_DEFAULT_LIMIT;
+	asmfile_t *files = NULL, **order;
+	size_t nfiles = 0, capacity = 0, i, j;
+	unsigned long njobs = 0, nthreads;
+	int argi, stats = 0, usage = 0, tuned = 0, failed = 0;
+	pool_t *pool = NULL;
 
-	if (argc < 2) {
-		fprintf(stderr, "%s: <file path>\n", argv[0]);
-		return EXIT_FAILURE;
+	for (argi = 1; argi < argc && !usage; argi++) {
+		spec = NULL;
+
+		if (!strcmp(argv[argi], OPT_PREDEF) && argi + 1 < argc) {
+			spec = argv[++argi];
+		} else if (
+			!strncmp(argv[argi], OPT_PREDEF "=", strlen(OPT_PREDEF) + 1)
+		) {
+			spec = argv[argi] + strlen(OPT_PREDEF) + 1;
+		} else if (!strcmp(argv[argi], OPT_SERVE) && argi + 1 < argc) {
+			serve = argv[++argi];
+		} else if ((value = n2t_option_value(argv[argi], OPT_SERVE))) {
+			serve = value;
+		} else if (!strcmp(argv[argi], OPT_CONNECT) && argi + 1 < argc) {
+			connect_to = argv[++argi];
+		} else if ((value = n2t_option_value(argv[argi], OPT_CONNECT))) {
+			connect_to = value;
+		} else if (!strcmp(argv[argi], OPT_STATS)) {
+			stats = REPORT_TEXT;
+		} else if ((value = n2t_option_value(argv[argi], OPT_STATS))) {
+			stats = REPORT_JSON;
+			usage = strcmp(value, "json") != 0;
+		} else if (!strcmp(argv[argi], OPT_HEADER)) {
+			settings.format.header = 1;
+		} else if (!strcmp(argv[argi], OPT_INCREMENTAL)) {
+			settings.incremental = 1;
+		} else if (!strcmp(argv[argi], OPT_STREAM)) {
+			settings.stream = 1;
+		} else if ((value = n2t_option_value(argv[argi], OPT_FORMAT))) {
+			if (!strcmp(value, "bin") || !strcmp(value, "hack"))
+				settings.format.binary = !strcmp(value, "bin");
+			else
+				usage = 1;
+		} else if ((value = n2t_option_value(argv[argi], OPT_THREADS))) {
+			nthreads = strtoul(value, &end, 10);
+			usage = *value == '\0' || *end != '\0' || nthreads == 0 ||
+				nthreads > PARSER_MAX_THREADS;
+			settings.opts.nthreads = nthreads;
+		} else if ((value = n2t_option_value(argv[argi], OPT_CACHE))) {
+			cache_dir = value;
+		} else if ((value = n2t_option_value(argv[argi], OPT_CACHE_LIMIT))) {
+			usage = n2t_parse_size(value, &cache_limit);
+		} else if ((value = n2t_option_value(argv[argi], OPT_JOBS))) {
+			njobs = strtoul(value, &end, 10);
+			usage = *value == '\0' || *end != '\0' || njobs > UINT_MAX;
+		} else if ((value = n2t_option_value(argv[argi], OPT_ENDIAN))) {
+			if (!strcmp(value, "little") || !strcmp(value, "big")) {
+				settings.format.endian = !strcmp(value, "big") ?
+					ROMIMAGE_BIG: ROMIMAGE_LITTLE;
+			} else {
+				usage = 1;
+			}
+		} else if (strncmp(argv[argi], "--", 2)) {
+			if (n2t_add_inputs(argv[argi], &files, &nfiles, &capacity)) {
+				fprintf(
+					stderr, "%s: could not list the files of `%s'. Exiting.\n",
+					argv[0], argv[argi]
+				);
+				n2t_free_inputs(files, nfiles);
+				return EXIT_FAILURE;
+			}
+		} else {
+			usage = 1;
+		}
+
+		if (spec && n2t_parse_predef(spec, predefs + settings.opts.npredefs)) {
+			fprintf(
+				stderr, "%s: `%s' is not a valid NAME=ADDR predefinition.\n",
+				argv[0], spec
+			);
+			n2t_free_inputs(files, nfiles);
+			return EXIT_FAILURE;
+		} else if (spec) {
+			settings.opts.npredefs++;
+		}
 	}
 
-	if (!n2t_ends_with(argv[1], ".asm")) {
+	settings.stats = stats != 0;
+	tuned = settings.format.binary || settings.format.header ||
+		settings.format.endian != ROMIMAGE_LITTLE || settings.stream ||
+		settings.opts.npredefs > 0 ||
+		settings.opts.nthreads > 0 || cache_dir || settings.incremental;
+
+	// Streaming reads the input a chunk at a time, which neither the threads
+	// nor the cache or the incremental state work with. The daemon assembles
+	// with its own settings.
+	usage = usage || (cache_dir && settings.incremental) || (
+		settings.stream &&
+		(settings.opts.nthreads > 0 || cache_dir || settings.incremental)
+	) || (serve ?
+		nfiles > 0 || connect_to: nfiles == 0 || (connect_to && tuned));
+
+	if (usage) {
 		fprintf(
-			stderr, "%s: `%s' does not have an `.asm' extension.\n", argv[0],
-			argv[1]
+			stderr, "%s: " USAGE "\n%s: " USAGE_SERVE "\n%s: " USAGE_CONNECT
+			"\n", argv[0], argv[0], argv[0]
 		);
+		n2t_free_inputs(files, nfiles);
 		return EXIT_FAILURE;
 	}
 
-	strncpy(output_path, n2t_filename(argv[1]), BUFFSIZE_LARGE);
-	*index(output_path, '.') = '\0';
-	strncat(output_path, ".hack", BUFFSIZE_LARGE - strlen(output_path));
+	if (cache_dir) {
+		if (n2t_cache_open(cache_dir, cache_limit, &cache)) {
+			fprintf(
+				stderr, "%s: could not open the cache `%s'. Exiting.\n",
+				argv[0], cache_dir
+			);
+			n2t_free_inputs(files, nfiles);
+			return EXIT_FAILURE;
+		}
+
+		settings.cache = &cache;
+	}
+
+	settings.salt = n2t_settings_salt(&settings);
+
+	if (serve) {
+		if (
+			(failed = n2t_serve(serve, &settings, njobs, errmsg, BUFFSIZE_VLARGE))
+		) {
+			fprintf(
+				stderr, "%s: could not serve `%s': %s.\n", argv[0], serve,
+				errmsg
+			);
+		}
+
+		if (settings.cache)
+			n2t_cache_close(&cache);
+
+		n2t_free_thread_arena();
+
+		return failed ? EXIT_FAILURE: EXIT_SUCCESS;
+	}
+
+	order = malloc(nfiles * sizeof(asmfile_t*));
+
+	if (order == NULL) {
+		fprintf(stderr, "%s: out of memory. Exiting.\n", argv[0]);
+		n2t_free_inputs(files, nfiles);
+
+		if (settings.cache)
+			n2t_cache_close(&cache);
 
-	if ((output = fopen(output_path, "wt")) == NULL) {
-		fprintf(
-			stderr, "%s: could not open `%s' for writing. Exiting.\n", argv[0],
-			output_path
-		);
 		return EXIT_FAILURE;
 	}
 
-	if ((s = n2t_parse(argv[1])) == NULL) {
-		fprintf(
-			stderr, "%s: `%s' is an invalid `.asm' file.\n", argv[0], argv[1]
+	for (i = 0; i < nfiles; i++) {
+		files[i].settings = &settings;
+		// The daemon names the outputs after its own format.
+		n2t_prepare_output(
+			files + i, connect_to ? "": n2t_output_extension(&settings.format)
 		);
-		fclose(output);
 
-		return EXIT_FAILURE;
+		// Two inputs assembled into the same file would overwrite each other.
+		for (j = 0; j < i && !files[i].error; j++) {
+			if (
+				!files[j].error &&
+				!strcmp(files[i].output_path, files[j].output_path)
+			) {
+				files[i].error = 1;
+				snprintf(
+					files[i].errmsg, BUFFSIZE_VLARGE,
+					"`%.*s' is already written from `%s'", BUFFSIZE_LARGE,
+					files[i].output_path, files[j].input
+				);
+			}
+		}
+
+		order[i] = files + i;
 	}
 
-	for (i = 0; i < s->next; i++) {
-		t = n2t_tokenseq_index_get(s, i);
+	// Starting with the largest files keeps a long one from being left to run
+	// alone once the others are done.
+	qsort(order, nfiles, sizeof(asmfile_t*), n2t_compare_sizes);
+
+	if (connect_to)
+		n2t_request_files(connect_to, files, nfiles);
+	else if (nfiles > 1 && njobs != 1)
+		pool = n2t_pool_alloc(njobs);
 
-		if (t->type == INSTR) {
-			n2t_instr_to_bitstr(t->data.instr, buff);
-		} else if (t->type == LABEL) {
+	for (i = 0; i < nfiles && !connect_to; i++) {
+		if (order[i]->error)
 			continue;
-		} else {
+
+		if (pool == NULL || n2t_pool_submit(pool, n2t_assemble_file, order[i]))
+			n2t_assemble_file(order[i]);
+	}
+
+	if (pool)
+		n2t_pool_free(pool);
+
+	for (i = 0; i < nfiles; i++) {
+		if (files[i].error) {
 			fprintf(
-				stderr, "No known instrucion type %u. Quitting\n", t->type
+				stderr, "%s: could not assemble `%s': %s.\n", argv[0],
+				files[i].input, files[i].errmsg
+			);
+			failed = 1;
+		} else if (stats == REPORT_TEXT) {
+			printf(
+				"%s: %lu instructions, %lu bytes written to `%s'.\n", argv[0],
+				files[i].nwords, files[i].length, files[i].output_path
 			);
-			fclose(output);
-			n2t_tokenseq_free(s);
 
-			return EXIT_FAILURE;
+			if (settings.incremental) {
+				printf(
+					"%s: %lu of %lu lines scanned, %lu instructions rewritten "
+					"in `%s'.\n", argv[0], files[i].nscanned, files[i].nlines,
+					files[i].nrewritten, files[i].output_path
+				);
+			}
+
+			n2t_print_stats(argv[0], files + i);
+		}
+	}
+
+	if (stats == REPORT_TEXT) {
+		printf(
+			"%s: peak resident set size of %lu KiB.\n", argv[0],
+			n2t_stats_peak_rss() / 1024
+		);
+	} else if (stats == REPORT_JSON) {
+		n2t_print_stats_json(files, nfiles, settings.cache ? &cache: NULL);
+	}
+
+	if (settings.cache) {
+		if (stats == REPORT_TEXT) {
+			printf(
+				"%s: cache: %lu hits, %lu misses, %lu outputs unchanged, %lu "
+				"entries evicted.\n", argv[0], cache.stats.hits,
+				cache.stats.misses, cache.stats.unchanged, cache.stats.evicted
+			);
+		}
+
+		n2t_cache_close(&cache);
+	}
+
+	free(order);
+	n2t_free_inputs(files, nfiles);
+	n2t_free_thread_arena();
+
+	return failed ? EXIT_FAILURE: EXIT_SUCCESS;
+}
+
+
+static void n2t_assemble_file(void *file) {
+	asmfile_t *const f = file;
+	settings_t const *const settings = f->settings;
+	output_t output = {
+		-1, settings->format, 0, 0, ROMIMAGE_CHECKSUM_INIT, NULL, 0, 0
+	};
+	uint8_t header[ROMIMAGE_HEADER_SIZE] = {0};
+	parseopts_t opts = settings->opts;
+	statsmark_t mark;
+	tokenseq_t *s;
+
+	if (settings->cache && f->source == NULL && f->output_path[0] != '\0') {
+		n2t_assemble_cached(f);
+		return;
+	} else if (
+		settings->incremental && f->source == NULL &&
+		f->output_path[0] != '\0'
+	) {
+		n2t_assemble_incremental(f);
+		return;
+	}
+
+	if (
+		f->output_path[0] != '\0' &&
+		(output.fd = open(f->output_path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0
+	) {
+		f->error = 1;
+		snprintf(
+			f->errmsg, BUFFSIZE_VLARGE, "could not open `%.*s' for writing",
+			BUFFSIZE_LARGE, f->output_path
+		);
+		return;
+	}
+
+	// Without an arena, the assembly falls back to the heap.
+	opts.arena = n2t_thread_arena(
+		n2t_parse_arena_hint(f->source ? f->source_length: MAX(f->size, 0))
+	);
+	opts.stats = settings->stats ? &f->stats: NULL;
+
+	// Streaming only spares memory when reading from and writing to files.
+	if (settings->stream && f->source == NULL && output.fd >= 0) {
+		// The header is only known once all words are written: room is left
+		// for it in the meantime.
+		if (
+			n2t_emit_offset(&output.format) > 0 &&
+			n2t_write_all(output.fd, header, ROMIMAGE_HEADER_SIZE)
+		) {
+			f->error = 1;
+		} else {
+			f->error = n2t_parse_stream(
+				f->input, &opts, n2t_output_stream, &output,
+				f->errmsg, BUFFSIZE_VLARGE
+			);
+			f->error = f->error || n2t_output_finish(&output);
+		}
+
+		if (f->error && f->errmsg[0] == '\0')
+			snprintf(f->errmsg, BUFFSIZE_VLARGE, "could not write output");
+	} else if (
+		(s = f->source ?
+			n2t_parse_buffer(
+				f->source, f->source_length, &opts, f->errmsg, BUFFSIZE_VLARGE
+			):
+			n2t_parse_with(f->input, &opts, f->errmsg, BUFFSIZE_VLARGE))
+	) {
+		n2t_stats_start(opts.stats, &mark);
+		f->error = n2t_output_tokenseq(
+			&output, s, MAX(settings->opts.nthreads, 1)
+		);
+		n2t_stats_lap(opts.stats, STATS_EMIT, &mark);
+		f->result = output.data;
+		n2t_tokenseq_free(s);
+
+		if (f->error)
+			snprintf(f->errmsg, BUFFSIZE_VLARGE, "could not write output");
+	} else {
+		f->error = 1;
+	}
+
+	f->nwords = output.nwords;
+	f->length = output.length;
+
+	if (output.fd >= 0)
+		close(output.fd);
+}
+
+static void n2t_assemble_cached(asmfile_t *f) {
+	settings_t const *const settings = f->settings;
+	char output_path[PATH_MAX];
+	filemap_t input;
+	uint64_t key;
+	size_t offset;
+	int status;
+
+	if (n2t_filemap_open(f->input, &input)) {
+		f->error = 1;
+		snprintf(f->errmsg, BUFFSIZE_VLARGE, "it cannot be read");
+		return;
+	}
+
+	key = n2t_cache_key(input.data, input.length, settings->salt);
+	status = n2t_cache_fetch(
+		settings->cache, key, f->output_path, &f->length
+	);
+
+	if (status == 0) {
+		// Every instruction takes the same room within the output.
+		offset = n2t_emit_offset(&settings->format);
+		f->nwords = (f->length - MIN(offset, f->length)) /
+			n2t_emit_width(&settings->format);
+		n2t_filemap_close(&input);
+
+		return;
+	}
+
+	// The output is assembled in memory, from the source already loaded, to
+	// be stored into the cache and compared with the current output.
+	strcpy(output_path, f->output_path);
+	f->output_path[0] = '\0';
+	f->source = (char*) input.data;
+	f->source_length = input.length;
+
+	n2t_assemble_file(f);
+
+	strcpy(f->output_path, output_path);
+	f->source = NULL;
+	n2t_filemap_close(&input);
+
+	if (
+		!f->error &&
+		n2t_cache_store(settings->cache, key, f->result, f->length, output_path)
+	) {
+		f->error = 1;
+		snprintf(f->errmsg, BUFFSIZE_VLARGE, "could not write output");
+	}
+
+	free(f->result);
+	f->result = NULL;
+}
+
+static void n2t_assemble_incremental(asmfile_t *f) {
+	settings_t const *const settings = f->settings;
+	char state_path[PATH_MAX];
+	parseopts_t opts = settings->opts;
+	filemap_t input;
+	struct stat info;
+	asmstate_t *s;
+	int fd, patch;
+
+	if (
+		snprintf(
+			state_path, PATH_MAX, "%s" STATE_EXTENSION, f->output_path
+		) >= PATH_MAX
+	) {
+		f->error = 1;
+		snprintf(f->errmsg, BUFFSIZE_VLARGE, "its state cannot be named");
+		return;
+	}
+
+	if (n2t_filemap_open(f->input, &input)) {
+		f->error = 1;
+		snprintf(f->errmsg, BUFFSIZE_VLARGE, "it cannot be read");
+		return;
+	}
+
+	// A missing or outdated state simply means starting from scratch.
+	if (
+		(s = n2t_asmstate_load(state_path, settings->salt)) == NULL &&
+		(s = n2t_asmstate_alloc(settings->salt)) == NULL
+	) {
+		f->error = 1;
+		snprintf(f->errmsg, BUFFSIZE_VLARGE, "could not allocate its state");
+		n2t_filemap_close(&input);
+		return;
+	}
+
+	// Only the symbols of the resolution pass are taken from the arena: the
+	// rest of the state outlives the assembly.
+	opts.arena = n2t_thread_arena(PARSER_ARENA_BASE);
+	f->error = n2t_asmstate_update(
+		s, input.data, input.length, &opts, &f->nscanned, f->errmsg,
+		BUFFSIZE_VLARGE
+	);
+	n2t_filemap_close(&input);
+
+	if (f->error) {
+		n2t_asmstate_free(s);
+		return;
+	}
+
+	if ((fd = open(f->output_path, O_RDWR | O_CREAT, 0644)) < 0) {
+		f->error = 1;
+		snprintf(
+			f->errmsg, BUFFSIZE_VLARGE, "could not open `%.*s' for writing",
+			BUFFSIZE_LARGE, f->output_path
+		);
+		n2t_asmstate_free(s);
+		return;
+	}
+
+	// Instructions can only be patched within the very output they were
+	// assembled into, as long as none of them moved.
+	patch = s->previous && s->nprevious == s->nwords &&
+		fstat(fd, &info) == 0 && info.st_size == s->output_size &&
+		info.st_mtim.tv_sec == s->output_mtime[0] &&
+		info.st_mtim.tv_nsec == s->output_mtime[1];
+
+	if (patch) {
+		f->error = n2t_patch_output(fd, s, settings, &f->nrewritten);
+	} else {
+		f->error = n2t_rewrite_output(fd, s, settings);
+		f->nrewritten = s->nwords;
+	}
+
+	if (f->error || fstat(fd, &info)) {
+		f->error = 1;
+		snprintf(f->errmsg, BUFFSIZE_VLARGE, "could not write output");
+	} else {
+		f->nlines = s->nlines;
+		f->nwords = s->nwords;
+		f->length = info.st_size;
+
+		// Failing to save the state only costs a full assembly next time,
+		// since the one left behind no longer matches the output.
+		s->output_size = info.st_size;
+		s->output_mtime[0] = info.st_mtim.tv_sec;
+		s->output_mtime[1] = info.st_mtim.tv_nsec;
+		n2t_asmstate_save(s, state_path);
+	}
+
+	close(fd);
+	n2t_asmstate_free(s);
+}
+
+static int n2t_patch_output(
+	int fd, asmstate_t const *s, settings_t const *settings,
+	size_t *nrewritten
+) {
+	size_t const width = n2t_emit_width(&settings->format);
+	size_t const offset = n2t_emit_offset(&settings->format);
+	char buff[BUFFSIZE_XLARGE * BITLINE_LENGTH];
+	uint8_t header[ROMIMAGE_HEADER_SIZE];
+	size_t begin = 0, end, length;
+
+	*nrewritten = 0;
+
+	// Runs of changed words are written at once.
+	while (begin < s->nwords) {
+		if (s->words[begin] == s->previous[begin]) {
+			begin++;
+			continue;
+		}
+
+		for (
+			end = begin + 1;
+			end < s->nwords && end - begin < BUFFSIZE_XLARGE &&
+				s->words[end] != s->previous[end];
+			end++
+		);
+
+		length = n2t_emit_words(
+			&settings->format, s->words + begin, end - begin, buff
+		);
+
+		if (pwrite(fd, buff, length, offset + begin * width) != length)
+			return 1;
+
+		*nrewritten += end - begin;
+		begin = end;
+	}
+
+	// The checksum covers every word, but takes no parsing to compute.
+	if (*nrewritten > 0 && offset > 0) {
+		n2t_romimage_write_header(
+			s->nwords, n2t_romimage_checksum(s->words, s->nwords),
+			settings->format.endian, header
+		);
+
+		if (pwrite(fd, header, ROMIMAGE_HEADER_SIZE, 0) != ROMIMAGE_HEADER_SIZE)
+			return 1;
+	}
+
+	return 0;
+}
+
+static int n2t_rewrite_output(
+	int fd, asmstate_t const *s, settings_t const *settings
+) {
+	size_t const length = n2t_emit_length(&settings->format, s->nwords);
+	char *data;
+	int error;
+
+	if ((data = malloc(length + 1)) == NULL)
+		return 1;
+
+	n2t_emit_image(&settings->format, s->words, s->nwords, data);
+
+	error = lseek(fd, 0, SEEK_SET) != 0 || n2t_write_all(fd, data, length) ||
+		ftruncate(fd, length);
+	free(data);
+
+	return error;
+}
+
+static arena_t* n2t_thread_arena(size_t capacity) {
+	arena_t *a;
+
+	if (pthread_once(&arena_once, n2t_create_arena_key) || !arena_keyed)
+		return NULL;
+
+	if ((a = pthread_getspecific(arena_key)) != NULL) {
+		n2t_arena_reset(a);
+
+		if (a->capacity >= capacity)
+			return a;
+
+		n2t_arena_free(a);
+	}
+
+	a = n2t_arena_alloc(capacity);
+
+	if (a && pthread_setspecific(arena_key, a)) {
+		n2t_arena_free(a);
+		a = NULL;
+	}
+
+	return a;
+}
+
+static void n2t_create_arena_key(void) {
+	arena_keyed = !pthread_key_create(
+		&arena_key, (void (*)(void*)) n2t_arena_free
+	);
+}
+
+static void n2t_free_thread_arena(void) {
+	arena_t *a;
+
+	if (
+		pthread_once(&arena_once, n2t_create_arena_key) == 0 && arena_keyed &&
+		(a = pthread_getspecific(arena_key)) != NULL
+	) {
+		n2t_arena_free(a);
+		pthread_setspecific(arena_key, NULL);
+	}
+}
+
+static uint64_t n2t_settings_salt(settings_t const *settings) {
+	uint8_t const format[] = {
+		settings->format.binary, settings->format.header,
+		settings->format.endian
+	};
+	uint64_t salt = n2t_hash64(format, sizeof(format), CACHE_VERSION);
+	size_t i;
+
+	for (i = 0; i < settings->opts.npredefs; i++) {
+		// Each name is hashed along with its terminator, so that names can
+		// not run into the following ones.
+		salt = n2t_hash64(
+			settings->opts.predefs[i].id,
+			strlen(settings->opts.predefs[i].id) + 1, salt
+		);
+		salt = n2t_hash64(
+			&settings->opts.predefs[i].address, sizeof(uint16_t), salt
+		);
+	}
+
+	return salt;
+}
+
+static char const* n2t_output_extension(emitopts_t const *format) {
+	return format->binary ? ".bin": ".hack";
+}
+
+static void n2t_prepare_output(asmfile_t *f, char const *extension) {
+	char *dot;
+
+	if (!n2t_ends_with(f->input, ".asm")) {
+		f->error = 1;
+		snprintf(
+			f->errmsg, BUFFSIZE_VLARGE, "it does not have an `.asm' extension"
+		);
+		return;
+	}
+
+	// Checked beforehand so as not to leave an empty output behind.
+	if (f->size < 0) {
+		f->error = 1;
+		snprintf(f->errmsg, BUFFSIZE_VLARGE, "it cannot be read");
+		return;
+	}
+
+	strncpy(f->output_path, n2t_filename(f->input), PATH_MAX - 1);
+
+	if ((dot = index(f->output_path, '.')))
+		*dot = '\0';
+
+	strncat(f->output_path, extension, PATH_MAX - strlen(f->output_path) - 1);
+}
+
+static int n2t_add_inputs(
+	char *arg, asmfile_t **files, size_t *nfiles, size_t *capacity
+) {
+	glob_t matches;
+	size_t i;
+	int error = 0;
+
+	if (strpbrk(arg, "*?[") == NULL)
+		return n2t_add_path(arg, files, nfiles, capacity);
+
+	// A pattern matching nothing is kept as is, to be reported as a file
+	// that cannot be read.
+	if (glob(arg, GLOB_NOCHECK, NULL, &matches))
+		return 1;
+
+	for (i = 0; i < matches.gl_pathc && !error; i++)
+		error = n2t_add_path(matches.gl_pathv[i], files, nfiles, capacity);
+
+	globfree(&matches);
+
+	return error;
+}
+
+static int n2t_add_path(
+	char const *path, asmfile_t **files, size_t *nfiles, size_t *capacity
+) {
+	struct dirent **entries;
+	struct stat info;
+	char entry_path[BUFFSIZE_XLARGE];
+	int nentries, i, error = 0;
+
+	if (stat(path, &info) || !S_ISDIR(info.st_mode))
+		return n2t_add_file(path, files, nfiles, capacity);
+
+	nentries = scandir(path, &entries, n2t_is_asm_entry, alphasort);
+
+	if (nentries < 0)
+		return 1;
+
+	for (i = 0; i < nentries; i++) {
+		snprintf(
+			entry_path, BUFFSIZE_XLARGE, "%s/%s", path, entries[i]->d_name
+		);
+		error = error || n2t_add_file(entry_path, files, nfiles, capacity);
+		free(entries[i]);
+	}
+
+	free(entries);
+
+	return error;
+}
+
+static int n2t_add_file(
+	char const *path, asmfile_t **files, size_t *nfiles, size_t *capacity
+) {
+	asmfile_t *f;
+	struct stat info;
+
+	if (*nfiles == *capacity) {
+		f = realloc(*files, (*capacity * 2 + 1) * sizeof(asmfile_t));
+
+		if (f == NULL)
+			return 1;
+
+		*files = f;
+		*capacity = *capacity * 2 + 1;
+	}
+
+	f = *files + *nfiles;
+	memset(f, 0, sizeof(asmfile_t));
+
+	if ((f->input = strdup(path)) == NULL)
+		return 1;
+
+	f->size = stat(path, &info) ? -1: info.st_size;
+	(*nfiles)++;
+
+	return 0;
+}
+
+static void n2t_free_inputs(asmfile_t *files, size_t nfiles) {
+	size_t i;
+
+	for (i = 0; i < nfiles; i++)
+		free(files[i].input);
+
+	free(files);
+}
+
+static int n2t_is_asm_entry(struct dirent const *entry) {
+	return entry->d_name[0] != '.' && n2t_ends_with(entry->d_name, ".asm");
+}
+
+static int n2t_compare_sizes(void const *a, void const *b) {
+	off_t const x = (*(asmfile_t* const*) a)->size;
+	off_t const y = (*(asmfile_t* const*) b)->size;
+
+	return (x < y) - (x > y);
+}
+
+
+static int n2t_output_stream(word_t const *words, size_t n, void *output) {
+	output_t *const o = output;
+	// Large enough for either format.
+	char buff[PARSER_STREAM_BATCH * BITLINE_LENGTH];
+	size_t length;
+
+	if (n > PARSER_STREAM_BATCH)
+		return 1;
+
+	length = n2t_emit_words(&o->format, words, n, buff);
+
+	if (o->format.binary)
+		o->checksum = n2t_romimage_checksum_update(o->checksum, words, n);
+
+	if (n2t_write_all(o->fd, buff, length))
+		return 1;
+
+	o->nwords += n;
+	o->length += length;
+
+	return 0;
+}
+
+static int n2t_output_finish(output_t *o) {
+	uint8_t header[ROMIMAGE_HEADER_SIZE];
+
+	if (n2t_emit_offset(&o->format) == 0)
+		return 0;
+
+	n2t_romimage_write_header(
+		o->nwords, o->checksum, o->format.endian, header
+	);
+	o->length += ROMIMAGE_HEADER_SIZE;
+
+	return pwrite(o->fd, header, ROMIMAGE_HEADER_SIZE, 0) != ROMIMAGE_HEADER_SIZE;
+}
+
+static int n2t_output_tokenseq(
+	output_t *o, tokenseq_t const *s, unsigned nthreads
+) {
+	int error;
+
+	// Only threads writing to distinct places of the file make mapping it
+	// worth it.
+	o->mapped = nthreads > 1 && o->fd >= 0;
+	error = n2t_emit_tokenseq(
+		s, &o->format, nthreads, n2t_output_reserve, o, &o->nwords
+	);
+
+	if (o->data == NULL)
+		return 1;
+
+	o->length = n2t_emit_length(&o->format, o->nwords);
+
+	if (o->mapped) {
+		error = munmap(o->data, o->capacity) || error;
+		o->data = NULL;
+	} else if (o->fd >= 0) {
+		error = error || n2t_write_all(o->fd, o->data, o->length);
+		free(o->data);
+		o->data = NULL;
+	} else if (error) {
+		free(o->data);
+		o->data = NULL;
+	}
+
+	return error;
+}
+
+static char* n2t_output_reserve(size_t length, void *output) {
+	output_t *const o = output;
+
+	o->capacity = length;
+
+	if (
+		o->mapped && length > 0 && ftruncate(o->fd, length) == 0 &&
+		(o->data = mmap(NULL, length, PROT_WRITE, MAP_SHARED, o->fd, 0)) !=
+			MAP_FAILED
+	)
+		return o->data;
+
+	o->mapped = 0;
+	o->data = malloc(length + 1);
+
+	return o->data;
+}
+
+static int n2t_serve(
+	char const *socket_path, settings_t const *settings, unsigned njobs,
+	char errmsg[], size_t maxwrite
+) {
+	struct sockaddr_un address = {AF_UNIX};
+	struct sigaction stop = {{0}};
+	struct timeval timeout = {SERVER_IDLE_TIMEOUT, 0};
+	struct stat info;
+	connection_t *c;
+	pool_t *pool;
+	int listener, client, error = 0;
+
+	if (strlen(socket_path) >= sizeof(address.sun_path)) {
+		snprintf(errmsg, maxwrite, "the socket path is too long");
+		return 1;
+	}
+
+	strcpy(address.sun_path, socket_path);
+
+	// A socket nobody answers on is left over by a daemon that did not exit
+	// cleanly, and can be replaced.
+	if ((client = n2t_connect(socket_path)) >= 0) {
+		close(client);
+		snprintf(errmsg, maxwrite, "it is already being served");
+		return 1;
+	} else if (stat(socket_path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+		unlink(socket_path);
+	}
+
+	if (
+		(listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+		bind(listener, (struct sockaddr*) &address, sizeof(address)) ||
+		listen(listener, SOMAXCONN)
+	) {
+		snprintf(errmsg, maxwrite, "could not listen on it");
+
+		if (listener >= 0)
+			close(listener);
+
+		return 1;
+	}
+
+	if ((pool = n2t_pool_alloc(njobs)) == NULL) {
+		snprintf(errmsg, maxwrite, "could not start the workers");
+		close(listener);
+		unlink(socket_path);
+
+		return 1;
+	}
+
+	// Without `SA_RESTART', a signal interrupts `accept()' for the loop to
+	// notice it.
+	stop.sa_handler = n2t_stop_serving;
+	sigaction(SIGINT, &stop, NULL);
+	sigaction(SIGTERM, &stop, NULL);
+	// Clients hanging up early are noticed through failed writes.
+	signal(SIGPIPE, SIG_IGN);
+
+	while (serving) {
+		if ((client = accept(listener, NULL, NULL)) < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			snprintf(errmsg, maxwrite, "could not accept connections");
+			error = 1;
+			break;
+		}
+
+		// Idle clients are let go, so that they neither hold a worker
+		// forever nor delay the shutdown.
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+		if ((c = malloc(sizeof(connection_t))) == NULL) {
+			close(client);
+			continue;
+		}
+
+		c->fd = client;
+		c->settings = settings;
+
+		if (n2t_pool_submit(pool, n2t_serve_connection, c))
+			n2t_serve_connection(c);
+	}
+
+	close(listener);
+	unlink(socket_path);
+	n2t_pool_free(pool);
+
+	return error;
+}
+
+static void n2t_stop_serving(int signum) {
+	serving = 0;
+}
+
+static void n2t_serve_connection(void *connection) {
+	connection_t *const c = connection;
+	char header[BUFFSIZE_VLARGE + BUFFSIZE_MED];
+	char *line = NULL;
+	size_t capacity = 0;
+	int in_fd = dup(c->fd), status, length, error = 0;
+	FILE *in = in_fd < 0 ? NULL: fdopen(in_fd, "r");
+	asmfile_t f;
+
+	if (in == NULL && in_fd >= 0)
+		close(in_fd);
+
+	while (in && !error) {
+		memset(&f, 0, sizeof(asmfile_t));
+		f.settings = c->settings;
+
+		if ((status = n2t_read_request(in, &line, &capacity, &f)) < 0)
+			break;
+
+		if (status == 0)
+			n2t_assemble_file(&f);
+
+		if (status || f.error) {
+			length = snprintf(
+				header, sizeof(header), "ERROR %s\n", f.errmsg
+			);
+		} else if (f.output_path[0] != '\0') {
+			length = snprintf(
+				header, sizeof(header), "OK %lu %lu %s\n", f.nwords, f.length,
+				f.output_path
+			);
+		} else {
+			length = snprintf(
+				header, sizeof(header), "OK %lu %lu\n", f.nwords, f.length
+			);
+		}
+
+		// A malformed request leaves the connection out of step.
+		error = n2t_write_all(c->fd, header, length) || (
+			f.result && n2t_write_all(c->fd, f.result, f.length)
+		) || status;
+
+		free(f.input);
+		free(f.source);
+		free(f.result);
+	}
+
+	if (in)
+		fclose(in);
+
+	free(line);
+	close(c->fd);
+	free(c);
+}
+
+static int n2t_read_request(
+	FILE *in, char **line, size_t *capacity, asmfile_t *dest
+) {
+	char const *extension;
+	ssize_t length;
+	unsigned long size;
+	char *end;
+
+	if ((length = getline(line, capacity, in)) <= 0)
+		return -1;
+
+	if ((*line)[length - 1] == '\n')
+		(*line)[--length] = '\0';
+
+	if (!strncmp(*line, "PATH ", 5)) {
+		dest->input = strdup(*line + 5);
+	} else if (!strncmp(*line, "SOURCE ", 7)) {
+		size = strtoul(*line + 7, &end, 10);
+
+		if (end == *line + 7 || *end != '\0' || size > SERVER_MAX_SOURCE) {
+			snprintf(dest->errmsg, BUFFSIZE_VLARGE, "bad source length");
+			return 1;
+		}
+
+		if (
+			(dest->source = malloc(size + 1)) == NULL ||
+			fread(dest->source, 1, size, in) != size
+		) {
+			snprintf(dest->errmsg, BUFFSIZE_VLARGE, "could not read source");
+			return 1;
+		}
+
+		dest->source_length = size;
+	} else {
+		snprintf(dest->errmsg, BUFFSIZE_VLARGE, "malformed request");
+		return 1;
+	}
+
+	if (dest->input == NULL && dest->source == NULL) {
+		snprintf(dest->errmsg, BUFFSIZE_VLARGE, "out of memory");
+		return 1;
+	}
+
+	if ((length = getline(line, capacity, in)) <= 0) {
+		snprintf(dest->errmsg, BUFFSIZE_VLARGE, "missing destination");
+		return 1;
+	}
+
+	if ((*line)[length - 1] == '\n')
+		(*line)[--length] = '\0';
+
+	extension = !strncmp(*line, "STEM ", 5) ?
+		n2t_output_extension(&dest->settings->format): "";
+
+	if (!strcmp(*line, "INLINE")) {
+		dest->output_path[0] = '\0';
+	} else if (
+		(!strncmp(*line, "PATH ", 5) || !strncmp(*line, "STEM ", 5)) &&
+		length - 5 + strlen(extension) < PATH_MAX
+	) {
+		strcpy(dest->output_path, *line + 5);
+
+		// An empty path would mean an inline output.
+		if (dest->output_path[0] == '\0') {
+			snprintf(dest->errmsg, BUFFSIZE_VLARGE, "empty output path");
+			return 1;
 		}
 
-		fprintf(output, "%s\n", buff);
+		strcat(dest->output_path, extension);
+	} else {
+		snprintf(dest->errmsg, BUFFSIZE_VLARGE, "malformed destination");
+		return 1;
 	}
 
-	n2t_tokenseq_free(s);
-	fclose(output);
+	return 0;
+}
+
+static void n2t_request_files(
+	char const *socket_path, asmfile_t *files, size_t nfiles
+) {
+	char cwd[PATH_MAX], input[PATH_MAX], request[3 * PATH_MAX];
+	int fds[CLIENT_WINDOW], length;
+	size_t window, i;
+
+	if (getcwd(cwd, PATH_MAX) == NULL)
+		cwd[0] = '\0';
+
+	// Requests are sent a window at a time over connections of their own,
+	// for the daemon to serve them concurrently.
+	for (window = 0; window < nfiles; window += CLIENT_WINDOW) {
+		for (i = 0; i < CLIENT_WINDOW && window + i < nfiles; i++) {
+			asmfile_t *const f = files + window + i;
+
+			fds[i] = -1;
+
+			if (f->error)
+				continue;
+
+			// The daemon does not share the working directory of the client.
+			if (cwd[0] == '\0' || realpath(f->input, input) == NULL) {
+				f->error = 1;
+				snprintf(f->errmsg, BUFFSIZE_VLARGE, "it cannot be located");
+				continue;
+			}
+
+			length = snprintf(
+				request, sizeof(request), "PATH %s\nSTEM %s/%s\n", input, cwd,
+				f->output_path
+			);
+
+			// Paths end at newlines within requests.
+			if (
+				length >= sizeof(request) || strchr(input, '\n') ||
+				strchr(cwd, '\n') || strchr(f->output_path, '\n')
+			) {
+				f->error = 1;
+				snprintf(
+					f->errmsg, BUFFSIZE_VLARGE, "its path cannot be sent"
+				);
+				continue;
+			}
+
+			if ((fds[i] = n2t_connect(socket_path)) < 0) {
+				f->error = 1;
+				snprintf(
+					f->errmsg, BUFFSIZE_VLARGE, "could not reach the daemon"
+				);
+			} else if (n2t_write_all(fds[i], request, length)) {
+				f->error = 1;
+				snprintf(
+					f->errmsg, BUFFSIZE_VLARGE, "could not send the request"
+				);
+				close(fds[i]);
+				fds[i] = -1;
+			}
+		}
+
+		for (i = 0; i < CLIENT_WINDOW && window + i < nfiles; i++) {
+			if (fds[i] >= 0)
+				n2t_read_response(fds[i], files + window + i);
+		}
+	}
+}
+
+static void n2t_read_response(int fd, asmfile_t *f) {
+	FILE *const in = fdopen(fd, "r");
+	char *line = NULL;
+	size_t capacity = 0;
+	char const *extension;
+	ssize_t length;
+	int n = 0;
+
+	f->error = 1;
+
+	if (in == NULL) {
+		snprintf(f->errmsg, BUFFSIZE_VLARGE, "could not read the response");
+		close(fd);
+		return;
+	}
+
+	if ((length = getline(&line, &capacity, in)) <= 0) {
+		snprintf(f->errmsg, BUFFSIZE_VLARGE, "the daemon hung up");
+	} else {
+		if (line[length - 1] == '\n')
+			line[length - 1] = '\0';
+
+		if (!strncmp(line, "ERROR ", 6)) {
+			snprintf(f->errmsg, BUFFSIZE_VLARGE, "%s", line + 6);
+		} else if (
+			sscanf(line, "OK %lu %lu%n", &f->nwords, &f->length, &n) == 2 &&
+			line[n] == ' '
+		) {
+			// The daemon names the output after its own format, and the stem
+			// of `output_path' is completed with the extension it chose.
+			if ((extension = rindex(n2t_filename(line + n + 1), '.')))
+				strncat(
+					f->output_path, extension,
+					PATH_MAX - strlen(f->output_path) - 1
+				);
+
+			f->error = 0;
+		} else {
+			snprintf(f->errmsg, BUFFSIZE_VLARGE, "malformed response");
+		}
+	}
+
+	free(line);
+	fclose(in);
+}
+
+static int n2t_connect(char const *socket_path) {
+	struct sockaddr_un address = {AF_UNIX};
+	int fd;
+
+	if (strlen(socket_path) >= sizeof(address.sun_path))
+		return -1;
+
+	strcpy(address.sun_path, socket_path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr*) &address, sizeof(address))) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+
+static int n2t_parse_predef(char *spec, ramvar_t *dest) {
+	char *const eq = index(spec, '='), *end;
+	unsigned long address;
+
+	if (eq == NULL || eq == spec)
+		return 1;
+
+	*eq = '\0';
+	address = strtoul(eq + 1, &end, 10);
+
+	// Addresses are limited to 15 bits, the width of an A-instruction operand.
+	if (
+		eq[1] == '\0' || *end != '\0' || address >= (1 << 15) ||
+		IS_IN(spec[0], "0123456789") || !n2t_composed_of(spec, LABEL_CHARSET)
+	) {
+		*eq = '=';
+		return 1;
+	}
+
+	dest->id = spec;
+	dest->address = address;
+
+	return 0;
+}
+
+static char* n2t_option_value(char *arg, char const *option) {
+	size_t const len = strlen(option);
+
+	return !strncmp(arg, option, len) && arg[len] == '=' ? arg + len + 1: NULL;
+}
+
+static int n2t_parse_size(char const *spec, uint64_t *dest) {
+	char *end;
+	unsigned long long size = strtoull(spec, &end, 10);
+	unsigned shift = 0;
+
+	if (end == spec || IS_IN(spec[0], "+-"))
+		return 1;
+
+	switch (*end) {
+		case 'G':
+			shift += 10;
+			// Falls through.
+		case 'M':
+			shift += 10;
+			// Falls through.
+		case 'K':
+			shift += 10;
+			end++;
+		default:
+			break;
+	}
+
+	if (*end != '\0' || size > (UINT64_MAX >> shift))
+		return 1;
+
+	*dest = (uint64_t) size << shift;
+
+	return 0;
+}
+
+static void n2t_print_stats(char const *program, asmfile_t const *f) {
+#ifndef N2T_NO_STATS
+	asmstats_t const *const st = &f->stats;
+	int phase;
+
+	printf(
+		"%s: `%s': %lu lines, %lu tokens, %lu distinct (%.1fx), %lu labels, "
+		"%lu variables.\n", program, f->input, st->nlines, st->ntokens,
+		st->nunique, st->nunique ? (double) st->ntokens / st->nunique: 0,
+		st->nlabels, st->nvariables
+	);
+	printf(
+		"%s: `%s': memory caches grown %lu times, by %lu bytes.\n", program,
+		f->input, st->ngrows, st->grow_bytes
+	);
+
+	for (phase = 0; phase < STATS_PHASES_NO; phase++) {
+		printf(
+			"%s: `%s': %-17s %10.3f ms wall, %10.3f ms CPU.\n", program,
+			f->input, n2t_stats_phase_name(phase), st->wall[phase] * 1E3,
+			st->cpu[phase] * 1E3
+		);
+	}
+#endif
+}
+
+static void n2t_print_stats_json(
+	asmfile_t const *files, size_t nfiles, cache_t const *cache
+) {
+	asmfile_t const *f;
+	size_t i;
+#ifndef N2T_NO_STATS
+	int phase;
+#endif
+
+	printf("{\n\t\"files\": [");
+
+	for (i = 0; i < nfiles; i++) {
+		f = files + i;
+		printf("%s\n\t\t{\"input\": ", i ? ",": "");
+		n2t_print_json_string(f->input);
+		printf(", \"output\": ");
+		n2t_print_json_string(f->output_path);
+
+		if (f->error) {
+			printf(", \"error\": ");
+			n2t_print_json_string(f->errmsg);
+			printf("}");
+			continue;
+		}
+
+		printf(
+			",\n\t\t\t\"instructions\": %lu, \"bytes\": %lu", f->nwords,
+			f->length
+		);
+#ifndef N2T_NO_STATS
+		printf(
+			",\n\t\t\t\"lines\": %lu, \"tokens\": %lu, \"distinct_tokens\": %lu, "
+			"\"dedup_ratio\": %.3f,\n\t\t\t\"labels\": %lu, \"variables\": %lu, "
+			"\"memcache_grows\": %lu, \"memcache_grow_bytes\": %lu,\n\t\t\t"
+			"\"phases\": {", f->stats.nlines, f->stats.ntokens,
+			f->stats.nunique, f->stats.nunique ?
+				(double) f->stats.ntokens / f->stats.nunique: 0,
+			f->stats.nlabels, f->stats.nvariables, f->stats.ngrows,
+			f->stats.grow_bytes
+		);
+
+		for (phase = 0; phase < STATS_PHASES_NO; phase++) {
+			printf(
+				"%s\n\t\t\t\t\"%s\": {\"wall_ms\": %.6f, \"cpu_ms\": %.6f}",
+				phase ? ",": "", n2t_stats_phase_name(phase),
+				f->stats.wall[phase] * 1E3, f->stats.cpu[phase] * 1E3
+			);
+		}
+
+		printf("\n\t\t\t}");
+#endif
+		printf("}");
+	}
+
+	printf("\n\t],\n");
+
+	if (cache) {
+		printf(
+			"\t\"cache\": {\"hits\": %lu, \"misses\": %lu, \"unchanged\": %lu, "
+			"\"evicted\": %lu},\n", cache->stats.hits, cache->stats.misses,
+			cache->stats.unchanged, cache->stats.evicted
+		);
+	}
+
+	printf("\t\"peak_rss_bytes\": %lu\n}\n", n2t_stats_peak_rss());
+}
+
+static void n2t_print_json_string(char const *s) {
+	putchar('"');
+
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			printf("\\%c", *s);
+		else if ((unsigned char) *s < 0x20)
+			printf("\\u%04x", *s);
+		else
+			putchar(*s);
+	}
 
-	return EXIT_SUCCESS;
+	putchar('"');
 }
@@ -0,0 +1,647 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lexer.h"
+#include "parser.h"
+#include "memcache.h"
+#include "linescan.h"
+#include "arena.h"
+#include "hackasm.h"
+#include "workload.h"
+#include "utils.h"
+
+
+#define	TEST_DIR_ROOT "test_fixtures/"
+
+#define	OPT_JSON "--json"
+#define	OPT_MAX_LINES "--max-lines"
+
+// Phases of an assembly timed by `bench_assembly_phases()'.
+#define	PHASE_TOKENIZE 0
+#define	PHASE_PARSE_ROM_LABELS 1
+#define	PHASE_ASSIGN_ROM_LABELS 2
+#define	PHASE_ASSIGN_RAM_LABELS 3
+#define	PHASE_EMIT 4
+#define	PHASE_TOTAL 5
+#define	PHASES_NO 6
+
+// Assembly time spent on each input of `bench_assembly_phases()', in seconds,
+// bounding the number of rounds.
+#define	PHASES_BUDGET 2
+#define	PHASES_MIN_ROUNDS 5
+#define	PHASES_MAX_ROUNDS 100
+
+/**
+ * A program assembled by `bench_assembly_phases()': the `len' bytes at `src',
+ * spanning `nlines' lines, and `times', the duration of each phase of each of
+ * `nrounds' rounds, in seconds.
+ */
+typedef struct {
+	char name[BUFFSIZE_LARGE];
+	char *src;
+	size_t len, nlines, nrounds;
+	double *times[PHASES_NO];
+} benchinput_t;
+
+/**
+ * The output buffer of `bench_time_phases()', `capacity' bytes large, shared
+ * by all rounds so that page faults are only taken once.
+ */
+typedef struct {
+	char *data;
+	size_t capacity;
+} benchoutput_t;
+
+
+// memcache.h
+/**
+ * Interns a growing number of distinct tokens into a `memcache_t' starting
+ * from a single unit, and into a `tokenseq_t' index list, reporting the cost
+ * per token. With geometric growth it should stay flat as the number of tokens
+ * increases.
+ */
+int bench_memcache_growth(void);
+
+// lexer.h
+/**
+ * Decodes C-instructions spanning every `comp' mnemonic, reporting the cost
+ * per instruction.
+ */
+int bench_Cinstr_decoding(void);
+/**
+ * Formats a million machine words as .hack lines, reporting the cost of the
+ * fastest of a few rounds.
+ */
+int bench_bitline_encoding(void);
+
+// linescan.h
+/**
+ * Splits a large buffer of typical assembly lines with every supported
+ * `linescan_t' kernel, reporting the throughput of each.
+ */
+int bench_line_splitting(void);
+
+// parser.h
+/**
+ * Assembles the programs of the test fixtures and synthetic ones from a
+ * thousand to `max_lines' lines, many times over, timing tokenization, each
+ * pass resolving symbols and the emission of `.hack' text apart. Reports the
+ * median and 99th percentile of each phase, with the lines and megabytes of
+ * source it gets through per second at the median, as a table or as a JSON
+ * document if `json' is set.
+ */
+int bench_assembly_phases(void);
+
+
+typedef int (*bench_function)(void);
+
+// Set by the command line options of `main()'.
+static int json = 0;
+static size_t max_lines = 1E7;
+
+/**
+ * Returns: the time elapsed since an arbitrary point in the past, in seconds.
+ */
+double bench_now(void);
+/**
+ * Times `nrounds' assemblies of `in', storing the duration of each phase of
+ * each round into `in->times'.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int bench_time_phases(benchinput_t *in);
+/**
+ * Prints the statistics of `in' as a row of a table or, if `json' is set, as
+ * an element of a JSON array, preceded by a comma unless `first' is set.
+ */
+static void bench_report_phases(benchinput_t const *in, int first);
+/**
+ * Returns: the number of lines of the `len' bytes at `src'.
+ */
+static size_t bench_count_lines(char const *src, size_t len);
+/**
+ * `qsort()' comparator of `double' values, in increasing order.
+ */
+static int bench_compare_times(void const *a, void const *b);
+/**
+ * An `emitreserve_t' returning the `benchoutput_t' buffer at `output', if large
+ * enough.
+ */
+static char* bench_reserve_output(size_t length, void *output);
+
+
+int main (int argc, char *argv[]) {
+	bench_function benches[] = {
+		bench_memcache_growth, bench_Cinstr_decoding, bench_bitline_encoding,
+		bench_line_splitting, bench_assembly_phases
+	};
+	char *bench_names[] = {
+		"bench_memcache_growth", "bench_Cinstr_decoding",
+		"bench_bitline_encoding", "bench_line_splitting",
+		"bench_assembly_phases"
+	};
+	size_t const benches_no = sizeof(benches) / sizeof(bench_function);
+	size_t i, failed_no = 0;
+	char *end;
+	int argi;
+
+	for (argi = 1; argi < argc; argi++) {
+		if (!strcmp(argv[argi], OPT_JSON)) {
+			json = 1;
+		} else if (
+			!strncmp(argv[argi], OPT_MAX_LINES "=", strlen(OPT_MAX_LINES) + 1)
+		) {
+			max_lines = strtoul(
+				argv[argi] + strlen(OPT_MAX_LINES) + 1, &end, 10
+			);
+
+			if (*end != '\0' || max_lines == 0)
+				argi = argc + 1;
+		} else {
+			argi = argc + 1;
+		}
+	}
+
+	if (argi > argc) {
+		fprintf(
+			stderr, "%s: [" OPT_JSON "] [" OPT_MAX_LINES "=N]\n", argv[0]
+		);
+
+		return EXIT_FAILURE;
+	}
+
+	// Only the assembly phases are measured in JSON, for it to stay valid.
+	if (json)
+		return bench_assembly_phases() ? EXIT_FAILURE: EXIT_SUCCESS;
+
+	for (i = 0; i < benches_no; i++) {
+		printf("Running `%s()'...\n", bench_names[i]);
+
+		if (benches[i]()) {
+			printf("FAILED.\n");
+			failed_no++;
+		}
+	}
+
+	return failed_no ? EXIT_FAILURE: EXIT_SUCCESS;
+}
+
+
+double bench_now(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec / 1E9;
+}
+
+
+// memcache.h
+int bench_memcache_growth(void) {
+	size_t const sizes[] = {1E3, 1E4, 1E5, 1E6, 4E6};
+	memcache_t *c;
+	tokenseq_t *s;
+	token_t t;
+	double begin, elapsed;
+	int64_t index;
+	size_t i, j;
+
+	printf("\t%10s %12s %12s\n", "tokens", "total (ms)", "ns/token");
+
+	for (i = 0; i < sizeof(sizes) / sizeof(size_t); i++) {
+		if ((c = n2t_memcache_alloc(1, sizeof(token_t))) == NULL)
+			return 1;
+		if ((s = n2t_tokenseq_alloc(1)) == NULL) {
+			n2t_memcache_free(c);
+			return 1;
+		}
+
+		memset(&t, 0, sizeof(token_t));
+		t.type = LABEL;
+		t.data.label.type = ROM;
+
+		begin = bench_now();
+
+		for (j = 0; j < sizes[i]; j++) {
+			// Tokens are made distinct by their label identifier alone, as if
+			// every one of them named a different label.
+			t.data.label.label = j;
+
+			if (
+				(index = n2t_memcache_intern(c, &t, sizeof(token_t))) < 0 ||
+				n2t_tokenseq_append_token_index(s, index)
+			) {
+				n2t_memcache_free(c);
+				n2t_tokenseq_free(s);
+
+				return 1;
+			}
+		}
+
+		elapsed = bench_now() - begin;
+		printf(
+			"\t%10lu %12.3f %12.2f\n", sizes[i], elapsed * 1E3,
+			elapsed * 1E9 / sizes[i]
+		);
+
+		n2t_memcache_free(c);
+		n2t_tokenseq_free(s);
+	}
+
+	return 0;
+}
+
+
+// lexer.h
+int bench_Cinstr_decoding(void) {
+	// Mnemonics at the end of the `comp' table are the slowest to look up by
+	// a linear scan.
+	char const *instrs[] = {
+		"0", "1", "-1", "D", "A", "!D", "!A", "-D", "-A", "D+1", "A+1", "D-1",
+		"A-1", "D+A", "D-A", "A-D", "D&A", "D|A", "M", "!M", "-M", "M+1",
+		"M-1", "D+M", "D-M", "M-D", "D&M", "D|M", "AM=M+1", "D;JGT", "D;JEQ",
+		"MD=D-1;JGE", "0;JMP", "AMD=D|M;JNE", "D=M", "M=D"
+	};
+	size_t const instrs_no = sizeof(instrs) / sizeof(char*), rounds = 2E5;
+	Cinstr_t c;
+	word_t checksum = 0;
+	double begin, elapsed;
+	size_t i, j;
+
+	begin = bench_now();
+
+	for (i = 0; i < rounds; i++) {
+		for (j = 0; j < instrs_no; j++) {
+			if (n2t_str_to_Cinstr(instrs[j], &c))
+				return 1;
+
+			checksum += c;
+		}
+	}
+
+	elapsed = bench_now() - begin;
+	printf(
+		"\t%lu instructions: %.3f ms, %.2f ns/instruction (checksum %04x)\n",
+		rounds * instrs_no, elapsed * 1E3, elapsed * 1E9 / (rounds * instrs_no),
+		checksum
+	);
+
+	return 0;
+}
+
+
+int bench_bitline_encoding(void) {
+	size_t const words_no = 1E6, rounds = 5;
+	word_t *words = malloc(words_no * sizeof(word_t));
+	char *lines = malloc(words_no * BITLINE_LENGTH);
+	double begin, elapsed = 0;
+	size_t written, i;
+
+	if (words == NULL || lines == NULL) {
+		free(words);
+		free(lines);
+
+		return 1;
+	}
+
+	// A cheap pseudo-random sequence, so that table lookups do not always hit
+	// the same entries.
+	for (i = 0; i < words_no; i++)
+		words[i] = i * 40503u;
+	// Page faults on the output buffer are not what is being measured.
+	memset(lines, 0, words_no * BITLINE_LENGTH);
+
+	for (i = 0; i < rounds; i++) {
+		begin = bench_now();
+		written = n2t_words_to_bitlines(words, words_no, lines);
+		begin = bench_now() - begin;
+
+		if (i == 0 || begin < elapsed)
+			elapsed = begin;
+	}
+
+	printf(
+		"\t%lu words: %.3f ms, %.2f ns/word (checksum %02x)\n", words_no,
+		elapsed * 1E3, elapsed * 1E9 / words_no,
+		(unsigned char) lines[written / 2]
+	);
+
+	free(words);
+	free(lines);
+
+	return 0;
+}
+
+// linescan.h
+int bench_line_splitting(void) {
+	linescan_kernel_t const kernels[] = {
+		LINESCAN_SCALAR, LINESCAN_SSE2, LINESCAN_AVX2
+	};
+	char const *kernel_names[] = {"scalar", "SSE2", "AVX2"};
+	char const *lines[] = {
+		"// Computes the sum of the first N integers.", "@i", "M=1", "@sum",
+		"M=0", "(LOOP)", "    @i", "    D=M // Loads i.", "    @N",
+		"    D=D-M", "    @END", "    D;JGT", "    @i", "    D=M",
+		"    @sum", "    M=D+M", "    @i", "    M=M+1", "    @LOOP",
+		"    0;JMP", "(END)", "    @END", "    0;JMP"
+	};
+	size_t const lines_no = sizeof(lines) / sizeof(char*), size = 1 << 26;
+	linespan_t spans[LINESCAN_BATCH];
+	linescan_t scan;
+	char *src;
+	size_t len = 0, total, n, i;
+	uint64_t checksum;
+	double begin, elapsed;
+
+	if ((src = malloc(size + BUFFSIZE_LARGE)) == NULL)
+		return 1;
+
+	for (i = 0; len < size; i++)
+		len += sprintf(src + len, "%s\n", lines[i % lines_no]);
+
+	for (i = 0; i < sizeof(kernels) / sizeof(linescan_kernel_t); i++) {
+		if (!n2t_linescan_supported(kernels[i])) {
+			printf("\t%-8s unsupported\n", kernel_names[i]);
+			continue;
+		}
+
+		n2t_linescan_init(&scan, src, len, kernels[i]);
+		total = checksum = 0;
+		begin = bench_now();
+
+		while ((n = n2t_linescan_next(&scan, spans, LINESCAN_BATCH)) > 0) {
+			total += n;
+			checksum += spans[n - 1].cut;
+		}
+
+		elapsed = bench_now() - begin;
+		printf(
+			"\t%-8s %lu lines in %.3f ms, %.2f GB/s (checksum %lx)\n",
+			kernel_names[i], total, elapsed * 1E3, len / elapsed / 1E9,
+			checksum
+		);
+	}
+
+	free(src);
+
+	return 0;
+}
+
+
+// parser.h
+int bench_assembly_phases(void) {
+	char *filenames[] = {
+		"Add.asm", "Max.asm", "Rect.asm", "PongL.asm", "Pong.asm"
+	};
+	size_t const filenames_no = sizeof(filenames) / sizeof(char*);
+	char filepath[BUFFSIZE_LARGE];
+	benchinput_t in;
+	workload_t w;
+	filemap_t map;
+	size_t nlines = 1E3, i;
+	int error = 0, first = 1;
+
+	if (json) {
+		printf("{\n\t\"inputs\": [");
+	} else {
+		printf(
+			"\t%-16s %9s %6s %-18s %10s %10s %10s %9s\n", "input", "lines",
+			"rounds", "phase", "median(ms)", "p99(ms)", "Mlines/s", "MB/s"
+		);
+	}
+
+	// Fixtures first, then synthetic programs ten times larger each time.
+	for (i = 0; !error && (i < filenames_no || nlines <= max_lines); i++) {
+		memset(&in, 0, sizeof(benchinput_t));
+
+		if (i < filenames_no) {
+			n2t_join(
+				filepath, BUFFSIZE_LARGE, 3, TEST_DIR_ROOT,
+				"test_assembler_batch/", filenames[i]
+			);
+
+			if (n2t_filemap_open(filepath, &map))
+				return 1;
+
+			in.src = malloc(map.length + 1);
+
+			if (in.src)
+				memcpy(in.src, map.data, map.length);
+
+			in.len = map.length;
+			n2t_filemap_close(&map);
+			snprintf(in.name, BUFFSIZE_LARGE, "%s", filenames[i]);
+		} else {
+			// Programs of the same size are the same from one run to another.
+			n2t_workload_defaults(&w, nlines, nlines);
+
+			if (n2t_workload_generate(&w, &in.src, &in.len, NULL, NULL, NULL, 0))
+				in.src = NULL;
+
+			snprintf(in.name, BUFFSIZE_LARGE, "synthetic-%lu", nlines);
+			nlines *= 10;
+		}
+
+		if (in.src == NULL)
+			return 1;
+
+		in.nlines = bench_count_lines(in.src, in.len);
+		error = bench_time_phases(&in);
+
+		if (!error) {
+			bench_report_phases(&in, first);
+			first = 0;
+		}
+
+		for (size_t k = 0; k < PHASES_NO; k++)
+			free(in.times[k]);
+
+		free(in.src);
+	}
+
+	if (json)
+		printf("\n\t]\n}\n");
+
+	return error;
+}
+
+
+static int bench_time_phases(benchinput_t *in) {
+	emitopts_t const format = {0, 0, ROMIMAGE_LITTLE};
+	benchoutput_t output = {NULL, 0};
+	arena_t *arena = n2t_arena_alloc(n2t_parse_arena_hint(in->len));
+	parseopts_t const opts = {NULL, 0, 0, arena};
+	tokenseq_t *s;
+	symtable_t *symbols;
+	double begin, mark, now, spent = 0;
+	size_t round, nwords, k;
+	int error = 0;
+
+	in->nrounds = PHASES_MAX_ROUNDS;
+
+	for (k = 0; k < PHASES_NO; k++) {
+		if ((in->times[k] = malloc(in->nrounds * sizeof(double))) == NULL)
+			error = 1;
+	}
+
+	if (error || arena == NULL) {
+		if (arena)
+			n2t_arena_free(arena);
+
+		return 1;
+	}
+
+	// Every round starts from scratch, the arena being emptied in between.
+	for (round = 0; round < in->nrounds && !error; round++) {
+		n2t_arena_reset(arena);
+		begin = mark = bench_now();
+
+		s = n2t_tokenize_buffer_in(in->src, in->len, arena);
+		now = bench_now();
+		in->times[PHASE_TOKENIZE][round] = now - mark;
+		mark = now;
+
+		symbols = s ?
+			n2t_symtable_alloc_in(n2t_strtable_length(s->labels), arena): NULL;
+
+		if (
+			symbols == NULL ||
+			n2t_seed_ram_labels(s->labels, symbols, &opts, NULL, 0) ||
+			n2t_parse_rom_labels(s, symbols, NULL, 0)
+		) {
+			error = 1;
+			break;
+		}
+
+		now = bench_now();
+		in->times[PHASE_PARSE_ROM_LABELS][round] = now - mark;
+		mark = now;
+
+		n2t_assign_rom_labels(s, symbols);
+		now = bench_now();
+		in->times[PHASE_ASSIGN_ROM_LABELS][round] = now - mark;
+		mark = now;
+
+		n2t_assign_ram_labels(s, symbols);
+		now = bench_now();
+		in->times[PHASE_ASSIGN_RAM_LABELS][round] = now - mark;
+		mark = now;
+
+		// Room for every token is made once, on the first round.
+		if (output.data == NULL) {
+			output.capacity = n2t_emit_length(&format, s->next);
+			output.data = malloc(output.capacity + 1);
+		}
+
+		error = n2t_emit_tokenseq(
+			s, &format, 1, bench_reserve_output, &output, &nwords
+		);
+		now = bench_now();
+		in->times[PHASE_EMIT][round] = now - mark;
+		in->times[PHASE_TOTAL][round] = now - begin;
+
+		// Large inputs take fewer rounds, within the time budget.
+		spent += now - begin;
+
+		if (round + 1 >= PHASES_MIN_ROUNDS && spent > PHASES_BUDGET)
+			in->nrounds = round + 1;
+	}
+
+	free(output.data);
+	n2t_arena_free(arena);
+
+	return error;
+}
+
+static void bench_report_phases(benchinput_t const *in, int first) {
+	char const *phase_names[] = {
+		"tokenize", "parse_rom_labels", "assign_rom_labels",
+		"assign_ram_labels", "emit", "total"
+	};
+	double sorted[in->nrounds], median, p99;
+	size_t k;
+
+	if (json) {
+		printf(
+			"%s\n\t\t{\n\t\t\t\"name\": \"%s\", \"lines\": %lu, \"bytes\": %lu, "
+			"\"rounds\": %lu,\n\t\t\t\"phases\": {", first ? "": ",", in->name,
+			in->nlines, in->len, in->nrounds
+		);
+	}
+
+	for (k = 0; k < PHASES_NO; k++) {
+		memcpy(sorted, in->times[k], in->nrounds * sizeof(double));
+		qsort(sorted, in->nrounds, sizeof(double), bench_compare_times);
+
+		median = sorted[in->nrounds / 2];
+		p99 = sorted[(in->nrounds * 99 + 99) / 100 - 1];
+		// Phases too quick for the clock still get a finite throughput.
+		median = MAX(median, 1E-9);
+
+		if (json) {
+			printf(
+				"%s\n\t\t\t\t\"%s\": {\"median_ms\": %.6f, \"p99_ms\": %.6f, "
+				"\"lines_per_s\": %.0f, \"mb_per_s\": %.3f}", k ? ",": "",
+				phase_names[k], median * 1E3, p99 * 1E3, in->nlines / median,
+				in->len / median / 1E6
+			);
+		} else {
+			printf(
+				"\t%-16s %9lu %6lu %-18s %10.3f %10.3f %10.2f %9.1f\n",
+				k ? "": in->name, in->nlines, in->nrounds, phase_names[k],
+				median * 1E3, p99 * 1E3, in->nlines / median / 1E6,
+				in->len / median / 1E6
+			);
+		}
+	}
+
+	if (json)
+		printf("\n\t\t\t}\n\t\t}");
+}
+
+static size_t bench_count_lines(char const *src, size_t len) {
+	size_t n = 0;
+	char const *end = src + len;
+
+	while ((src = memchr(src, '\n', end - src)) != NULL) {
+		src++;
+		n++;
+	}
+
+	return n + (len > 0 && end[-1] != '\n');
+}
+
+static int bench_compare_times(void const *a, void const *b) {
+	double const x = *(double const*) a, y = *(double const*) b;
+
+	return (x > y) - (x < y);
+}
+
+static char* bench_reserve_output(size_t length, void *output) {
+	benchoutput_t *const o = output;
+
+	return length <= o->capacity ? o->data: NULL;
+}
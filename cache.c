@@ -0,0 +1,320 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#include "utils.h"
+#include "hash.h"
+#include "cache.h"
+
+
+// Length of the name of an entry: its key, in hexadecimal.
+#define	CACHE_NAME_LENGTH 16
+
+/**
+ * An entry met by `n2t_cache_trim()'.
+ */
+typedef struct {
+	char name[CACHE_NAME_LENGTH + 1];
+	uint64_t size;
+	struct timespec used;
+} cacheentry_t;
+
+/**
+ * Stores into `dest' the path of the file `name' within the directory of `c'.
+ *
+ * Returns: `1' if the path does not fit `PATH_MAX' bytes, `0' otherwise.
+ */
+static int n2t_cache_path(cache_t const *c, char const *name, char *dest);
+/**
+ * Writes the `len' bytes at `data' to `output_path', unless it already holds
+ * them. If `source_fd' is not `-1', it is a file holding the same bytes, whose
+ * blocks are shared with the output if possible.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_cache_install(
+	cache_t *c, char const *output_path, void const *data, size_t len,
+	int source_fd
+);
+/**
+ * Evicts the least recently used entries of `c' until they take no more than
+ * three quarters of its limit, leaving room for further entries before the
+ * next eviction. `c->lock' must be held.
+ */
+static void n2t_cache_trim(cache_t *c);
+/**
+ * `scandir()' filter keeping the entries of a cache.
+ */
+static int n2t_cache_is_entry(struct dirent const *entry);
+/**
+ * `qsort()' comparator ordering `cacheentry_t' by increasing time of use.
+ */
+static int n2t_cache_compare_use(void const *a, void const *b);
+
+
+int n2t_cache_open(char const *dir, uint64_t limit, cache_t *dest) {
+	struct stat info;
+
+	if (strlen(dir) + 1 + CACHE_NAME_LENGTH >= PATH_MAX)
+		return 1;
+
+	if (mkdir(dir, 0755) && errno != EEXIST)
+		return 1;
+
+	if (stat(dir, &info) || !S_ISDIR(info.st_mode))
+		return 1;
+
+	if (pthread_mutex_init(&dest->lock, NULL))
+		return 1;
+
+	strcpy(dest->dir, dir);
+	dest->limit = limit;
+	dest->size = 0;
+	memset(&dest->stats, 0, sizeof(cachestats_t));
+
+	// Sizes up the entries left by previous runs, evicting some if needed.
+	pthread_mutex_lock(&dest->lock);
+	n2t_cache_trim(dest);
+	pthread_mutex_unlock(&dest->lock);
+
+	return 0;
+}
+
+void n2t_cache_close(cache_t *c) {
+	pthread_mutex_destroy(&c->lock);
+}
+
+uint64_t n2t_cache_key(void const *src, size_t len, uint64_t salt) {
+	return n2t_hash64(src, len, salt);
+}
+
+int n2t_cache_fetch(
+	cache_t *c, uint64_t key, char const *output_path, size_t *length
+) {
+	char name[CACHE_NAME_LENGTH + 1], path[PATH_MAX];
+	struct stat info;
+	void *data = NULL;
+	int fd, error;
+
+	snprintf(name, sizeof(name), "%016" PRIx64, key);
+
+	if (n2t_cache_path(c, name, path))
+		return 1;
+
+	if ((fd = open(path, O_RDONLY)) < 0 && errno == ENOENT) {
+		pthread_mutex_lock(&c->lock);
+		c->stats.misses++;
+		pthread_mutex_unlock(&c->lock);
+
+		return CACHE_MISS;
+	} else if (fd < 0) {
+		return 1;
+	}
+
+	if (
+		fstat(fd, &info) || (
+			info.st_size > 0 &&
+			(data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+				MAP_FAILED
+		)
+	) {
+		close(fd);
+		return 1;
+	}
+
+	error = n2t_cache_install(c, output_path, data, info.st_size, fd);
+
+	if (data)
+		munmap(data, info.st_size);
+
+	close(fd);
+
+	if (error)
+		return 1;
+
+	// The modification time tells the last use of an entry.
+	utimensat(AT_FDCWD, path, NULL, 0);
+	*length = info.st_size;
+
+	pthread_mutex_lock(&c->lock);
+	c->stats.hits++;
+	pthread_mutex_unlock(&c->lock);
+
+	return 0;
+}
+
+int n2t_cache_store(
+	cache_t *c, uint64_t key, void const *data, size_t len,
+	char const *output_path
+) {
+	char name[CACHE_NAME_LENGTH + 1], path[PATH_MAX], tmp_path[PATH_MAX];
+	int fd, stored = 0;
+
+	snprintf(name, sizeof(name), "%016" PRIx64, key);
+
+	// Renaming a complete file into place keeps other processes from reading
+	// a partial entry.
+	if (
+		!n2t_cache_path(c, name, path) &&
+		!n2t_cache_path(c, ".tmp-XXXXXX", tmp_path) &&
+		(fd = mkstemp(tmp_path)) >= 0
+	) {
+		if (fchmod(fd, 0644) == 0 && n2t_write_all(fd, data, len) == 0) {
+			stored = close(fd) == 0 && rename(tmp_path, path) == 0;
+		} else {
+			close(fd);
+		}
+
+		if (stored) {
+			pthread_mutex_lock(&c->lock);
+			c->size += len;
+
+			if (c->limit > 0 && c->size > c->limit)
+				n2t_cache_trim(c);
+
+			pthread_mutex_unlock(&c->lock);
+		} else {
+			unlink(tmp_path);
+		}
+	}
+
+	return n2t_cache_install(c, output_path, data, len, -1);
+}
+
+
+static int n2t_cache_path(cache_t const *c, char const *name, char *dest) {
+	return snprintf(dest, PATH_MAX, "%s/%s", c->dir, name) >= PATH_MAX;
+}
+
+static int n2t_cache_install(
+	cache_t *c, char const *output_path, void const *data, size_t len,
+	int source_fd
+) {
+	filemap_t current;
+	int fd, same;
+
+	// Leaving an identical output untouched keeps its modification time,
+	// which build tools rely on.
+	if (n2t_filemap_open(output_path, &current) == 0) {
+		same = current.length == len && !memcmp(current.data, data, len);
+		n2t_filemap_close(&current);
+
+		if (same) {
+			pthread_mutex_lock(&c->lock);
+			c->stats.unchanged++;
+			pthread_mutex_unlock(&c->lock);
+
+			return 0;
+		}
+	}
+
+	if ((fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		return 1;
+
+#ifdef FICLONE
+	if (source_fd >= 0 && ioctl(fd, FICLONE, source_fd) == 0)
+		return close(fd) != 0;
+#endif
+
+	if (n2t_write_all(fd, data, len)) {
+		close(fd);
+		return 1;
+	}
+
+	return close(fd) != 0;
+}
+
+static void n2t_cache_trim(cache_t *c) {
+	struct dirent **names;
+	struct stat info;
+	cacheentry_t *entries;
+	char path[PATH_MAX];
+	uint64_t size = 0;
+	int nnames, nentries = 0, i;
+
+	if ((nnames = scandir(c->dir, &names, n2t_cache_is_entry, NULL)) < 0)
+		return;
+
+	entries = malloc(MAX(nnames, 1) * sizeof(cacheentry_t));
+
+	for (i = 0; i < nnames; i++) {
+		if (
+			entries && !n2t_cache_path(c, names[i]->d_name, path) &&
+			stat(path, &info) == 0
+		) {
+			strcpy(entries[nentries].name, names[i]->d_name);
+			entries[nentries].size = info.st_size;
+			entries[nentries].used = info.st_mtim;
+			size += info.st_size;
+			nentries++;
+		}
+
+		free(names[i]);
+	}
+
+	free(names);
+
+	if (entries == NULL)
+		return;
+
+	if (c->limit > 0 && size > c->limit) {
+		qsort(entries, nentries, sizeof(cacheentry_t), n2t_cache_compare_use);
+
+		for (i = 0; i < nentries && size > c->limit / 4 * 3; i++) {
+			n2t_cache_path(c, entries[i].name, path);
+
+			if (unlink(path) == 0) {
+				size -= entries[i].size;
+				c->stats.evicted++;
+			}
+		}
+	}
+
+	c->size = size;
+	free(entries);
+}
+
+static int n2t_cache_is_entry(struct dirent const *entry) {
+	return strlen(entry->d_name) == CACHE_NAME_LENGTH &&
+		strspn(entry->d_name, "0123456789abcdef") == CACHE_NAME_LENGTH;
+}
+
+static int n2t_cache_compare_use(void const *a, void const *b) {
+	struct timespec const x = ((cacheentry_t const*) a)->used;
+	struct timespec const y = ((cacheentry_t const*) b)->used;
+
+	if (x.tv_sec != y.tv_sec)
+		return x.tv_sec < y.tv_sec ? -1: 1;
+
+	return (x.tv_nsec > y.tv_nsec) - (x.tv_nsec < y.tv_nsec);
+}
@@ -0,0 +1,105 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+
+
+// Returned by `n2t_cache_fetch()' when no entry matches the key.
+#define	CACHE_MISS 2
+// Default size limit of a cache, in bytes.
+#define	CACHE_DEFAULT_LIMIT (256ULL << 20)
+// Bumped whenever the assembler output changes for the same input, so that
+// older entries are no longer matched. Meant to seed the key salt.
+#define	CACHE_VERSION 1
+
+/**
+ * Counters of the outcomes of cache operations: `hits' and `misses' of
+ * `n2t_cache_fetch()', outputs left `unchanged' since they already held the
+ * right contents, and entries `evicted' to honour the size limit.
+ */
+typedef struct {
+	size_t hits, misses, unchanged, evicted;
+} cachestats_t;
+
+/**
+ * A content-addressed store of assembled programs, kept as files named after
+ * their 64-bit key within directory `dir'. Entries are written to temporary
+ * files and renamed into place, so that several processes may share a cache.
+ *
+ * `size' is the total size of the entries as last known, which is kept under
+ * `limit' by evicting the least recently used ones. A `limit' of `0' means no
+ * limit. `lock' protects `size' and `stats', for threads to share a cache.
+ */
+typedef struct {
+	char dir[PATH_MAX];
+	uint64_t limit, size;
+	pthread_mutex_t lock;
+	cachestats_t stats;
+} cache_t;
+
+
+/**
+ * Opens the cache in directory `dir', creating the latter if needed.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+int n2t_cache_open(char const *dir, uint64_t limit, cache_t *dest);
+/**
+ * Releases the resources of `c'. Its entries are left in place.
+ */
+void n2t_cache_close(cache_t *c);
+/**
+ * Returns: the key of the `len' bytes at `src', assembled with options summed
+ * up by `salt'.
+ */
+uint64_t n2t_cache_key(void const *src, size_t len, uint64_t salt);
+/**
+ * Copies the entry of `key', if any, to `output_path'. The copy shares the
+ * blocks of the entry where the file system supports it, and is skipped if
+ * `output_path' already holds the same contents.
+ *
+ * Returns: `0' on a hit, storing the size of the entry into `length',
+ * `CACHE_MISS' on a miss, `1' if the entry could not be copied.
+ */
+int n2t_cache_fetch(
+	cache_t *c, uint64_t key, char const *output_path, size_t *length
+);
+/**
+ * Stores the `len' bytes at `data' as the entry of `key', evicting older
+ * entries if the size limit is exceeded, then writes them to `output_path'
+ * unless it already holds the same contents. Failing to store the entry is
+ * not an error, since the cache is only an optimization.
+ *
+ * Returns: `1' if `output_path' could not be written, `0' otherwise.
+ */
+int n2t_cache_store(
+	cache_t *c, uint64_t key, void const *data, size_t len,
+	char const *output_path
+);
+
+
+#endif
@@ -0,0 +1,181 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "utils.h"
+#include "workload.h"
+
+
+#define	OPT_LINES "--lines"
+#define	OPT_SEED "--seed"
+#define	OPT_VARIABLES "--variables"
+#define	OPT_MAX_INDENT "--max-indent"
+#define	OPT_MAX_COMMENT "--max-comment"
+#define	OPT_LABEL_DENSITY "--label-density"
+#define	OPT_COMMENT_RATIO "--comment-ratio"
+#define	OPT_BLANK_RATIO "--blank-ratio"
+#define	OPT_TRAILING_RATIO "--trailing-ratio"
+#define	OPT_CINSTR_RATIO "--cinstr-ratio"
+#define	OPT_JUMP_RATIO "--jump-ratio"
+#define	OPT_HACK "--hack"
+
+#define	USAGE "[" OPT_LINES "=N] [" OPT_SEED "=N] [" OPT_VARIABLES "=N] " \
+	"[" OPT_MAX_INDENT "=N] [" OPT_MAX_COMMENT "=N] [" OPT_LABEL_DENSITY \
+	"=F] [" OPT_COMMENT_RATIO "=F] [" OPT_BLANK_RATIO "=F] [" \
+	OPT_TRAILING_RATIO "=F] [" OPT_CINSTR_RATIO "=F] [" OPT_JUMP_RATIO \
+	"=F] [" OPT_HACK "=FILE] [FILE]"
+
+// Number of lines of a program unless `OPT_LINES' says otherwise.
+#define	DEFAULT_LINES 100000
+
+
+/**
+ * Returns: the value of `arg' if it has the form `<option>=<value>', `NULL'
+ * otherwise.
+ */
+static char* n2t_option_value(char *arg, char const *option);
+/**
+ * Writes the `len' bytes at `data' to `filepath', or to the standard output if
+ * `filepath' is `NULL'.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_write_file(char const *filepath, char const *data, size_t len);
+
+
+int main(int argc, char *argv[]) {
+	workload_t w;
+	char *value, *end, *src, *hack = NULL, *output = NULL, *hack_output = NULL;
+	char errmsg[BUFFSIZE_VLARGE];
+	size_t len, hacklen;
+	int argi, usage = 0, error = 0;
+	struct {
+		char const *option;
+		size_t *dest;
+	} const sizes[] = {
+		{OPT_LINES, &w.nlines}, {OPT_VARIABLES, &w.nvariables},
+		{OPT_MAX_INDENT, &w.max_indent}, {OPT_MAX_COMMENT, &w.max_comment}
+	};
+	struct {
+		char const *option;
+		double *dest;
+	} const ratios[] = {
+		{OPT_LABEL_DENSITY, &w.label_density},
+		{OPT_COMMENT_RATIO, &w.comment_ratio},
+		{OPT_BLANK_RATIO, &w.blank_ratio},
+		{OPT_TRAILING_RATIO, &w.trailing_ratio},
+		{OPT_CINSTR_RATIO, &w.cinstr_ratio}, {OPT_JUMP_RATIO, &w.jump_ratio}
+	};
+	size_t const sizes_no = sizeof(sizes) / sizeof(sizes[0]);
+	size_t const ratios_no = sizeof(ratios) / sizeof(ratios[0]);
+	size_t i;
+
+	n2t_workload_defaults(&w, DEFAULT_LINES, 0);
+
+	for (argi = 1; argi < argc && !usage; argi++) {
+		value = NULL;
+
+		for (i = 0; i < sizes_no && value == NULL; i++) {
+			if ((value = n2t_option_value(argv[argi], sizes[i].option))) {
+				*sizes[i].dest = strtoul(value, &end, 10);
+				usage = *value == '\0' || *value == '-' || *end != '\0';
+			}
+		}
+
+		for (i = 0; i < ratios_no && value == NULL; i++) {
+			if ((value = n2t_option_value(argv[argi], ratios[i].option))) {
+				*ratios[i].dest = strtod(value, &end);
+				usage = *value == '\0' || *end != '\0';
+			}
+		}
+
+		if (value) {
+			continue;
+		} else if ((value = n2t_option_value(argv[argi], OPT_SEED))) {
+			w.seed = strtoull(value, &end, 10);
+			usage = *value == '\0' || *value == '-' || *end != '\0';
+		} else if ((value = n2t_option_value(argv[argi], OPT_HACK))) {
+			hack_output = value;
+		} else if (strncmp(argv[argi], "--", 2) && output == NULL) {
+			output = argv[argi];
+		} else {
+			usage = 1;
+		}
+	}
+
+	if (usage) {
+		fprintf(stderr, "%s: " USAGE "\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (
+		n2t_workload_generate(
+			&w, &src, &len, hack_output ? &hack: NULL, &hacklen, errmsg,
+			BUFFSIZE_VLARGE
+		)
+	) {
+		fprintf(stderr, "%s: %s.\n", argv[0], errmsg);
+		return EXIT_FAILURE;
+	}
+
+	if (n2t_write_file(output, src, len)) {
+		fprintf(
+			stderr, "%s: could not write `%s'.\n", argv[0],
+			output ? output: "stdout"
+		);
+		error = 1;
+	} else if (hack_output && n2t_write_file(hack_output, hack, hacklen)) {
+		fprintf(stderr, "%s: could not write `%s'.\n", argv[0], hack_output);
+		error = 1;
+	}
+
+	free(src);
+	free(hack);
+
+	return error ? EXIT_FAILURE: EXIT_SUCCESS;
+}
+
+
+static char* n2t_option_value(char *arg, char const *option) {
+	size_t const len = strlen(option);
+
+	return !strncmp(arg, option, len) && arg[len] == '=' ? arg + len + 1: NULL;
+}
+
+static int n2t_write_file(char const *filepath, char const *data, size_t len) {
+	int fd = STDOUT_FILENO, error;
+
+	if (filepath) {
+		if ((fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+			return 1;
+	}
+
+	error = n2t_write_all(fd, data, len);
+
+	if (filepath && close(fd))
+		error = 1;
+
+	return error != 0;
+}
@@ -0,0 +1,297 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "hackasm.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+
+/**
+ * A share of the instructions of a token sequence, encoded and formatted by a
+ * single thread of `n2t_emit_tokenseq()'. Tokens `[begin, end)' hold
+ * `ninstrs' instructions, the first one being instruction `first' of the
+ * program. Their output starts at `dest + first * width'.
+ */
+typedef struct {
+	tokenseq_t const *s;
+	emitopts_t const *o;
+	uint32_t begin, end;
+	size_t ninstrs, first, width;
+	char *dest;
+} emitjob_t;
+
+/**
+ * Runs `routine' on each of the `njobs' jobs of `size' bytes at `jobs', each
+ * on its own thread, and waits for them to complete. Jobs whose thread could
+ * not be started, or all of them if the thread handles could not be
+ * allocated, are run by the calling thread.
+ */
+static void n2t_run_jobs(
+	void* (*routine)(void*), void *jobs, size_t njobs, size_t size
+);
+/**
+ * Thread routine counting the instructions of the `emitjob_t' at `job'.
+ */
+static void* n2t_count_instrs(void *job);
+/**
+ * Thread routine encoding and formatting the instructions of the `emitjob_t'
+ * at `job'.
+ */
+static void* n2t_format_instrs(void *job);
+/**
+ * An `emitreserve_t' allocating the output on the heap, storing a pointer to
+ * it into the `char*' at `dest'.
+ */
+static char* n2t_emit_alloc(size_t length, void *dest);
+
+
+size_t n2t_emit_width(emitopts_t const *o) {
+	return o->binary ? sizeof(word_t): BITLINE_LENGTH;
+}
+
+size_t n2t_emit_offset(emitopts_t const *o) {
+	return o->binary && o->header ? ROMIMAGE_HEADER_SIZE: 0;
+}
+
+size_t n2t_emit_length(emitopts_t const *o, size_t n) {
+	return n2t_emit_offset(o) + n * n2t_emit_width(o);
+}
+
+size_t n2t_emit_words(
+	emitopts_t const *o, word_t const *words, size_t n, char *dest
+) {
+	if (o->binary)
+		return n2t_romimage_write(words, n, o->endian, 0, (uint8_t*) dest);
+
+	return n2t_words_to_bitlines(words, n, dest);
+}
+
+size_t n2t_emit_image(
+	emitopts_t const *o, word_t const *words, size_t n, char *dest
+) {
+	if (o->binary) {
+		return n2t_romimage_write(
+			words, n, o->endian, o->header, (uint8_t*) dest
+		);
+	}
+
+	return n2t_words_to_bitlines(words, n, dest);
+}
+
+int n2t_emit_tokenseq(
+	tokenseq_t const *s, emitopts_t const *o, unsigned nthreads,
+	emitreserve_t reserve, void *arg, size_t *nwords
+) {
+	size_t const width = n2t_emit_width(o), offset = n2t_emit_offset(o);
+	emitjob_t *jobs;
+	char *data;
+	unsigned i;
+
+	// Threads beyond one per token would be left without any.
+	nthreads = MIN(nthreads, MIN(s->next, PARSER_MAX_THREADS));
+	nthreads = MAX(nthreads, 1);
+
+	if ((jobs = calloc(nthreads, sizeof(emitjob_t))) == NULL)
+		return 1;
+
+	// Tokens are shared out evenly. How many instructions each share holds,
+	// and hence where its output begins, is only known once counted.
+	for (i = 0; i < nthreads; i++) {
+		jobs[i].s = s;
+		jobs[i].o = o;
+		jobs[i].begin = (uint64_t) s->next * i / nthreads;
+		jobs[i].end = (uint64_t) s->next * (i + 1) / nthreads;
+		jobs[i].width = width;
+	}
+
+	// A single thread takes every token, whose instructions were counted
+	// along with the ROM labels.
+	if (nthreads > 1) {
+		n2t_run_jobs(n2t_count_instrs, jobs, nthreads, sizeof(emitjob_t));
+	} else {
+		jobs[0].ninstrs = s->ninstrs;
+	}
+
+	for (i = 1; i < nthreads; i++)
+		jobs[i].first = jobs[i - 1].first + jobs[i - 1].ninstrs;
+
+	*nwords = jobs[nthreads - 1].first + jobs[nthreads - 1].ninstrs;
+
+	if ((data = reserve(offset + *nwords * width, arg)) == NULL) {
+		free(jobs);
+		return 1;
+	}
+
+	for (i = 0; i < nthreads; i++)
+		jobs[i].dest = data + offset;
+
+	if (nthreads > 1) {
+		n2t_run_jobs(n2t_format_instrs, jobs, nthreads, sizeof(emitjob_t));
+	} else {
+		n2t_format_instrs(jobs);
+		*nwords = jobs[0].ninstrs;
+	}
+
+	if (o->binary && o->header) {
+		n2t_romimage_write_header(
+			*nwords,
+			n2t_romimage_checksum_bytes(
+				(uint8_t*) data + offset, *nwords, o->endian
+			),
+			o->endian, (uint8_t*) data
+		);
+	}
+
+	free(jobs);
+
+	return 0;
+}
+
+int n2t_assemble_buffer(
+	char const *src, size_t len, parseopts_t const *opts, word_t **words,
+	size_t *nwords, char errmsg[], size_t maxwrite
+) {
+	asmstats_t *const stats = opts ? opts->stats: NULL;
+	statsmark_t mark;
+	tokenseq_t *s;
+	uint32_t from = 0;
+
+	if ((s = n2t_parse_buffer(src, len, opts, errmsg, maxwrite)) == NULL)
+		return 1;
+
+	n2t_stats_start(stats, &mark);
+
+	// Labels take no word: the tokens bound the number of instructions.
+	if ((*words = malloc(MAX(s->next, 1) * sizeof(word_t))) == NULL) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not allocate the words");
+
+		n2t_tokenseq_free(s);
+
+		return 1;
+	}
+
+	*nwords = n2t_tokenseq_encode(s, &from, *words, s->next);
+	n2t_stats_lap(stats, STATS_EMIT, &mark);
+	n2t_tokenseq_free(s);
+
+	return 0;
+}
+
+int n2t_assemble_image(
+	char const *src, size_t len, parseopts_t const *opts,
+	emitopts_t const *emit, char **dest, size_t *length, char errmsg[],
+	size_t maxwrite
+) {
+	asmstats_t *const stats = opts ? opts->stats: NULL;
+	statsmark_t mark;
+	tokenseq_t *s;
+	size_t nwords;
+	int error;
+
+	if ((s = n2t_parse_buffer(src, len, opts, errmsg, maxwrite)) == NULL)
+		return 1;
+
+	n2t_stats_start(stats, &mark);
+	*dest = NULL;
+	error = n2t_emit_tokenseq(
+		s, emit, opts ? opts->nthreads: 1, n2t_emit_alloc, dest, &nwords
+	);
+	n2t_stats_lap(stats, STATS_EMIT, &mark);
+	n2t_tokenseq_free(s);
+
+	if (error) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not allocate the output");
+
+		return 1;
+	}
+
+	*length = n2t_emit_length(emit, nwords);
+
+	return 0;
+}
+
+
+static void n2t_run_jobs(
+	void* (*routine)(void*), void *jobs, size_t njobs, size_t size
+) {
+	pthread_t *threads = malloc(njobs * sizeof(pthread_t));
+	int *started = calloc(njobs, sizeof(int));
+	size_t i;
+
+	for (i = 0; i < njobs && threads && started; i++) {
+		started[i] = !pthread_create(
+			threads + i, NULL, routine, (char*) jobs + i * size
+		);
+	}
+
+	for (i = 0; i < njobs; i++) {
+		if (started && started[i])
+			pthread_join(threads[i], NULL);
+		else
+			routine((char*) jobs + i * size);
+	}
+
+	free(threads);
+	free(started);
+}
+
+static void* n2t_count_instrs(void *job) {
+	emitjob_t *const j = job;
+	uint32_t i;
+
+	for (i = j->begin; i < j->end; i++) {
+		if (n2t_tokenseq_index_get(j->s, i)->type == INSTR)
+			j->ninstrs++;
+	}
+
+	return j;
+}
+
+static void* n2t_format_instrs(void *job) {
+	emitjob_t *const j = job;
+	word_t words[BUFFSIZE_XLARGE];
+	char *dest = j->dest + j->first * j->width;
+	uint32_t from = j->begin;
+	size_t n, done = 0;
+
+	// Either all instructions of the share are encoded, or tokens run out.
+	while (
+		done < j->ninstrs &&
+		(n = n2t_tokenseq_encode(
+			j->s, &from, words, MIN(j->ninstrs - done, BUFFSIZE_XLARGE)
+		)) > 0
+	) {
+		dest += n2t_emit_words(j->o, words, n, dest);
+		done += n;
+	}
+
+	j->ninstrs = done;
+
+	return j;
+}
+
+static char* n2t_emit_alloc(size_t length, void *dest) {
+	// An empty output still gets a buffer of its own.
+	return *(char**) dest = malloc(length + 1);
+}
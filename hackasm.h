@@ -0,0 +1,127 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef HACKASM_H
+#define HACKASM_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "lexer.h"
+#include "parser.h"
+#include "romimage.h"
+
+
+/**
+ * Format of an assembled program: `.hack' text, a line of `BITLINE_LENGTH'
+ * characters per instruction, or if `binary' is set a ROM image of words in
+ * `endian' byte order, preceded by its header if `header' is set. A zeroed-out
+ * `emitopts_t' stands for `.hack' text.
+ */
+typedef struct {
+	int binary, header;
+	romendian_t endian;
+} emitopts_t;
+
+/**
+ * Receives the `length' bytes an output is about to take, along with the
+ * argument given to `n2t_emit_tokenseq()'.
+ *
+ * Returns: where to format the output, at least `length' bytes large, or
+ * `NULL' if an error occurs.
+ */
+typedef char* (*emitreserve_t)(size_t length, void *arg);
+
+
+/**
+ * Returns: the number of bytes each instruction takes in format `o'.
+ */
+size_t n2t_emit_width(emitopts_t const *o);
+/**
+ * Returns: the number of bytes preceding the first instruction in format `o',
+ * those of the image header if any.
+ */
+size_t n2t_emit_offset(emitopts_t const *o);
+/**
+ * Returns: the number of bytes of a program of `n' instructions in format
+ * `o', header included.
+ */
+size_t n2t_emit_length(emitopts_t const *o, size_t n);
+/**
+ * Formats the `n' words at `words' into `dest', as a run of instructions in
+ * format `o', without any header.
+ *
+ * Returns: the number of bytes written to `dest'.
+ */
+size_t n2t_emit_words(
+	emitopts_t const *o, word_t const *words, size_t n, char *dest
+);
+/**
+ * Formats the program made of the `n' words at `words' into `dest', which
+ * must be at least `n2t_emit_length(o, n)' bytes large, header included.
+ *
+ * Returns: the number of bytes written to `dest'.
+ */
+size_t n2t_emit_image(
+	emitopts_t const *o, word_t const *words, size_t n, char *dest
+);
+/**
+ * Encodes the instructions of `s' and formats them in format `o' with
+ * `nthreads' threads. Since every instruction takes the same number of bytes,
+ * each thread formats its share of instructions straight into its final
+ * position within the output, obtained from `reserve' once its length is
+ * known. `s' must have had its ROM labels parsed, which counts its
+ * instructions: a single thread gets its exact length from that count.
+ *
+ * Param `nwords': receives the number of instructions, so that the output
+ * takes `n2t_emit_length(o, *nwords)' bytes.
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+int n2t_emit_tokenseq(
+	tokenseq_t const *s, emitopts_t const *o, unsigned nthreads,
+	emitreserve_t reserve, void *arg, size_t *nwords
+);
+/**
+ * Assembles the program held by the `len' bytes at `src' according to
+ * `opts', which may be `NULL', without touching the file system.
+ *
+ * Param `words': receives the `*nwords' machine words of the program, to be
+ * freed by the caller.
+ * Param `errmsg': same as for `n2t_parse()'.
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+int n2t_assemble_buffer(
+	char const *src, size_t len, parseopts_t const *opts, word_t **words,
+	size_t *nwords, char errmsg[], size_t maxwrite
+);
+/**
+ * Same as `n2t_assemble_buffer()', formatting the program in format `emit'.
+ *
+ * Param `dest': receives the `*length' bytes of the output, to be freed by
+ * the caller.
+ */
+int n2t_assemble_image(
+	char const *src, size_t len, parseopts_t const *opts,
+	emitopts_t const *emit, char **dest, size_t *length, char errmsg[],
+	size_t maxwrite
+);
+
+
+#endif
@@ -0,0 +1,146 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include <string.h>
+#include "hash.h"
+
+
+#define	PRIME64_1 0x9E3779B185EBCA87ULL
+#define	PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define	PRIME64_3 0x165667B19E3779F9ULL
+#define	PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define	PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define	ROTL64(x, r)	((x << r) | (x >> (64 - r)))
+
+/**
+ * Returns: the little-endian 64-bit word at `p', which may be unaligned.
+ */
+static inline uint64_t n2t_hash_read64(uint8_t const *p);
+/**
+ * Returns: the little-endian 32-bit word at `p', which may be unaligned.
+ */
+static inline uint32_t n2t_hash_read32(uint8_t const *p);
+/**
+ * Mixes the 8 bytes `input' into the accumulator `acc'.
+ *
+ * Returns: the updated accumulator.
+ */
+static inline uint64_t n2t_hash_round(uint64_t acc, uint64_t input);
+/**
+ * Folds the lane accumulator `lane' into the digest `acc'.
+ *
+ * Returns: the updated digest.
+ */
+static inline uint64_t n2t_hash_merge(uint64_t acc, uint64_t lane);
+
+
+uint64_t n2t_hash64(void const *data, size_t len, uint64_t seed) {
+	uint8_t const *p = data, *const end = p + len;
+	uint64_t v1, v2, v3, v4, h;
+
+	if (len >= 32) {
+		v1 = seed + PRIME64_1 + PRIME64_2;
+		v2 = seed + PRIME64_2;
+		v3 = seed;
+		v4 = seed - PRIME64_1;
+
+		// Four independent lanes, 8 bytes each per round.
+		do {
+			v1 = n2t_hash_round(v1, n2t_hash_read64(p));
+			v2 = n2t_hash_round(v2, n2t_hash_read64(p + 8));
+			v3 = n2t_hash_round(v3, n2t_hash_read64(p + 16));
+			v4 = n2t_hash_round(v4, n2t_hash_read64(p + 24));
+			p += 32;
+		} while (end - p >= 32);
+
+		h = ROTL64(v1, 1) + ROTL64(v2, 7) + ROTL64(v3, 12) + ROTL64(v4, 18);
+		h = n2t_hash_merge(h, v1);
+		h = n2t_hash_merge(h, v2);
+		h = n2t_hash_merge(h, v3);
+		h = n2t_hash_merge(h, v4);
+	} else {
+		h = seed + PRIME64_5;
+	}
+
+	h += len;
+
+	for (; end - p >= 8; p += 8) {
+		h ^= n2t_hash_round(0, n2t_hash_read64(p));
+		h = ROTL64(h, 27) * PRIME64_1 + PRIME64_4;
+	}
+
+	if (end - p >= 4) {
+		h ^= n2t_hash_read32(p) * PRIME64_1;
+		h = ROTL64(h, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+
+	for (; p < end; p++) {
+		h ^= *p * PRIME64_5;
+		h = ROTL64(h, 11) * PRIME64_1;
+	}
+
+	// Final avalanche, for every input bit to affect every output bit.
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+
+static inline uint64_t n2t_hash_read64(uint8_t const *p) {
+	uint64_t word;
+
+	memcpy(&word, p, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap64(word);
+#endif
+
+	return word;
+}
+
+static inline uint32_t n2t_hash_read32(uint8_t const *p) {
+	uint32_t word;
+
+	memcpy(&word, p, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap32(word);
+#endif
+
+	return word;
+}
+
+static inline uint64_t n2t_hash_round(uint64_t acc, uint64_t input) {
+	acc += input * PRIME64_2;
+	acc = ROTL64(acc, 31);
+
+	return acc * PRIME64_1;
+}
+
+static inline uint64_t n2t_hash_merge(uint64_t acc, uint64_t lane) {
+	acc ^= n2t_hash_round(0, lane);
+
+	return acc * PRIME64_1 + PRIME64_4;
+}
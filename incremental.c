@@ -0,0 +1,840 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include "utils.h"
+#include "symtable.h"
+#include "linescan.h"
+#include "incremental.h"
+
+
+/**
+ * Header of a saved state, followed by the names of symbols `1' to
+ * `nlabels - 1' (each one null-terminated), then by the
+ * `nlines' records, the `nsymbols' symbols, the `nwords' words and the
+ * `length' bytes of code. Fields are in host byte order, states being
+ * meant to stay alongside their output.
+ */
+typedef struct {
+	char magic[8];
+	uint32_t version, nlabels, nsymbols, nlines, nwords;
+	uint64_t salt, length, output_size;
+	int64_t output_mtime[2];
+} asmstatehdr_t;
+
+// Names no longer in use a state keeps before its labels are compacted.
+#define	ASMSTATE_SLACK 64
+
+/**
+ * Splits the `len' bytes at `src' into lines.
+ *
+ * Returns: the lines, storing their number into `n', or `NULL' if an error
+ * occurs.
+ */
+static linespan_t* n2t_asmstate_split(
+	char const *src, size_t len, uint32_t *n
+);
+/**
+ * Returns: `1' if line `i' of `s', whose code lies at `offset', holds the same
+ * code as the line of `src' spanning `span', `0' otherwise.
+ */
+static int n2t_asmstate_same(
+	asmstate_t const *s, uint32_t i, uint64_t offset, char const *src,
+	linespan_t span
+);
+/**
+ * Scans line `lineno' of `src', spanning `span', into `dest', interning its
+ * symbols into `labels'.
+ *
+ * Returns: `1' if the line is not valid, describing why in `errmsg' if not
+ * `NULL', `0' otherwise.
+ */
+static int n2t_asmstate_scan(
+	char const *src, linespan_t span, size_t lineno, strtable_t *labels,
+	linerecord_t *dest, char errmsg[], size_t maxwrite
+);
+/**
+ * Encodes the `nlines' records at `lines' from the words of `s', whose lines
+ * they share but for those from `prefix' to `nlines - suffix'. The words of
+ * these lines are spliced in, and only the A-instructions referring to labels
+ * that moved are resolved again. `symbols' holds a copy of the `nsymbols'
+ * symbols of `s', brought up to date along.
+ *
+ * Returns: `-1' if the symbols must be resolved over all the records, `1' if
+ * an error occurs, described in `errmsg' if not `NULL', `0' otherwise, the
+ * program being encoded into `*words', allocated, and its length into
+ * `*nwords'.
+ */
+static int n2t_asmstate_splice(
+	asmstate_t const *s, linerecord_t const *lines, uint32_t nlines,
+	uint32_t prefix, uint32_t suffix, symrecord_t *symbols, uint32_t nsymbols,
+	word_t **words, uint32_t *nwords, char errmsg[], size_t maxwrite
+);
+/**
+ * Resolves the symbols of the `nlines' records at `lines' as `n2t_parse()'
+ * would, encoding the program into `*words', allocated, and its length into
+ * `*nwords'. `*symbols', allocated, receives how each one of the labels was
+ * resolved.
+ *
+ * Returns: `1' if an error occurs, described in `errmsg' if not `NULL', `0'
+ * otherwise.
+ */
+static int n2t_asmstate_encode(
+	strtable_t *labels, linerecord_t const *lines, uint32_t nlines,
+	parseopts_t const *opts, symrecord_t **symbols, word_t **words,
+	uint32_t *nwords, char errmsg[], size_t maxwrite
+);
+/**
+ * Interns anew the names of the symbols `s' still uses, renumbering them
+ * within its records, once the names the program dropped outnumber them.
+ * `s' is left as it was if an error occurs.
+ */
+static void n2t_asmstate_compact(asmstate_t *s);
+/**
+ * Returns: the encoding of the A-instruction referring to `address'.
+ */
+static word_t n2t_asmstate_Ainstr(uint16_t address);
+
+
+asmstate_t* n2t_asmstate_alloc(uint64_t salt) {
+	asmstate_t *s;
+
+	if ((s = calloc(1, sizeof(asmstate_t))) == NULL)
+		return NULL;
+
+	if ((s->labels = n2t_strtable_alloc(BUFFSIZE_LARGE)) == NULL) {
+		free(s);
+		return NULL;
+	}
+
+	s->salt = salt;
+
+	return s;
+}
+
+asmstate_t* n2t_asmstate_load(char const *path, uint64_t salt) {
+	asmstatehdr_t header;
+	filemap_t input;
+	asmstate_t *s = NULL;
+	char const *p, *end, *name;
+	uint64_t length = 0;
+	uint32_t i;
+	int error = 1;
+
+	if (n2t_filemap_open(path, &input))
+		return NULL;
+
+	p = input.data;
+	end = p + input.length;
+
+	if (input.length >= sizeof(header))
+		memcpy(&header, p, sizeof(header));
+
+	if (
+		input.length < sizeof(header) ||
+		memcmp(header.magic, ASMSTATE_MAGIC, sizeof(header.magic)) ||
+		header.version != ASMSTATE_VERSION || header.salt != salt ||
+		header.nlabels == 0 || header.nsymbols > header.nlabels ||
+		(s = n2t_asmstate_alloc(salt)) == NULL
+	) {
+		n2t_filemap_close(&input);
+		return NULL;
+	}
+
+	p += sizeof(header);
+
+	// Names are interned in order, so that they get back their identifiers.
+	for (i = 1; i < header.nlabels; i++) {
+		if (
+			(name = memchr(p, '\0', end - p)) == NULL ||
+			n2t_strtable_intern(s->labels, p, name - p) != i
+		) {
+			break;
+		}
+
+		p = name + 1;
+	}
+
+	if (
+		i == header.nlabels &&
+		end - p == (size_t) header.nlines * sizeof(linerecord_t) +
+			(size_t) header.nsymbols * sizeof(symrecord_t) +
+			(size_t) header.nwords * sizeof(word_t) + header.length &&
+		(s->lines = malloc(MAX(header.nlines, 1) * sizeof(linerecord_t))) &&
+		(s->symbols = malloc(MAX(header.nsymbols, 1) * sizeof(symrecord_t))) &&
+		(s->words = malloc(MAX(header.nwords, 1) * sizeof(word_t))) &&
+		(s->code = malloc(MAX(header.length, 1)))
+	) {
+		memcpy(s->lines, p, header.nlines * sizeof(linerecord_t));
+		p += header.nlines * sizeof(linerecord_t);
+		memcpy(s->symbols, p, header.nsymbols * sizeof(symrecord_t));
+		p += header.nsymbols * sizeof(symrecord_t);
+		memcpy(s->words, p, header.nwords * sizeof(word_t));
+		p += header.nwords * sizeof(word_t);
+		memcpy(s->code, p, header.length);
+
+		s->nlines = header.nlines;
+		s->nsymbols = header.nsymbols;
+		s->nwords = header.nwords;
+		s->length = header.length;
+		s->output_size = header.output_size;
+		s->output_mtime[0] = header.output_mtime[0];
+		s->output_mtime[1] = header.output_mtime[1];
+		error = 0;
+
+		for (i = 0; i < s->nlines && !error; i++) {
+			error = s->lines[i].label >= s->nsymbols;
+			length += s->lines[i].length;
+		}
+
+		error = error || length != s->length;
+	}
+
+	n2t_filemap_close(&input);
+
+	if (error) {
+		n2t_asmstate_free(s);
+		return NULL;
+	}
+
+	return s;
+}
+
+int n2t_asmstate_save(asmstate_t const *s, char const *path) {
+	uint32_t const nlabels = n2t_strtable_length(s->labels);
+	asmstatehdr_t header = {
+		ASMSTATE_MAGIC, ASMSTATE_VERSION, nlabels, s->nsymbols, s->nlines,
+		s->nwords, s->salt, s->length, s->output_size,
+		{s->output_mtime[0], s->output_mtime[1]}
+	};
+	char tmp_path[PATH_MAX];
+	size_t length = sizeof(header), len;
+	char const *name;
+	char *data, *p;
+	uint32_t i;
+	int fd, error;
+
+	for (i = 1; i < nlabels; i++)
+		length += strlen(n2t_strtable_get(s->labels, i)) + 1;
+
+	length += s->nlines * sizeof(linerecord_t) +
+		s->nsymbols * sizeof(symrecord_t) + s->nwords * sizeof(word_t) +
+		s->length;
+
+	if (
+		snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >=
+			sizeof(tmp_path) ||
+		(data = malloc(length)) == NULL
+	) {
+		return 1;
+	}
+
+	memcpy(data, &header, sizeof(header));
+	p = data + sizeof(header);
+
+	for (i = 1; i < nlabels; i++) {
+		name = n2t_strtable_get(s->labels, i);
+		len = strlen(name) + 1;
+		memcpy(p, name, len);
+		p += len;
+	}
+
+	memcpy(p, s->lines, s->nlines * sizeof(linerecord_t));
+	p += s->nlines * sizeof(linerecord_t);
+	memcpy(p, s->symbols, s->nsymbols * sizeof(symrecord_t));
+	p += s->nsymbols * sizeof(symrecord_t);
+	memcpy(p, s->words, s->nwords * sizeof(word_t));
+	p += s->nwords * sizeof(word_t);
+	memcpy(p, s->code, s->length);
+
+	// Writing aside and renaming never leaves a partial state behind.
+	if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		free(data);
+		return 1;
+	}
+
+	error = n2t_write_all(fd, data, length);
+	error = close(fd) || error || rename(tmp_path, path);
+	free(data);
+
+	if (error)
+		unlink(tmp_path);
+
+	return error;
+}
+
+int n2t_asmstate_update(
+	asmstate_t *s, char const *src, size_t len, parseopts_t const *opts,
+	size_t *nscanned, char errmsg[], size_t maxwrite
+) {
+	linespan_t *spans;
+	linerecord_t *lines;
+	symrecord_t *symbols;
+	word_t *words;
+	char *code;
+	uint32_t nspans, nwords, nsymbols, prefix = 0, suffix = 0, scanned = 0, i;
+	uint64_t from = 0, to = s->length, length = 0;
+	int aligned, same, status;
+
+	if ((spans = n2t_asmstate_split(src, len, &nspans)) == NULL) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not split the source in lines");
+
+		return 1;
+	}
+
+	lines = malloc(MAX(nspans, 1) * sizeof(linerecord_t));
+	code = malloc(MAX(len, 1));
+
+	if (lines == NULL || code == NULL) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not allocate the lines");
+
+		free(spans);
+		free(lines);
+		free(code);
+		return 1;
+	}
+
+	// Edits usually touch a single region of the program: the lines before
+	// and after it are those of the previous version.
+	for (; prefix < nspans && prefix < s->nlines; prefix++) {
+		if (!n2t_asmstate_same(s, prefix, from, src, spans[prefix]))
+			break;
+
+		lines[prefix] = s->lines[prefix];
+		from += s->lines[prefix].length;
+	}
+
+	for (; prefix + suffix < MIN(nspans, s->nlines); suffix++) {
+		i = s->nlines - 1 - suffix;
+
+		if (
+			!n2t_asmstate_same(
+				s, i, to - s->lines[i].length, src, spans[nspans - 1 - suffix]
+			)
+		) {
+			break;
+		}
+
+		lines[nspans - 1 - suffix] = s->lines[i];
+		to -= s->lines[i].length;
+	}
+
+	// When the region keeps its length the edits were made in place, and
+	// its lines still line up with the previous ones.
+	aligned = nspans == s->nlines;
+
+	for (i = prefix; i < nspans - suffix; i++) {
+		same = aligned && n2t_asmstate_same(s, i, from, src, spans[i]);
+		from += aligned ? s->lines[i].length: 0;
+
+		if (same) {
+			lines[i] = s->lines[i];
+			continue;
+		}
+
+		scanned++;
+
+		if (
+			n2t_asmstate_scan(
+				src, spans[i], i + 1, s->labels, lines + i, errmsg, maxwrite
+			)
+		) {
+			free(spans);
+			free(lines);
+			free(code);
+
+			return 1;
+		}
+	}
+
+	// Only the code of the lines is kept, for the next update to compare.
+	for (i = 0; i < nspans; i++) {
+		memcpy(code + length, src + spans[i].start, lines[i].length);
+		length += lines[i].length;
+	}
+
+	free(spans);
+
+	// The symbols first met by the scan are yet to be resolved.
+	nsymbols = n2t_strtable_length(s->labels);
+
+	if ((symbols = calloc(nsymbols, sizeof(symrecord_t))) == NULL) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not allocate symbols");
+
+		free(lines);
+		free(code);
+		return 1;
+	}
+
+	memcpy(symbols, s->symbols, s->nsymbols * sizeof(symrecord_t));
+	status = n2t_asmstate_splice(
+		s, lines, nspans, prefix, suffix, symbols, nsymbols, &words, &nwords,
+		errmsg, maxwrite
+	);
+
+	if (status < 0) {
+		free(symbols);
+		symbols = NULL;
+		status = n2t_asmstate_encode(
+			s->labels, lines, nspans, opts, &symbols, &words, &nwords, errmsg,
+			maxwrite
+		);
+	}
+
+	if (status) {
+		free(lines);
+		free(code);
+		free(symbols);
+		return 1;
+	}
+
+	if (nscanned)
+		*nscanned = scanned;
+
+	free(s->code);
+	free(s->lines);
+	free(s->symbols);
+	free(s->previous);
+	s->code = code;
+	s->length = length;
+	s->lines = lines;
+	s->nlines = nspans;
+	s->symbols = symbols;
+	s->nsymbols = n2t_strtable_length(s->labels);
+	s->previous = s->words;
+	s->nprevious = s->nwords;
+	s->words = words;
+	s->nwords = nwords;
+
+	n2t_asmstate_compact(s);
+
+	return 0;
+}
+
+void n2t_asmstate_free(asmstate_t *s) {
+	n2t_strtable_free(s->labels);
+	free(s->code);
+	free(s->symbols);
+	free(s->lines);
+	free(s->words);
+	free(s->previous);
+	free(s);
+}
+
+
+static linespan_t* n2t_asmstate_split(
+	char const *src, size_t len, uint32_t *n
+) {
+	linespan_t *spans = NULL, *updated_spans;
+	linescan_t scan;
+	size_t nspans = 0, capacity = 0, batch;
+
+	if (n2t_linescan_init(&scan, src, len, LINESCAN_AUTO))
+		return NULL;
+
+	do {
+		if (capacity - nspans < LINESCAN_BATCH) {
+			capacity = capacity * 2 + LINESCAN_BATCH;
+			updated_spans = realloc(spans, capacity * sizeof(linespan_t));
+
+			if (updated_spans == NULL || capacity > UINT32_MAX) {
+				free(updated_spans ? updated_spans: spans);
+				return NULL;
+			}
+
+			spans = updated_spans;
+		}
+
+		batch = n2t_linescan_next(&scan, spans + nspans, capacity - nspans);
+		nspans += batch;
+	} while (batch > 0);
+
+	*n = nspans;
+
+	return spans;
+}
+
+static int n2t_asmstate_same(
+	asmstate_t const *s, uint32_t i, uint64_t offset, char const *src,
+	linespan_t span
+) {
+	return span.cut - span.start == s->lines[i].length &&
+		!memcmp(src + span.start, s->code + offset, s->lines[i].length);
+}
+
+static int n2t_asmstate_scan(
+	char const *src, linespan_t span, size_t lineno, strtable_t *labels,
+	linerecord_t *dest, char errmsg[], size_t maxwrite
+) {
+	token_t t;
+
+	memset(dest, 0, sizeof(linerecord_t));
+	dest->length = span.cut - span.start;
+
+	// Lengths are recorded in 32 bits, far more than any valid line takes.
+	if (span.cut - span.start > UINT32_MAX) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "line %lu is too long", lineno);
+
+		return 1;
+	}
+
+	switch (n2t_scan_line(src + span.start, span.cut - span.start, labels, &t)) {
+		case SCAN_BLANK:
+			dest->kind = LINE_BLANK;
+			break;
+		case 0:
+			if (t.type == LABEL) {
+				dest->kind = LINE_LABEL;
+				dest->label = t.data.label.label;
+			} else if (
+				t.data.instr.type == A && !t.data.instr.instr.a.memptr.loaded
+			) {
+				dest->kind = LINE_SYMBOL;
+				dest->label = t.data.instr.instr.a.memptr.label;
+			} else {
+				dest->kind = LINE_WORD;
+				dest->word = n2t_instr_bits(t.data.instr);
+			}
+
+			break;
+		default:
+			if (errmsg) {
+				snprintf(
+					errmsg, maxwrite, "line %lu is not valid: `%.*s'", lineno,
+					(int) MIN(span.cut - span.start, BUFFSIZE_MED),
+					src + span.start
+				);
+			}
+
+			return 1;
+	}
+
+	return 0;
+}
+
+static int n2t_asmstate_splice(
+	asmstate_t const *s, linerecord_t const *lines, uint32_t nlines,
+	uint32_t prefix, uint32_t suffix, symrecord_t *symbols, uint32_t nsymbols,
+	word_t **words, uint32_t *nwords, char errmsg[], size_t maxwrite
+) {
+	uint32_t const old_end = s->nlines - suffix, end = nlines - suffix;
+	uint32_t start = 0, nremoved = 0, n, i;
+	symrecord_t *sym;
+	uint8_t *moved;
+	int status = 0, nmoved = 0;
+
+	if ((moved = calloc(nsymbols, sizeof(uint8_t))) == NULL) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not allocate symbols");
+
+		return 1;
+	}
+
+	// The words of the lines before the edit keep their addresses.
+	for (i = 0; i < prefix; i++)
+		start += lines[i].kind == LINE_WORD || lines[i].kind == LINE_SYMBOL;
+
+	for (i = prefix; i < old_end && !status; i++) {
+		sym = symbols + s->lines[i].label;
+
+		if (s->lines[i].kind == LINE_LABEL) {
+			sym->kind = SYMBOL_NONE;
+			moved[s->lines[i].label] = 1;
+			nmoved++;
+		} else if (s->lines[i].kind != LINE_BLANK) {
+			nremoved++;
+		}
+
+		// Variables are allocated in order of first appearance, which the
+		// edit may change.
+		if (s->lines[i].kind == LINE_SYMBOL) {
+			sym->nrefs--;
+			status = sym->kind == SYMBOL_VARIABLE ? -1: 0;
+		}
+	}
+
+	for (n = start, i = prefix; i < end && !status; i++) {
+		sym = symbols + lines[i].label;
+
+		if (lines[i].kind == LINE_LABEL) {
+			if (sym->kind == SYMBOL_ROM) {
+				if (errmsg) {
+					snprintf(
+						errmsg, maxwrite, "label `%s' is defined more than"
+						" once", n2t_strtable_get(s->labels, lines[i].label)
+					);
+				}
+
+				status = 1;
+			} else if (sym->kind == SYMBOL_VARIABLE) {
+				status = -1;
+			} else {
+				sym->kind = SYMBOL_ROM;
+				sym->address = n;
+				moved[lines[i].label] = 1;
+				nmoved++;
+			}
+		} else if (lines[i].kind != LINE_BLANK) {
+			n++;
+		}
+
+		if (lines[i].kind == LINE_SYMBOL)
+			sym->nrefs++;
+	}
+
+	// Any other symbol the edit refers to would be a variable, as would a
+	// label it drops while still referred to.
+	for (i = prefix; i < end && !status; i++) {
+		sym = symbols + lines[i].label;
+
+		if (
+			lines[i].kind == LINE_SYMBOL &&
+			sym->kind != SYMBOL_ROM && sym->kind != SYMBOL_PREDEF
+		) {
+			status = -1;
+		}
+	}
+
+	for (i = prefix; i < old_end && !status; i++) {
+		sym = symbols + s->lines[i].label;
+
+		if (
+			s->lines[i].kind == LINE_LABEL &&
+			sym->kind == SYMBOL_NONE && sym->nrefs > 0
+		) {
+			status = -1;
+		}
+	}
+
+	// The labels after the edit move along with their instructions.
+	for (i = end; i < nlines && !status && n != start + nremoved; i++) {
+		if (lines[i].kind == LINE_LABEL) {
+			symbols[lines[i].label].address += n - start - nremoved;
+			moved[lines[i].label] = 1;
+			nmoved++;
+		}
+	}
+
+	*nwords = s->nwords - nremoved + (n - start);
+
+	if (status == 0 && (*words = malloc(MAX(*nwords, 1) * sizeof(word_t)))) {
+		memcpy(*words, s->words, start * sizeof(word_t));
+
+		for (n = start, i = prefix; i < end; i++) {
+			if (lines[i].kind == LINE_WORD) {
+				(*words)[n++] = lines[i].word;
+			} else if (lines[i].kind == LINE_SYMBOL) {
+				(*words)[n++] =
+					n2t_asmstate_Ainstr(symbols[lines[i].label].address);
+			}
+		}
+
+		memcpy(
+			*words + n, s->words + start + nremoved,
+			(s->nwords - start - nremoved) * sizeof(word_t)
+		);
+
+		// Only the instructions referring to labels that moved are resolved
+		// again.
+		for (n = 0, i = 0; nmoved && i < nlines; i++) {
+			if (lines[i].kind == LINE_SYMBOL && moved[lines[i].label]) {
+				(*words)[n] =
+					n2t_asmstate_Ainstr(symbols[lines[i].label].address);
+			}
+
+			n += lines[i].kind == LINE_WORD || lines[i].kind == LINE_SYMBOL;
+		}
+	} else if (status == 0) {
+		status = 1;
+	}
+
+	free(moved);
+
+	return status;
+}
+
+static int n2t_asmstate_encode(
+	strtable_t *labels, linerecord_t const *lines, uint32_t nlines,
+	parseopts_t const *opts, symrecord_t **symbols, word_t **words,
+	uint32_t *nwords, char errmsg[], size_t maxwrite
+) {
+	symtable_t *table;
+	memloc_t const *l;
+	size_t labelcounter = 16;
+	uint32_t nsymbols, i, n = 0;
+
+	table = n2t_symtable_alloc_in(
+		n2t_strtable_length(labels), opts ? opts->arena: NULL
+	);
+
+	if (table == NULL) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not allocate symbols");
+
+		return 1;
+	}
+
+	if (n2t_seed_ram_labels(labels, table, opts, errmsg, maxwrite)) {
+		n2t_symtable_free(table);
+		return 1;
+	}
+
+	// ROM labels first, since they may be referred to before being defined.
+	for (i = 0; i < nlines; i++) {
+		if (lines[i].kind == LINE_LABEL) {
+			l = n2t_symtable_lookup(table, lines[i].label);
+
+			if (l && l->type == ROM) {
+				if (errmsg) {
+					snprintf(
+						errmsg, maxwrite, "label `%s' is defined more than"
+						" once", n2t_strtable_get(labels, lines[i].label)
+					);
+				}
+
+				n2t_symtable_free(table);
+				return 1;
+			}
+
+			if (n2t_symtable_set(table, lines[i].label, n, ROM)) {
+				n2t_symtable_free(table);
+				return 1;
+			}
+		} else if (lines[i].kind != LINE_BLANK) {
+			n++;
+		}
+	}
+
+	// The resolution of each symbol is recorded for the next updates, the
+	// predefined names being interned by now.
+	nsymbols = n2t_strtable_length(labels);
+	*symbols = calloc(nsymbols, sizeof(symrecord_t));
+
+	if (
+		*symbols == NULL ||
+		(*words = malloc(MAX(n, 1) * sizeof(word_t))) == NULL
+	) {
+		free(*symbols);
+		n2t_symtable_free(table);
+		return 1;
+	}
+
+	for (i = 0; i < nsymbols; i++) {
+		if ((l = n2t_symtable_lookup(table, i))) {
+			(*symbols)[i].kind = l->type == ROM ? SYMBOL_ROM: SYMBOL_PREDEF;
+			(*symbols)[i].address = l->location;
+		}
+	}
+
+	*nwords = n;
+	n = 0;
+
+	// Variables are then allocated in order of first appearance.
+	for (i = 0; i < nlines; i++) {
+		if (lines[i].kind == LINE_WORD) {
+			(*words)[n++] = lines[i].word;
+		} else if (lines[i].kind == LINE_SYMBOL) {
+			if ((*symbols)[lines[i].label].kind == SYMBOL_NONE) {
+				(*symbols)[lines[i].label].kind = SYMBOL_VARIABLE;
+				(*symbols)[lines[i].label].address = labelcounter++;
+			}
+
+			(*symbols)[lines[i].label].nrefs++;
+			(*words)[n++] =
+				n2t_asmstate_Ainstr((*symbols)[lines[i].label].address);
+		}
+	}
+
+	n2t_symtable_free(table);
+
+	return 0;
+}
+
+static void n2t_asmstate_compact(asmstate_t *s) {
+	strtable_t *labels;
+	uint32_t *ids;
+	uint32_t nlive = 1, i;
+	char const *name;
+	int error = 0;
+
+	for (i = 1; i < s->nsymbols; i++)
+		nlive += s->symbols[i].kind != SYMBOL_NONE;
+
+	// Compacting in bulk keeps its cost proportional to the names dropped.
+	if (s->nsymbols <= 2 * nlive + ASMSTATE_SLACK)
+		return;
+
+	ids = malloc(s->nsymbols * sizeof(uint32_t));
+	labels = n2t_strtable_alloc(nlive);
+
+	if (ids == NULL || labels == NULL) {
+		free(ids);
+
+		if (labels)
+			n2t_strtable_free(labels);
+
+		return;
+	}
+
+	// Names keep their order, so that no symbol moves up.
+	for (ids[0] = STRTABLE_EMPTY, i = 1; i < s->nsymbols && !error; i++) {
+		if (s->symbols[i].kind != SYMBOL_NONE) {
+			name = n2t_strtable_get(s->labels, i);
+			ids[i] = n2t_strtable_intern(labels, name, strlen(name));
+			error = ids[i] != n2t_strtable_length(labels) - 1;
+		}
+	}
+
+	if (error) {
+		free(ids);
+		n2t_strtable_free(labels);
+		return;
+	}
+
+	for (i = 1; i < s->nsymbols; i++) {
+		if (s->symbols[i].kind != SYMBOL_NONE)
+			s->symbols[ids[i]] = s->symbols[i];
+	}
+
+	for (i = 0; i < s->nlines; i++) {
+		if (s->lines[i].kind == LINE_LABEL || s->lines[i].kind == LINE_SYMBOL)
+			s->lines[i].label = ids[s->lines[i].label];
+	}
+
+	n2t_strtable_free(s->labels);
+	free(ids);
+	s->labels = labels;
+	s->nsymbols = nlive;
+}
+
+static word_t n2t_asmstate_Ainstr(uint16_t address) {
+	Ainstr_t const a = {{STRTABLE_EMPTY, address, 1, RAM}};
+
+	return n2t_Ainstr_bits(a);
+}
@@ -0,0 +1,148 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "lexer.h"
+#include "parser.h"
+#include "strtable.h"
+
+
+#define	ASMSTATE_MAGIC "N2TSTATE"
+#define	ASMSTATE_VERSION 3
+
+// Kinds of `linerecord_t'.
+#define	LINE_BLANK 0
+#define	LINE_LABEL 1
+// An instruction encoded from its line alone.
+#define	LINE_WORD 2
+// An A-instruction whose address is that of a symbol.
+#define	LINE_SYMBOL 3
+
+// Kinds of `symrecord_t'.
+#define	SYMBOL_NONE 0
+#define	SYMBOL_ROM 1
+#define	SYMBOL_PREDEF 2
+// A RAM variable, allocated in order of first appearance.
+#define	SYMBOL_VARIABLE 3
+
+/**
+ * What a line of a program amounts to, once scanned: `length' is that of its
+ * code, comments excluded, and `kind' one of the `LINE_*' values. `label' is
+ * the symbol defined by a `LINE_LABEL' or referred to by a `LINE_SYMBOL',
+ * while `word' is the encoding of a `LINE_WORD'.
+ */
+typedef struct {
+	uint32_t length, label;
+	word_t word;
+	uint8_t kind;
+} linerecord_t;
+
+/**
+ * How a symbol of a program was resolved: `kind' is one of the `SYMBOL_*'
+ * values, `address' the location it stands for and `nrefs' the number of
+ * `LINE_SYMBOL' records referring to it.
+ */
+typedef struct {
+	uint32_t nrefs;
+	uint16_t address;
+	uint8_t kind;
+} symrecord_t;
+
+/**
+ * The state kept between incremental assemblies of a program: the `length'
+ * bytes of `code' of its lines, end to end, a record of each of its `nlines'
+ * lines, whose symbols are interned into `labels' and resolved at `symbols'
+ * (the first `nsymbols' labels, those in use by the last update), and the
+ * `nwords' words it assembles to. `previous' holds the `nprevious' words of
+ * the assembly before the last update.
+ *
+ * `salt' sums up the settings of the assembly, while `output_size' and
+ * `output_mtime' identify the output file matching `words', as given by the
+ * caller.
+ */
+typedef struct {
+	uint64_t salt;
+	char *code;
+	uint64_t length;
+	strtable_t *labels;
+	symrecord_t *symbols;
+	linerecord_t *lines;
+	uint32_t nsymbols, nlines;
+	word_t *words, *previous;
+	uint32_t nwords, nprevious;
+
+	uint64_t output_size;
+	int64_t output_mtime[2];
+} asmstate_t;
+
+
+/**
+ * Allocates the empty state of a program never assembled, with settings
+ * summed up by `salt'.
+ *
+ * Returns: the state, or `NULL' if an error occurs.
+ */
+asmstate_t* n2t_asmstate_alloc(uint64_t salt);
+/**
+ * Loads the state saved at `path' by `n2t_asmstate_save()'.
+ *
+ * Returns: the state, or `NULL' if it can not be read, is malformed or was
+ * saved with settings other than those summed up by `salt'.
+ */
+asmstate_t* n2t_asmstate_load(char const *path, uint64_t salt);
+/**
+ * Saves `s' to `path', replacing the former contents at once.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+int n2t_asmstate_save(asmstate_t const *s, char const *path);
+/**
+ * Brings `s' up to date with the program held by the `len' bytes at `src',
+ * assembled according to `opts'. Lines are compared with the recorded ones,
+ * and only those between the first and the last changed line are scanned,
+ * skipping the unchanged ones when the line count is the same.
+ * The words of the changed lines are then spliced into those of the previous
+ * assembly, and only the A-instructions referring to labels that moved are
+ * resolved again. Symbols are resolved over all the records, as `n2t_parse()'
+ * would, when the edit defines a label some instruction referred to as a
+ * variable, drops one still referred to, or touches a variable, since that
+ * may allocate the variables anew. The former words are moved to
+ * `s->previous'. `nscanned', if not `NULL', receives the number of lines
+ * scanned.
+ *
+ * Returns: `1' if an error occurs, described in `errmsg' if not `NULL',
+ * `0' otherwise. On error, `s' is left as it was.
+ */
+int n2t_asmstate_update(
+	asmstate_t *s, char const *src, size_t len, parseopts_t const *opts,
+	size_t *nscanned, char errmsg[], size_t maxwrite
+);
+/**
+ * Frees up the memory associated with `s'.
+ */
+void n2t_asmstate_free(asmstate_t *s);
+
+
+#endif
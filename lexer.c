@@ -21,6 +21,7 @@
 // SOFTWARE.
 #include "lexer.h"
 #include "utils.h"
+#include "linescan.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -62,12 +63,12 @@ static char const *INDEX_TO_COMP[] = {
 	"", "",
 	"-1",	//58
 	"", "", "", "",
-	"1",	//58
-	"D&M",	//59
+	"1",	//63
+	"D&M",	//64
 	"",
-	"D+M",	//61
+	"D+M",	//66
 	"", "", "", "",
-	"M-D",	//66
+	"M-D",	//71
 	"", "", "", "", "", "", "", "", "", "", "",
 	"D-M",	//83
 	"",
@@ -88,52 +89,164 @@ static char const *INDEX_TO_JUMP[] = {
 	"", "JGT", "JEQ", "JGE", "JLT", "JNE", "JLE", "JMP"
 };
 
+// Packs the characters of a mnemonic, three at most, into an integer, the last
+// one in the least significant byte. Mnemonics are thus decoded by a `switch'
+// on their key, which the compiler turns into a handful of comparisons.
+#define	MNEMONIC_KEY3(a, b, c) \
+	(((uint32_t) (a) << 16) | ((uint32_t) (b) << 8) | (uint32_t) (c))
+#define	MNEMONIC_KEY2(a, b)	MNEMONIC_KEY3(0, a, b)
+#define	MNEMONIC_KEY1(a)	MNEMONIC_KEY3(0, 0, a)
+// Key of no valid mnemonic.
+#define	MNEMONIC_INVALID UINT32_MAX
+
+#define	IS_DIGIT(c)	('0' <= (c) && (c) <= '9')
+// Whether `c' belongs to `LABEL_CHARSET'.
+#define	IS_LABEL_CHAR(c) ( \
+	('a' <= (c) && (c) <= 'z') || ('A' <= (c) && (c) <= 'Z') || IS_DIGIT(c) || \
+	(c) == '.' || (c) == '$' || (c) == '_' \
+)
+// Whether a comment begins at `p', given that the line ends at `end'.
+#define	IS_COMMENT(p, end)	((p) + 1 < (end) && (p)[0] == '/' && (p)[1] == '/')
+
+/**
+ * Returns: the integer value associated to the ALU instruction of key `key',
+ * or `COMP_ERROR' if no such instruction exists.
+ */
+static word_t n2t_parse_Cinstr_comp(uint32_t key);
 /**
- * Parses the computation portion of a C-instruction.
+ * Returns: the integer value associated to the jump condition of key `key',
+ * or `JUMP_ERROR' if no such condition exists.
+ */
+static word_t n2t_parse_Cinstr_jump(uint32_t key);
+/**
+ * Sets the destination registers of `dest' from the `chars' characters packed
+ * into `key'. Registers can be listed in any order, but only once.
  *
- * Param `norm_repr': a normalized representation for this ALU instruction.
- * Returns: the integer value associated to the ALU instruction or `COMP_ERROR'
- * if no correct parsing could be performed.
+ * Returns: `1' if `key' lists invalid or repeated registers, `0' otherwise.
  */
-static word_t n2t_parse_Cinstr_comp(char const *norm_repr);
+static int n2t_parse_Cinstr_dest(uint32_t key, size_t chars, Cinstr_t *dest);
 
+/**
+ * The `n2t_scan_*()' functions below decode the characters in `[p, end)' in a
+ * single left-to-right pass, without copying them. Whitespaces and a trailing
+ * comment are allowed after the decoded element, but nothing else.
+ */
+/**
+ * Param `p': the first character following the `@' sign.
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_scan_Ainstr(
+	char const *p, char const *const end, strtable_t *labels, Ainstr_t *dest
+);
+/**
+ * Scans a C-instruction, whose fields may contain whitespaces.
+ *
+ * Returns: `1' if an error occurs parsing the `dest' portion, `2' parsing the
+ * `comp' portion and `3' if parsing the `jump' portion, `0' otherwise.
+ */
+static int n2t_scan_Cinstr(char const *p, char const *const end, Cinstr_t *dest);
+/**
+ * Param `p': the first character following the opening parenthesis.
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_scan_label(
+	char const *p, char const *const end, strtable_t *labels, memloc_t *dest
+);
+/**
+ * Returns: `1' if `[p, end)' contains whitespaces only, possibly followed by
+ * a comment, `0' otherwise.
+ */
+static int n2t_scan_blank(char const *p, char const *const end);
 
-int n2t_str_to_instr(char const *str_repr, instr_t *dest) {
-	char normalized[strlen(str_repr) + 1];
 
-	if (n2t_strip(str_repr, normalized))
-		return 1;
+int n2t_str_to_instr(char const *str_repr, strtable_t *labels, instr_t *dest) {
+	char const *const end = str_repr + strlen(str_repr);
+
+	while (str_repr < end && IS_SPACE(*str_repr))
+		str_repr++;
 
-	if (normalized[0] == '@') {
+	if (str_repr[0] == '@') {
 		dest->type = A;
-		return n2t_str_to_Ainstr(normalized, &dest->instr.a);
+		return n2t_scan_Ainstr(str_repr + 1, end, labels, &dest->instr.a);
 	} else {
 		dest->type = C;
-		return n2t_str_to_Cinstr(normalized, &dest->instr.c);
+		return n2t_scan_Cinstr(str_repr, end, &dest->instr.c) ? 1: 0;
 	}
 }
 
-int n2t_instr_to_bitstr(instr_t in, char *const dest) {
-	word_t bitmask = 1 << 15,
-		   i = 0;
-	word_t const bits =
-		(in.type == A) ? n2t_Ainstr_bits(in.instr.a): in.instr.c;
+int n2t_scan_line(
+	char const *line, size_t len, strtable_t *labels, token_t *dest
+) {
+	char const *const end = line + len;
+
+	// The whole of `dest' is zeroed, padding included, so that equal tokens
+	// compare equal within the multiton.
+	memset(dest, 0, sizeof(token_t));
+
+	while (line < end && IS_SPACE(*line))
+		line++;
 
-	while (bitmask > 0 && i < 16) {
-		dest[i] = bits & bitmask ? '1': '0';
+	if (line == end || IS_COMMENT(line, end))
+		return SCAN_BLANK;
 
-		bitmask >>= 1;
-		i++;
+	switch (*line) {
+		case '@':
+			dest->type = INSTR;
+			dest->data.instr.type = A;
+
+			return n2t_scan_Ainstr(
+				line + 1, end, labels, &dest->data.instr.instr.a
+			);
+		case '(':
+			dest->type = LABEL;
+
+			return n2t_scan_label(line + 1, end, labels, &dest->data.label);
+		default:
+			dest->type = INSTR;
+			dest->data.instr.type = C;
+
+			return n2t_scan_Cinstr(line, end, &dest->data.instr.instr.c) ? 1: 0;
 	}
+}
 
-	dest[i] = '\0';
+int n2t_instr_to_bitstr(instr_t in, char *const dest) {
+	word_t const bits = n2t_instr_bits(in);
 
-	return i + 1;
+	n2t_words_to_bitlines(&bits, 1, dest);
+	dest[BITLINE_LENGTH - 1] = '\0';
+
+	return BITLINE_LENGTH;
+}
+
+word_t n2t_instr_bits(instr_t in) {
+	return (in.type == A) ? n2t_Ainstr_bits(in.instr.a): in.instr.c;
 }
 
-int n2t_instr_to_str(instr_t const in, char *const dest, size_t maxwrite) {
+size_t n2t_words_to_bitlines(word_t const *words, size_t n, char *dest) {
+	// The binary digits of every nibble, most significant first.
+	static char const nibbles[16][4] = {
+		"0000", "0001", "0010", "0011", "0100", "0101", "0110", "0111",
+		"1000", "1001", "1010", "1011", "1100", "1101", "1110", "1111"
+	};
+	size_t i;
+
+	for (i = 0; i < n; i++, dest += BITLINE_LENGTH) {
+		memcpy(dest, nibbles[words[i] >> 12], 4);
+		memcpy(dest + 4, nibbles[(words[i] >> 8) & 0xF], 4);
+		memcpy(dest + 8, nibbles[(words[i] >> 4) & 0xF], 4);
+		memcpy(dest + 12, nibbles[words[i] & 0xF], 4);
+		dest[16] = '\n';
+	}
+
+	return n * BITLINE_LENGTH;
+}
+
+int n2t_instr_to_str(
+	instr_t const in, strtable_t const *labels, char *const dest,
+	size_t maxwrite
+) {
 	if (in.type == A) {
-		return n2t_Ainstr_to_str(in.instr.a, dest, maxwrite);
+		return n2t_Ainstr_to_str(in.instr.a, labels, dest, maxwrite);
 	} else if (in.type == C) {
 		return n2t_Cinstr_to_str(in.instr.c, dest, maxwrite);
 	} else {
@@ -142,38 +255,29 @@ int n2t_instr_to_str(instr_t const in, char *const dest, size_t maxwrite) {
 }
 
 
-int n2t_str_to_Ainstr(char const *norm_repr, Ainstr_t *dest) {
+int n2t_str_to_Ainstr(
+	char const *norm_repr, strtable_t *labels, Ainstr_t *dest
+) {
 	if (norm_repr[0] != '@') {
 		return 1;	// Not an A-instruction.
 	}
 
-	if (n2t_is_numeric(norm_repr + 1)) {
-		// `[1-9]\d*' digits.
-		// TO-DO: even multi-digit figures beginning with `0' are allowed!
-		dest->memptr.location = atoi(norm_repr + 1);
-		dest->memptr.loaded = 1;
-		snprintf(
-			dest->memptr.label, BUFFSIZE_MED, "%u", dest->memptr.location
-		);
-		dest->memptr.type = RAM;
-	} else if (
-			!IS_IN(norm_repr[1], "0123456789") &&
-			n2t_composed_of(norm_repr + 1, LABEL_CHARSET)
-	) {
-		// @R0, @R1, ..., @SP, @THIS, ..., @LABEL, @label, @...
-		dest->memptr.loaded = 0;
-		strncpy(dest->memptr.label, norm_repr + 1, BUFFSIZE_MED);
-		dest->memptr.type = UNKNOWN;
-	} else {
-		return 1;
-	}
-
-	return 0;
+	return n2t_scan_Ainstr(
+		norm_repr + 1, norm_repr + strlen(norm_repr), labels, dest
+	);
 }
 
-int n2t_Ainstr_to_str(Ainstr_t const in, char *const dest, size_t maxwrite) {
-	if (in.memptr.label[0] != '\0') {
-		snprintf(dest, maxwrite, "@%s", in.memptr.label);
+int n2t_Ainstr_to_str(
+	Ainstr_t const in, strtable_t const *labels, char *const dest,
+	size_t maxwrite
+) {
+	char const *label;
+
+	if (in.memptr.label != STRTABLE_EMPTY) {
+		if ((label = n2t_strtable_get(labels, in.memptr.label)) == NULL)
+			return 1;
+
+		snprintf(dest, maxwrite, "@%s", label);
 	} else {
 		snprintf(dest, maxwrite, "@%d", in.memptr.location);
 	}
@@ -195,92 +299,7 @@ word_t n2t_Ainstr_bits(Ainstr_t const in) {
 
 
 int n2t_str_to_Cinstr(char const *const norm_repr, Cinstr_t *dest) {
-	char const
-		*const dest_field_tail = index(norm_repr, SYM_EQ),
-		*const jump_field_head = index(norm_repr, SYM_SEMIC);
-	char comp_field[strlen(norm_repr) + 1];
-	word_t comp_encoding;
-	size_t dest_offset = 0;
-
-	char parsed_dest[4] = "   ";
-	size_t parsed_dest_index = 0;
-
-	*dest = 0;
-
-	// Parse the `dest' part.
-	// If '=' = SYM_EQ was not found in `norm_repr', `dest_field_tail' will be
-	// `NULL'.
-	while (norm_repr + dest_offset < dest_field_tail) {
-		if (!IS_SPACE(norm_repr[dest_offset])) {
-			if (index(parsed_dest, norm_repr[dest_offset])) {
-				return 1;	// We already parsed `*norm_repr'!
-			}
-
-			switch (norm_repr[dest_offset]) {
-				case 'M':
-					n2t_set_dest(dest, DEST_M);
-					parsed_dest[parsed_dest_index] = 'M';
-					break;
-				case 'D':
-					n2t_set_dest(dest, DEST_D);
-					parsed_dest[parsed_dest_index] = 'D';
-					break;
-				case 'A':
-					n2t_set_dest(dest, DEST_A);
-					parsed_dest[parsed_dest_index] = 'A';
-					break;
-				default:
-					return 1;
-			}
-
-			parsed_dest_index++;
-		}
-
-		dest_offset++;
-	}
-
-	// Parse the `jump' part.
-	if (jump_field_head) {
-		if (!strcmp(jump_field_head + 1, "JGT")) {
-			n2t_set_jump(dest, JUMP_GT);
-		} else if (!strcmp(jump_field_head + 1, "JEQ")) {
-			n2t_set_jump(dest, JUMP_EQ);
-		} else if (!strcmp(jump_field_head + 1, "JGE")) {
-			n2t_set_jump(dest, JUMP_GE);
-		} else if (!strcmp(jump_field_head + 1, "JLT")) {
-			n2t_set_jump(dest, JUMP_LT);
-		} else if (!strcmp(jump_field_head + 1, "JNE")) {
-			n2t_set_jump(dest, JUMP_NE);
-		} else if (!strcmp(jump_field_head + 1, "JLE")) {
-			n2t_set_jump(dest, JUMP_LE);
-		} else if (!strcmp(jump_field_head + 1, "JMP")) {
-			n2t_set_jump(dest, JUMP_ALWAYS);
-		} else {
-			return 3;
-		}
-	}
-
-	// Parse the `comp' part.
-	if (dest_field_tail)
-		strcpy(comp_field, dest_field_tail + 1);
-	else
-		strcpy(comp_field, norm_repr);
-
-	if (jump_field_head)
-		*index(comp_field, SYM_SEMIC) = '\0';
-
-	n2t_strip(comp_field, comp_field);
-	n2t_collapse_any(comp_field, " \t\n", comp_field);
-
-	if ((comp_encoding = n2t_parse_Cinstr_comp(comp_field)) != COMP_ERROR) {
-		n2t_set_comp(dest, comp_encoding);
-	} else {
-		return 2;
-	}
-
-	*dest |= (0x7 << 13);
-
-	return 0;
+	return n2t_scan_Cinstr(norm_repr, norm_repr + strlen(norm_repr), dest);
 }
 
 int n2t_Cinstr_to_str(Cinstr_t const in, char *const dest, size_t maxwrite) {
@@ -363,55 +382,72 @@ word_t n2t_get_jump(Cinstr_t const in) {
 }
 
 
-int n2t_str_to_label(char const *str_repr, memloc_t *dest) {
-	size_t const len = strlen(str_repr);
-
-	if (str_repr[0] != '(' || str_repr[len - 1] != ')')
+int n2t_str_to_label(char const *str_repr, strtable_t *labels, memloc_t *dest) {
+	if (str_repr[0] != '(')
 		return 1;
-	if (len - 2 >= BUFFSIZE_MED)	// Line too long.
-		return 1;
-
-	strncpy(dest->label, str_repr + 1, len - 2);
-	dest->label[len - 2] = '\0';
 
-	if (n2t_composed_of(dest->label, LABEL_CHARSET)) {
-		dest->type = ROM;
-		dest->loaded = 0;
-
-		return 0;
-	} else {
-		dest->label[0] = '\0';
-
-		return 1;
-	}
+	return n2t_scan_label(
+		str_repr + 1, str_repr + strlen(str_repr), labels, dest
+	);
 }
 
 
 // tokenseq_t
 tokenseq_t* n2t_tokenseq_alloc(size_t n) {
+	return n2t_tokenseq_alloc_in(n, NULL);
+}
+
+tokenseq_t* n2t_tokenseq_alloc_in(size_t n, arena_t *arena) {
+	// Programs repeat the same few instructions: distinct tokens are far
+	// fewer than tokens, and their stores grow as needed anyway.
+	uint32_t const ndistinct = MIN(n, BUFFSIZE_LARGE);
 	tokenseq_t *o;
 
-	if (n <= 0)
+	if (n <= 0 || n > UINT32_MAX)
 		return NULL;
 
-	o = malloc(sizeof(tokenseq_t));
-	if (o == NULL)
-		return NULL;
+	if (arena) {
+		if ((o = n2t_arena_push(arena, sizeof(tokenseq_t))) == NULL)
+			return NULL;
+		if ((o->tokens = n2t_arena_push(arena, n * sizeof(uint32_t))) == NULL)
+			return NULL;
+	} else {
+		o = malloc(sizeof(tokenseq_t));
+		if (o == NULL)
+			return NULL;
 
-	o->tokens = calloc(n, sizeof(uint32_t));
-	if (o->tokens == NULL) {
-		free(o);
-		return NULL;
+		o->tokens = calloc(n, sizeof(uint32_t));
+		if (o->tokens == NULL) {
+			free(o);
+			return NULL;
+		}
 	}
 
 	o->ntokens = n;
 	o->next = 0;
+	o->ninstrs = 0;
+	o->nlines = 0;
+	o->arena = arena;
 
-	o->tokens_multiton = n2t_memcache_alloc(n, sizeof(token_t));
+	o->tokens_multiton = n2t_memcache_alloc_in(
+		ndistinct, sizeof(token_t), arena
+	);
 
 	if (o->tokens_multiton == NULL) {
-		free(o->tokens);
-		free(o);
+		if (arena == NULL) {
+			free(o->tokens);
+			free(o);
+		}
+
+		return NULL;
+	}
+
+	if ((o->labels = n2t_strtable_alloc_in(ndistinct, arena)) == NULL) {
+		if (arena == NULL) {
+			n2t_memcache_free(o->tokens_multiton);
+			free(o->tokens);
+			free(o);
+		}
 
 		return NULL;
 	}
@@ -423,8 +459,10 @@ int n2t_tokenseq_append_token_index(tokenseq_t *s, uint32_t index) {
 	if (s == NULL)
 		return 1;
 
+	// Growing geometrically keeps the cost of appending amortized constant.
 	if (n2t_tokenseq_full(s)) {
-		n2t_tokenseq_extend(s, BUFFSIZE_MED);
+		if (n2t_tokenseq_extend(s, s->ntokens) == NULL)
+			return 1;
 	}
 
 	s->tokens[s->next] = index;
@@ -440,6 +478,13 @@ int n2t_tokenseq_cache_token(tokenseq_t *s, token_t const t) {
 	return n2t_memcache_store(s->tokens_multiton, &t, sizeof(token_t));
 }
 
+int64_t n2t_tokenseq_intern_token(tokenseq_t *s, token_t const t) {
+	if (s == NULL)
+		return -1;
+
+	return n2t_memcache_intern(s->tokens_multiton, &t, sizeof(token_t));
+}
+
 token_t* n2t_tokenseq_index_get(tokenseq_t const *s, uint32_t index) {
 	if (s == NULL)
 		return NULL;
@@ -451,6 +496,22 @@ token_t* n2t_tokenseq_index_get(tokenseq_t const *s, uint32_t index) {
 	);
 }
 
+size_t n2t_tokenseq_encode(
+	tokenseq_t const *s, uint32_t *from, word_t *dest, size_t max
+) {
+	token_t const *t;
+	size_t n = 0;
+
+	for (; *from < s->next && n < max; (*from)++) {
+		t = n2t_memcache_index_fetch(s->tokens_multiton, s->tokens[*from]);
+
+		if (t->type == INSTR)
+			dest[n++] = n2t_instr_bits(t->data.instr);
+	}
+
+	return n;
+}
+
 memloc_t* n2t_tokenseq_find_rom_label(tokenseq_t const *s, memloc_t mould) {
 	token_t *t;
 	size_t i;
@@ -458,10 +519,8 @@ memloc_t* n2t_tokenseq_find_rom_label(tokenseq_t const *s, memloc_t mould) {
 	for (i = 0; i < s->tokens_multiton->next; i++) {
 		t = n2t_memcache_index_fetch(s->tokens_multiton, i);
 
-		if (
-			t->type == LABEL &&
-			!strncmp(mould.label, t->data.label.label, BUFFSIZE_MED)
-		)
+		// Interned labels are equal if and only if their identifiers are.
+		if (t->type == LABEL && t->data.label.label == mould.label)
 			return &t->data.label;
 	}
 
@@ -469,64 +528,78 @@ memloc_t* n2t_tokenseq_find_rom_label(tokenseq_t const *s, memloc_t mould) {
 }
 
 tokenseq_t* n2t_tokenize(const char *filepath) {
-	FILE *fin;
-	char buff[BUFFSIZE_LARGE];
+	filemap_t input;
+	tokenseq_t *seq;
+
+	if (n2t_filemap_open(filepath, &input))
+		return NULL;
+
+	seq = n2t_tokenize_buffer(input.data, input.length);
+	n2t_filemap_close(&input);
+
+	return seq;
+}
+
+tokenseq_t* n2t_tokenize_buffer(char const *src, size_t len) {
+	return n2t_tokenize_buffer_in(src, len, NULL);
+}
+
+tokenseq_t* n2t_tokenize_buffer_in(
+	char const *src, size_t len, arena_t *arena
+) {
+	// Instructions take some 7 bytes per line on average, so that this
+	// rarely needs growing.
+	size_t const ntokens = arena ?
+		MIN(len / 4 + BUFFSIZE_LARGE, UINT32_MAX): BUFFSIZE_LARGE;
+	linespan_t spans[LINESCAN_BATCH];
+	linescan_t scan;
+	size_t nspans, i;
 
 	tokenseq_t *seq;
 	token_t t;
 	int64_t cacheindex;
 
-	memset(&t, 0, sizeof(token_t));
-
-	if ((fin = fopen(filepath, "r")) == NULL) {
+	if (n2t_linescan_init(&scan, src, len, LINESCAN_AUTO))
 		return NULL;
-	}
-
-	if ((seq = n2t_tokenseq_alloc(BUFFSIZE_LARGE)) == NULL) {
-		fclose(fin);
+	if ((seq = n2t_tokenseq_alloc_in(ntokens, arena)) == NULL)
 		return NULL;
-	}
 	
-	while (fgets(buff, BUFFSIZE_LARGE, fin)) {
-		n2t_decomment(buff, buff);
-		n2t_strip(buff, buff);
+	while ((nspans = n2t_linescan_next(&scan, spans, LINESCAN_BATCH)) > 0) {
+		seq->nlines += nspans;
+
+		for (i = 0; i < nspans; i++) {
+			switch (
+				n2t_scan_line(
+					src + spans[i].start, spans[i].cut - spans[i].start,
+					seq->labels, &t
+				)
+			) {
+				case 0:
+					break;
+				case SCAN_BLANK:
+					continue;
+				default:
+					// We couldn't parse in any possible way the line.
+					n2t_tokenseq_free(seq);
 
-		// If `buff' contains nothing after taking away comments and
-		// whitespaces:
-		if (buff[0] == '\0')
-			continue;
+					return NULL;
+			}
 
-		if (n2t_str_to_instr(buff, &t.data.instr) == 0) {
-			t.type = INSTR;
-		} else if (n2t_str_to_label(buff, &t.data.label) == 0) {
-			t.type = LABEL;
-		} else {
-			// We couldn't parse in any possible way `buff'.
-			fclose(fin);
-			n2t_tokenseq_free(seq);
+			// Either the index of an equal token already in the multiton
+			// store, or of `t' itself once inserted.
+			cacheindex = n2t_tokenseq_intern_token(seq, t);
 
-			return NULL;
-		}
+			if (
+				cacheindex < 0 ||
+				n2t_tokenseq_append_token_index(seq, cacheindex)
+			) {
+				n2t_tokenseq_free(seq);
 
-		cacheindex = n2t_memcache_index_of(
-			seq->tokens_multiton, &t, sizeof(token_t)
-		);
-		// If `t' was already present in the multiton store:
-		if (cacheindex >= 0) {
-			n2t_tokenseq_append_token_index(seq, cacheindex);
-		} else {
-			n2t_tokenseq_cache_token(seq, t);
-			n2t_tokenseq_append_token_index(
-				seq,
-				n2t_memcache_index_of(seq->tokens_multiton, &t, sizeof(token_t))
-			);
+				return NULL;
+			}
 		}
-
-		memset(&t, 0, sizeof(token_t));
 	}
 
-	fclose(fin);
-
 	return seq;
 }
 
@@ -538,7 +611,12 @@ tokenseq_t* n2t_tokenseq_extend(tokenseq_t *s, size_t n) {
 	uint32_t *t;
 
 	if (n > 0) {
-		t = realloc(s->tokens, sizeof(uint32_t) * (s->ntokens + n));
+		t = s->arena ?
+			n2t_arena_resize(
+				s->arena, s->tokens, sizeof(uint32_t) * s->ntokens,
+				sizeof(uint32_t) * (s->ntokens + n)
+			):
+			realloc(s->tokens, sizeof(uint32_t) * (s->ntokens + n));
 
 		if (t == NULL) {
 			return NULL;
@@ -552,19 +630,233 @@ tokenseq_t* n2t_tokenseq_extend(tokenseq_t *s, size_t n) {
 }
 
 void n2t_tokenseq_free(tokenseq_t *l) {
+	// Released along with the arena.
+	if (l->arena)
+		return;
+
+	n2t_strtable_free(l->labels);
 	n2t_memcache_free(l->tokens_multiton);
 	free(l->tokens);
 	free(l);
 }
 
 
-static word_t n2t_parse_Cinstr_comp(char const *norm_repr) {
-	size_t i;
+static word_t n2t_parse_Cinstr_comp(uint32_t key) {
+	switch (key) {
+		case MNEMONIC_KEY1('0'):		return COMP_0;
+		case MNEMONIC_KEY1('1'):		return COMP_1;
+		case MNEMONIC_KEY2('-', '1'):		return COMP_MINUS1;
+		case MNEMONIC_KEY1('D'):		return COMP_D;
+		case MNEMONIC_KEY1('A'):		return COMP_A;
+		case MNEMONIC_KEY2('!', 'D'):		return COMP_NOTD;
+		case MNEMONIC_KEY2('!', 'A'):		return COMP_NOTA;
+		case MNEMONIC_KEY2('-', 'D'):		return COMP_MINUSD;
+		case MNEMONIC_KEY2('-', 'A'):		return COMP_MINUSA;
+		case MNEMONIC_KEY3('D', '+', '1'):	return COMP_DPLUS1;
+		case MNEMONIC_KEY3('A', '+', '1'):	return COMP_APLUS1;
+		case MNEMONIC_KEY3('D', '-', '1'):	return COMP_DMINUS1;
+		case MNEMONIC_KEY3('A', '-', '1'):	return COMP_AMINUS1;
+		case MNEMONIC_KEY3('D', '+', 'A'):	return COMP_DPLUSA;
+		case MNEMONIC_KEY3('D', '-', 'A'):	return COMP_DMINUSA;
+		case MNEMONIC_KEY3('A', '-', 'D'):	return COMP_AMINUSD;
+		case MNEMONIC_KEY3('D', '&', 'A'):	return COMP_DANDA;
+		case MNEMONIC_KEY3('D', '|', 'A'):	return COMP_DORA;
+		case MNEMONIC_KEY1('M'):		return COMP_M;
+		case MNEMONIC_KEY2('!', 'M'):		return COMP_NOTM;
+		case MNEMONIC_KEY2('-', 'M'):		return COMP_MINUSM;
+		case MNEMONIC_KEY3('M', '+', '1'):	return COMP_MPLUS1;
+		case MNEMONIC_KEY3('M', '-', '1'):	return COMP_MMINUS1;
+		case MNEMONIC_KEY3('D', '+', 'M'):	return COMP_DPLUSM;
+		case MNEMONIC_KEY3('D', '-', 'M'):	return COMP_DMINUSM;
+		case MNEMONIC_KEY3('M', '-', 'D'):	return COMP_MMINUSD;
+		case MNEMONIC_KEY3('D', '&', 'M'):	return COMP_DANDM;
+		case MNEMONIC_KEY3('D', '|', 'M'):	return COMP_DORM;
+		default:				return COMP_ERROR;
+	}
+}
+
+static word_t n2t_parse_Cinstr_jump(uint32_t key) {
+	switch (key) {
+		case MNEMONIC_KEY3('J', 'G', 'T'):	return JUMP_GT;
+		case MNEMONIC_KEY3('J', 'E', 'Q'):	return JUMP_EQ;
+		case MNEMONIC_KEY3('J', 'G', 'E'):	return JUMP_GE;
+		case MNEMONIC_KEY3('J', 'L', 'T'):	return JUMP_LT;
+		case MNEMONIC_KEY3('J', 'N', 'E'):	return JUMP_NE;
+		case MNEMONIC_KEY3('J', 'L', 'E'):	return JUMP_LE;
+		case MNEMONIC_KEY3('J', 'M', 'P'):	return JUMP_ALWAYS;
+		default:				return JUMP_ERROR;
+	}
+}
+
+static int n2t_parse_Cinstr_dest(uint32_t key, size_t chars, Cinstr_t *dest) {
+	word_t reg, regs = DEST_NONE;
+
+	if (key == MNEMONIC_INVALID)
+		return 1;
+
+	for (; chars > 0; chars--, key >>= 8) {
+		switch (key & 0xFF) {
+			case 'M':
+				reg = DEST_M;
+				break;
+			case 'D':
+				reg = DEST_D;
+				break;
+			case 'A':
+				reg = DEST_A;
+				break;
+			default:
+				return 1;
+		}
+
+		if (regs & reg)
+			return 1;	// We already parsed this register!
+
+		regs |= reg;
+	}
+
+	return n2t_set_dest(dest, regs);
+}
+
 
-	for (i = 0; i <= COMP_MPLUS1; i++) {
-		if (strcmp(norm_repr, INDEX_TO_COMP[i]) == 0)
-			return i;
+static int n2t_scan_Ainstr(
+	char const *p, char const *const end, strtable_t *labels, Ainstr_t *dest
+) {
+	char const *const name = p;
+	uint32_t value = 0;
+	int numeric = 1;
+	int64_t label;
+
+	for (; p < end && IS_LABEL_CHAR(*p); p++) {
+		// Digits past the largest constant no longer matter: stopping there
+		// keeps `value' from wrapping around.
+		if (!IS_DIGIT(*p))
+			numeric = 0;
+		else if (value <= AINSTR_MAX_CONSTANT)
+			value = value * 10 + (*p - '0');
 	}
 
-	return COMP_ERROR;
+	if (p == name || !n2t_scan_blank(p, end))
+		return 1;
+
+	if (numeric) {
+		// `\d+' digits, small enough not to set the opcode bit.
+		if (value > AINSTR_MAX_CONSTANT)
+			return 1;
+
+		dest->memptr.location = value;
+		dest->memptr.loaded = 1;
+		dest->memptr.label = STRTABLE_EMPTY;
+		dest->memptr.type = RAM;
+	} else if (!IS_DIGIT(name[0])) {
+		// @R0, @R1, ..., @SP, @THIS, ..., @LABEL, @label, @...
+		if ((label = n2t_strtable_intern(labels, name, p - name)) < 0)
+			return 1;
+
+		dest->memptr.loaded = 0;
+		dest->memptr.label = label;
+		dest->memptr.type = UNKNOWN;
+	} else {
+		return 1;
+	}
+
+	return 0;
+}
+
+static int n2t_scan_Cinstr(char const *p, char const *const end, Cinstr_t *dest) {
+	// The field being read. The first one can be either `dest' or `comp',
+	// depending on whether it is followed by a `='.
+	enum {
+		FIELD_DEST_OR_COMP, FIELD_COMP, FIELD_JUMP
+	} field = FIELD_DEST_OR_COMP;
+	uint32_t key = 0;
+	size_t chars = 0;
+	word_t encoding;
+
+	*dest = 0;
+
+	for (; p < end && !IS_COMMENT(p, end); p++) {
+		if (IS_SPACE(*p))
+			continue;
+
+		switch (*p) {
+			case SYM_EQ:
+				if (field != FIELD_DEST_OR_COMP)
+					return 2;	// A `=' within the `comp' or `jump' fields.
+				if (n2t_parse_Cinstr_dest(key, chars, dest))
+					return 1;
+
+				field = FIELD_COMP;
+				key = chars = 0;
+				break;
+			case SYM_SEMIC:
+				if (field == FIELD_JUMP)
+					return 3;
+
+				encoding = n2t_parse_Cinstr_comp(chars ? key: MNEMONIC_INVALID);
+
+				if (encoding == COMP_ERROR)
+					return 2;
+
+				n2t_set_comp(dest, encoding);
+				field = FIELD_JUMP;
+				key = chars = 0;
+				break;
+			default:
+				// Fields longer than three characters are invalid, but are
+				// still scanned to tell which one the error lies in.
+				if (key != MNEMONIC_INVALID) {
+					key = ++chars > 3 ?
+						MNEMONIC_INVALID: (key << 8) | (unsigned char) *p;
+				}
+		}
+	}
+
+	if (field == FIELD_JUMP) {
+		encoding = n2t_parse_Cinstr_jump(chars ? key: MNEMONIC_INVALID);
+
+		if (encoding == JUMP_ERROR)
+			return 3;
+
+		n2t_set_jump(dest, encoding);
+	} else {
+		encoding = n2t_parse_Cinstr_comp(chars ? key: MNEMONIC_INVALID);
+
+		if (encoding == COMP_ERROR)
+			return 2;
+
+		n2t_set_comp(dest, encoding);
+	}
+
+	*dest |= (0x7 << 13);
+
+	return 0;
+}
+
+static int n2t_scan_label(
+	char const *p, char const *const end, strtable_t *labels, memloc_t *dest
+) {
+	char const *const name = p;
+	int64_t label;
+
+	while (p < end && IS_LABEL_CHAR(*p))
+		p++;
+
+	if (p == name || p == end || *p != ')' || !n2t_scan_blank(p + 1, end))
+		return 1;
+	if ((label = n2t_strtable_intern(labels, name, p - name)) < 0)
+		return 1;
+
+	dest->label = label;
+	dest->type = ROM;
+	dest->loaded = 0;
+
+	return 0;
+}
+
+static int n2t_scan_blank(char const *p, char const *const end) {
+	while (p < end && IS_SPACE(*p))
+		p++;
+
+	return p == end || IS_COMMENT(p, end);
 }
@@ -24,6 +24,8 @@
 
 #include "utils.h"
 #include "memcache.h"
+#include "strtable.h"
+#include "arena.h"
 #include <stdlib.h>
 #include <stdint.h>
 
@@ -42,7 +44,7 @@
 #define	DEST_AMD 7
 
 #define	COMP_0 (32 + 8 + 2)
-#define	COMP_1 (32 + 16 + 8 + 2)
+#define	COMP_1 (32 + 16 + 8 + 4 + 2 + 1)
 #define	COMP_MINUS1 (32 + 16 + 8 + 2)
 #define	COMP_D (8 + 4)
 #define	COMP_A (32 + 16)
@@ -64,10 +66,10 @@
 #define	COMP_MINUSM (64 + 32 + 16 + 2 + 1)
 #define	COMP_MPLUS1 (64 + 32 + 16 + 4 + 2 + 1)
 #define	COMP_MMINUS1 (64 + 32 + 16 + 2)
-#define	COMP_DPLUSM (32 + 16 + 8 + 4 + 1)
+#define	COMP_DPLUSM (64 + 2)
 #define	COMP_DMINUSM (64 + 16 + 2 + 1)
-#define	COMP_MMINUSD (64 + 2)
-#define	COMP_DANDM (32 + 16 + 8 + 2 + 1)
+#define	COMP_MMINUSD (64 + 4 + 2 + 1)
+#define	COMP_DANDM (64)
 #define	COMP_DORM (64 + 16 + 4 + 1)
 // Used to signal errors on return values et simila. It is 120, one greater
 // than the last valid code.
@@ -81,6 +83,8 @@
 #define JUMP_NE 5
 #define JUMP_LE 6
 #define JUMP_ALWAYS 7
+// Used to signal errors on return values, one greater than the last valid code.
+#define JUMP_ERROR 8
 
 
 typedef enum {
@@ -92,14 +96,18 @@ typedef enum {
  * `memloc_t' encodes a memory location (either from the ROM instruction
  * memory, or from the RAM) optionally assigning a name (a label) to it.
  *
+ * The `label' field is the identifier of the name within the `strtable_t' of
+ * the enclosing `tokenseq_t', or `STRTABLE_EMPTY' for unnamed locations.
+ *
  * The `loaded' field is a parser hint for whether this `memloc_t' instance
  * needs further processing during the parsing phase, or is already done.
  */
 typedef struct {
+	uint32_t label;
 	uint16_t location;
-	char label[BUFFSIZE_MED];
 	uint8_t loaded;
-	memtype_t type;
+	// A `memtype_t' value, narrowed to keep `memloc_t' within 8 bytes.
+	uint8_t type;
 } memloc_t;
 
 
@@ -123,13 +131,15 @@ typedef struct {
 
 typedef word_t Cinstr_t;
 
-// Unfortunately, I can't say how space-efficient such a solution can be.
+// Type fields are narrowed to a byte, so that an `instr_t' takes 12 bytes and
+// a `token_t' 16.
 typedef struct {
 	union {
 		Ainstr_t a;
 		Cinstr_t c;
 	} instr;
-	instr_type_t type;
+	// An `instr_type_t' value.
+	uint8_t type;
 } instr_t;
 
 
@@ -142,7 +152,8 @@ typedef struct {
 		instr_t instr;
 		memloc_t label;
 	} data;
-	token_type_t type;
+	// A `token_type_t' value.
+	uint8_t type;
 } token_t;
 
 /**
@@ -151,25 +162,51 @@ typedef struct {
  * is not only to avoid greater memory loads, but to facilitate the parsing
  * phase in which the parser only has to update objects' info only once, and
  * see the change propagate to all the other copies stored in `tokens'.
+ *
+ * Label names are not stored within tokens, but interned into `labels'.
+ * `nlines' counts the lines of source the tokens were read from, and
+ * `ninstrs' the instructions among them once ROM labels are parsed.
+ *
+ * If `arena' is not `NULL', the sequence and all of its storage are allocated
+ * from it, and `n2t_tokenseq_free()' leaves them to be released along with it.
  */
 typedef struct {
 	uint32_t *tokens;
 	// Index of the next `token_t' to be written.
 	uint32_t next;
 	uint32_t ntokens;
+	uint32_t ninstrs;
+	size_t nlines;
 
 	memcache_t *tokens_multiton;
+	strtable_t *labels;
+
+	arena_t *arena;
 } tokenseq_t;
 
 
+#define	SCAN_BLANK 2
+/**
+ * Decodes the `len' characters at `line', which need not be null-terminated,
+ * into `dest'. Classification and decoding take a single left-to-right pass
+ * over `line', with no intermediate copies. Leading and trailing whitespaces,
+ * as well as comments, are ignored. Label names are interned into `labels'.
+ *
+ * Returns: `0' if a token was decoded, `SCAN_BLANK' if `line' holds no token
+ * at all, `1' if `line' could not be decoded.
+ */
+int n2t_scan_line(
+	char const *line, size_t len, strtable_t *labels, token_t *dest
+);
 /**
  * Instantiates an `instr_t' structure from `str_repr', containing its
- * human-readable textual representation.
+ * human-readable textual representation. Label names are interned into
+ * `labels'.
  *
  * Returns: `1' if `str_repr' could not be converted into an `instr_t' type,
  * `0' otherwise.
  */
-int n2t_str_to_instr(char const *str_repr, instr_t *dest);
+int n2t_str_to_instr(char const *str_repr, strtable_t *labels, instr_t *dest);
 #define	BITSTR_BUFFSIZE 17
 /**
  * Converts an instruction `in' in its bit string representation.
@@ -180,29 +217,60 @@ int n2t_str_to_instr(char const *str_repr, instr_t *dest);
  * occurred.
  */
 int n2t_instr_to_bitstr(instr_t in, char *const dest);
+// Length of a line of a .hack file: 16 binary digits and a newline.
+#define	BITLINE_LENGTH 17
 /**
- * Converts an instruction `in' in its string representation.
+ * Returns: the machine word instruction `in' assembles to, `AINSTR_ERROR' if
+ * `in' is an A-instruction not yet resolved.
+ */
+word_t n2t_instr_bits(instr_t in);
+/**
+ * Formats the `n' machine words at `words' as as many .hack lines, each one
+ * made of `BITLINE_LENGTH' characters, looking up four binary digits at a time
+ * from a table.
+ *
+ * Param `dest': destination buffer, at least `n * BITLINE_LENGTH' bytes large.
+ * No null terminator is written.
+ * Returns: the number of characters written to `dest'.
+ */
+size_t n2t_words_to_bitlines(word_t const *words, size_t n, char *dest);
+/**
+ * Converts an instruction `in' in its string representation, looking up label
+ * names in `labels'.
  *
  * Returns: the return value of either `n2t_Ainstr_to_str()' or
  * `n2t_Cinstr_to_str()', or `-1' if an error occurs before delegating the
  * call.
  */
-int n2t_instr_to_str(instr_t const in, char *const dest, size_t maxwrite);
+int n2t_instr_to_str(
+	instr_t const in, strtable_t const *labels, char *const dest,
+	size_t maxwrite
+);
 
 #define	AINSTR_ERROR (1 << 15)
+// Largest constant an A-instruction can load, bit 16 being its opcode.
+#define	AINSTR_MAX_CONSTANT 32767
 /**
  * Param `norm_repr': a normalized representation for the A instruction.
+ * Param `labels': table to intern the referenced label name into, if any.
  * Param `dest': `Ainstr_t' variable on which to store the decoded instruction.
  *
- * Returns: `1' if an error occurs, `0' otherwise.
+ * Returns: `1' if an error occurs (e.g. a constant above
+ * `AINSTR_MAX_CONSTANT'), `0' otherwise.
  */
-int n2t_str_to_Ainstr(char const *norm_repr, Ainstr_t *dest);
+int n2t_str_to_Ainstr(
+	char const *norm_repr, strtable_t *labels, Ainstr_t *dest
+);
 /**
- * Converts an A-instruction `in' in its string representation.
+ * Converts an A-instruction `in' in its string representation, looking up its
+ * label name in `labels'.
  *
  * Returns: `1' if an error occurs, `0' otherwise.
  */
-int n2t_Ainstr_to_str(Ainstr_t const in, char *const dest, size_t maxwrite);
+int n2t_Ainstr_to_str(
+	Ainstr_t const in, strtable_t const *labels, char *const dest,
+	size_t maxwrite
+);
 /**
  * Returns: a bitvector representing the A instruction `in' or `AINSTR_ERROR'
  * if an error occurs.
@@ -272,42 +340,84 @@ word_t n2t_get_jump(Cinstr_t const in);
 
 /**
  * Sets a `memloc_t' variable from `str_repr', containing its human-readable
- * textual representation.
+ * textual representation. The label name is interned into `labels'.
  *
  * Returns: `1' if `str_repr' could not be converted into an `memloc_t' type,
  * `0' otherwise.
  */
-int n2t_str_to_label(char const *str_repr, memloc_t *dest);
+int n2t_str_to_label(char const *str_repr, strtable_t *labels, memloc_t *dest);
 
 
-#define DEFAULT_EXTEND_SIZE 64
 /**
  * Allocates data in the heap storage for `n' `token_t' instances, returning
  * a `tokenseq_t' data type for management or `NULL' if an issue verifies.
  */
 tokenseq_t* n2t_tokenseq_alloc(size_t n);
+/**
+ * Same as `n2t_tokenseq_alloc()', allocating from `arena' unless `NULL'. Room
+ * is made for `n' token indices, while distinct tokens and labels start with
+ * room for at most `BUFFSIZE_LARGE' of them.
+ */
+tokenseq_t* n2t_tokenseq_alloc_in(size_t n, arena_t *arena);
+/**
+ * Appends `index' to the token indices of `s', doubling their storage when
+ * full.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
 int n2t_tokenseq_append_token_index(tokenseq_t *s, uint32_t index);
 int n2t_tokenseq_cache_token(tokenseq_t *s, token_t const t);
+/**
+ * Stores `t' into the multiton of `s' unless an equal token already exists.
+ *
+ * Returns: the multiton index of `t', or a negative value if an error occurs.
+ */
+int64_t n2t_tokenseq_intern_token(tokenseq_t *s, token_t const t);
 /**
  * Returns: a R/W pointer to a `token_t' variable located at index `index'
  * within the token sequence.
  */
 token_t* n2t_tokenseq_index_get(tokenseq_t const *s, uint32_t index);
+/**
+ * Assembles the instructions of `s' into `dest', skipping labels, starting
+ * from token `*from' and stopping once `max' words are stored or the tokens
+ * are over. `*from' is then updated to the first token not yet assembled, so
+ * that successive calls encode `s' a batch at a time.
+ *
+ * Returns: the number of words stored into `dest'.
+ */
+size_t n2t_tokenseq_encode(
+	tokenseq_t const *s, uint32_t *from, word_t *dest, size_t max
+);
 /**
  * Returns: the first `memloc_t' ROM label having the same label as `mould', or
  * `NULL' if none is found. Other fields are not compared.
  */
 memloc_t* n2t_tokenseq_find_rom_label(tokenseq_t const *s, memloc_t mould);
 /**
- * Comments and new lines are ignored.
+ * Comments and new lines are ignored. Lines can be of any length.
  *
- * Param `filepath': a file path of an .asm file to tokenize.
+ * Param `filepath': a file path of an .asm file to tokenize. Its contents are
+ * memory mapped and tokenized by `n2t_tokenize_buffer()'.
  *
  * Returns: a `tokenseq_t' pointer, storing all the Hack-language tokens to be
  * interpreted, or `NULL' if a reading error occurs. The return value should be
  * later freed by a call to `n2t_tokenseq_free()'.
  */
 tokenseq_t* n2t_tokenize(const char *filepath);
+/**
+ * Same as `n2t_tokenize()', reading the `len' bytes of assembly code at `src',
+ * which need not be null-terminated. Lines are located by a `linescan_t', so
+ * `len' can be at most `LINESCAN_MAX_LENGTH'.
+ */
+tokenseq_t* n2t_tokenize_buffer(char const *src, size_t len);
+/**
+ * Same as `n2t_tokenize_buffer()', allocating the tokens from `arena' unless
+ * `NULL'. Their storage is then sized from `len' up front.
+ */
+tokenseq_t* n2t_tokenize_buffer_in(
+	char const *src, size_t len, arena_t *arena
+);
 /**
  * Returns: `1' if `s' can not contain any more `token_t's, `0' otherwise.
  * Note that for a `tokenseq_t' variable `s', `s->next' points to the NEXT
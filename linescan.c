@@ -0,0 +1,358 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "linescan.h"
+#include "utils.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define	LINESCAN_X86
+#include <immintrin.h>
+#include <pthread.h>
+
+// Guards the detection of the CPU features, which may be requested by several
+// threads at once.
+static pthread_once_t cpu_detected = PTHREAD_ONCE_INIT;
+
+static void n2t_linescan_detect_cpu(void) {
+	__builtin_cpu_init();
+}
+#endif
+
+
+/**
+ * Handles the newline or slash at `q', storing a span into `spans' if `q'
+ * terminates a line.
+ *
+ * Returns: `1' if `spans' is full, `0' otherwise.
+ */
+static inline int n2t_linescan_event(
+	linescan_t *s, char const *q, linespan_t *spans, size_t max, size_t *n
+);
+/**
+ * Scans `[p, s->end)' one byte at a time, then reports the last line if it is
+ * not terminated by a newline. `n' spans were already stored into `spans'.
+ *
+ * Returns: the overall number of spans stored.
+ */
+static size_t n2t_linescan_tail(
+	linescan_t *s, char const *p, linespan_t *spans, size_t max, size_t n
+);
+static size_t n2t_linescan_scalar(linescan_t *s, linespan_t *spans, size_t max);
+/**
+ * Discards the lines of `r' already scanned, then reads from its file until at
+ * least one more line is complete or the file is over.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_linereader_fill(linereader_t *r);
+#ifdef LINESCAN_X86
+static size_t n2t_linescan_sse2(linescan_t *s, linespan_t *spans, size_t max);
+static size_t n2t_linescan_avx2(linescan_t *s, linespan_t *spans, size_t max);
+#endif
+
+
+int n2t_linescan_init(
+	linescan_t *s, char const *src, size_t len, linescan_kernel_t kernel
+) {
+	if (len > LINESCAN_MAX_LENGTH || !n2t_linescan_supported(kernel))
+		return 1;
+
+	if (kernel == LINESCAN_AUTO) {
+		if (n2t_linescan_supported(LINESCAN_AVX2))
+			kernel = LINESCAN_AVX2;
+		else if (n2t_linescan_supported(LINESCAN_SSE2))
+			kernel = LINESCAN_SSE2;
+		else
+			kernel = LINESCAN_SCALAR;
+	}
+
+	switch (kernel) {
+#ifdef LINESCAN_X86
+		case LINESCAN_AVX2:
+			s->kernel = n2t_linescan_avx2;
+			break;
+		case LINESCAN_SSE2:
+			s->kernel = n2t_linescan_sse2;
+			break;
+#endif
+		default:
+			s->kernel = n2t_linescan_scalar;
+	}
+
+	s->origin = s->src = src;
+	s->end = src + len;
+	s->comment = NULL;
+
+	return 0;
+}
+
+size_t n2t_linescan_next(linescan_t *s, linespan_t *spans, size_t max) {
+	if (s->src >= s->end || max == 0)
+		return 0;
+
+	return s->kernel(s, spans, max);
+}
+
+int n2t_linescan_supported(linescan_kernel_t kernel) {
+	switch (kernel) {
+		case LINESCAN_AUTO:
+		case LINESCAN_SCALAR:
+			return 1;
+#ifdef LINESCAN_X86
+		case LINESCAN_SSE2:
+			pthread_once(&cpu_detected, n2t_linescan_detect_cpu);
+
+			return __builtin_cpu_supports("sse2");
+		case LINESCAN_AVX2:
+			pthread_once(&cpu_detected, n2t_linescan_detect_cpu);
+
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return 0;
+	}
+}
+
+
+int n2t_linereader_open(char const *filepath, linereader_t *r) {
+	if ((r->fd = open(filepath, O_RDONLY)) < 0)
+		return 1;
+
+	if ((r->buff = malloc(LINEREADER_CHUNK)) == NULL) {
+		close(r->fd);
+		return 1;
+	}
+
+	r->capacity = LINEREADER_CHUNK;
+
+	if (n2t_linereader_rewind(r)) {
+		n2t_linereader_close(r);
+		return 1;
+	}
+
+	return 0;
+}
+
+int n2t_linereader_next(linereader_t *r, char const **line, size_t *len) {
+	linespan_t const *span;
+
+	while (r->nextspan == r->nspans) {
+		r->nspans = n2t_linescan_next(&r->scan, r->spans, LINESCAN_BATCH);
+		r->nextspan = 0;
+
+		if (r->nspans > 0)
+			break;
+		if (r->eof)
+			return 0;
+		if (n2t_linereader_fill(r))
+			return -1;
+	}
+
+	span = r->spans + r->nextspan++;
+	*line = r->buff + span->start;
+	*len = span->cut - span->start;
+
+	return 1;
+}
+
+int n2t_linereader_rewind(linereader_t *r) {
+	if (lseek(r->fd, 0, SEEK_SET) < 0)
+		return 1;
+
+	r->length = r->complete = 0;
+	r->nspans = r->nextspan = 0;
+	r->eof = 0;
+
+	return n2t_linescan_init(&r->scan, r->buff, 0, LINESCAN_AUTO);
+}
+
+void n2t_linereader_close(linereader_t *r) {
+	close(r->fd);
+	free(r->buff);
+	r->buff = NULL;
+}
+
+
+static inline int n2t_linescan_event(
+	linescan_t *s, char const *q, linespan_t *spans, size_t max, size_t *n
+) {
+	if (*q == '\n') {
+		spans[*n].start = s->src - s->origin;
+		spans[*n].cut = (s->comment ? s->comment: q) - s->origin;
+		s->src = q + 1;
+		s->comment = NULL;
+
+		return ++*n == max;
+	} else if (s->comment == NULL && q + 1 < s->end && q[1] == '/') {
+		s->comment = q;
+	}
+
+	return 0;
+}
+
+static size_t n2t_linescan_tail(
+	linescan_t *s, char const *p, linespan_t *spans, size_t max, size_t n
+) {
+	for (; p < s->end; p++) {
+		if ((*p == '\n' || *p == '/') && n2t_linescan_event(s, p, spans, max, &n))
+			return n;
+	}
+
+	if (s->src < s->end) {
+		spans[n].start = s->src - s->origin;
+		spans[n].cut = (s->comment ? s->comment: s->end) - s->origin;
+		s->src = s->end;
+		s->comment = NULL;
+		n++;
+	}
+
+	return n;
+}
+
+static size_t n2t_linescan_scalar(linescan_t *s, linespan_t *spans, size_t max) {
+	char const *line_end, *q;
+	size_t n;
+
+	for (n = 0; n < max && s->src < s->end; n++) {
+		if ((line_end = memchr(s->src, '\n', s->end - s->src)) == NULL)
+			line_end = s->end;
+
+		// The first `//' within the line, if any.
+		for (
+			q = s->src;
+			(q = memchr(q, '/', line_end - q)) != NULL && q + 1 < line_end;
+			q++
+		) {
+			if (q[1] == '/')
+				break;
+		}
+
+		spans[n].start = s->src - s->origin;
+		spans[n].cut = (q && q + 1 < line_end ? q: line_end) - s->origin;
+		s->src = line_end < s->end ? line_end + 1: s->end;
+	}
+
+	return n;
+}
+
+static int n2t_linereader_fill(linereader_t *r) {
+	char *updated_buff;
+	ssize_t nread;
+	size_t i;
+
+	memmove(r->buff, r->buff + r->complete, r->length - r->complete);
+	r->length -= r->complete;
+	r->complete = 0;
+
+	while (r->complete == 0 && !r->eof) {
+		// Only lines longer than the whole buffer make it grow.
+		if (r->length == r->capacity) {
+			if ((updated_buff = realloc(r->buff, 2 * r->capacity)) == NULL)
+				return 1;
+
+			r->buff = updated_buff;
+			r->capacity *= 2;
+		}
+
+		nread = read(
+			r->fd, r->buff + r->length,
+			MIN(LINEREADER_CHUNK, r->capacity - r->length)
+		);
+
+		if (nread < 0 && errno == EINTR) {
+			continue;
+		} else if (nread < 0) {
+			return 1;
+		} else if (nread == 0) {
+			r->eof = 1;
+			r->complete = r->length;
+		}
+
+		// The last newline can only be among the bytes just read.
+		for (i = r->length + nread; i > r->length; i--) {
+			if (r->buff[i - 1] == '\n') {
+				r->complete = i;
+				break;
+			}
+		}
+
+		r->length += nread;
+	}
+
+	return n2t_linescan_init(&r->scan, r->buff, r->complete, LINESCAN_AUTO);
+}
+
+#ifdef LINESCAN_X86
+__attribute__((target("sse2")))
+static size_t n2t_linescan_sse2(linescan_t *s, linespan_t *spans, size_t max) {
+	__m128i const newline = _mm_set1_epi8('\n'), slash = _mm_set1_epi8('/');
+	__m128i block;
+	char const *p;
+	uint32_t mask;
+	size_t n = 0;
+
+	for (p = s->src; p + 16 <= s->end; p += 16) {
+		block = _mm_loadu_si128((__m128i const*) p);
+		mask = _mm_movemask_epi8(
+			_mm_or_si128(
+				_mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, slash)
+			)
+		);
+
+		for (; mask; mask &= mask - 1) {
+			if (n2t_linescan_event(s, p + __builtin_ctz(mask), spans, max, &n))
+				return n;
+		}
+	}
+
+	return n2t_linescan_tail(s, p, spans, max, n);
+}
+
+__attribute__((target("avx2")))
+static size_t n2t_linescan_avx2(linescan_t *s, linespan_t *spans, size_t max) {
+	__m256i const newline = _mm256_set1_epi8('\n'), slash = _mm256_set1_epi8('/');
+	__m256i block;
+	char const *p;
+	uint32_t mask;
+	size_t n = 0;
+
+	for (p = s->src; p + 32 <= s->end; p += 32) {
+		block = _mm256_loadu_si256((__m256i const*) p);
+		mask = _mm256_movemask_epi8(
+			_mm256_or_si256(
+				_mm256_cmpeq_epi8(block, newline),
+				_mm256_cmpeq_epi8(block, slash)
+			)
+		);
+
+		for (; mask; mask &= mask - 1) {
+			if (n2t_linescan_event(s, p + __builtin_ctz(mask), spans, max, &n))
+				return n;
+		}
+	}
+
+	return n2t_linescan_tail(s, p, spans, max, n);
+}
+#endif
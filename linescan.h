@@ -0,0 +1,136 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef LINESCAN_H
+#define LINESCAN_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+
+// Largest input, in bytes, that a `linescan_t' can index: offsets within the
+// input are stored as `uint32_t'.
+#define	LINESCAN_MAX_LENGTH UINT32_MAX
+// Number of spans that `n2t_tokenize_buffer()' requests per batch.
+#define	LINESCAN_BATCH 256
+// Initial size of the buffer of a `linereader_t', and amount of bytes it asks
+// for at each read.
+#define	LINEREADER_CHUNK (1 << 16)
+
+/**
+ * The line boundaries of a single line, as offsets from the beginning of the
+ * scanned input. `start' is the offset of the first character of the line,
+ * `cut' that of the newline ending it or of the `//' opening its comment,
+ * whichever comes first. `[start, cut)' is hence all a tokenizer needs to
+ * look at; the newline is never part of it.
+ */
+typedef struct {
+	uint32_t start, cut;
+} linespan_t;
+
+typedef enum {
+	// Picks the widest kernel the running CPU supports.
+	LINESCAN_AUTO,
+	LINESCAN_SCALAR,
+	LINESCAN_SSE2,
+	LINESCAN_AVX2
+} linescan_kernel_t;
+
+/**
+ * A `linescan_t' splits an input buffer into lines, reporting them in batches
+ * of `linespan_t'. The x86 kernels compare 16 (SSE2) or 32 (AVX2) bytes at a
+ * time against `\n' and `/' and only stop on the matching bytes, while the
+ * scalar one relies on `memchr()'. All of them yield the same spans.
+ *
+ * `src' is the beginning of the line yet to be reported and `comment' the
+ * beginning of its comment, if one was already met.
+ */
+typedef struct linescan_s {
+	char const *origin, *src, *end, *comment;
+	size_t (*kernel)(struct linescan_s*, linespan_t*, size_t);
+} linescan_t;
+
+/**
+ * A `linereader_t' reads a file one chunk at a time, splitting it into lines
+ * with a `linescan_t'. Its memory use is bounded by the chunk size, or by the
+ * longest line should it be larger, regardless of the file size.
+ *
+ * `buff' holds `length' bytes of the file, the first `complete' of which end
+ * with a newline (or with the file) and are being scanned by `scan'. The
+ * remaining ones belong to a line yet to be read in full.
+ */
+typedef struct {
+	int fd;
+	char *buff;
+	size_t capacity, length, complete;
+	uint8_t eof;
+
+	linescan_t scan;
+	linespan_t spans[LINESCAN_BATCH];
+	size_t nspans, nextspan;
+} linereader_t;
+
+/**
+ * Prepares `s' for splitting the `len' bytes at `src' with `kernel'.
+ *
+ * Returns: `1' if `len' exceeds `LINESCAN_MAX_LENGTH' or `kernel' is not
+ * supported by the running CPU, `0' otherwise.
+ */
+int n2t_linescan_init(
+	linescan_t *s, char const *src, size_t len, linescan_kernel_t kernel
+);
+/**
+ * Stores the spans of up to `max' subsequent lines into `spans'. A last line
+ * not terminated by a newline is reported as well, while an empty one is not.
+ *
+ * Returns: the number of spans stored, `0' once the whole input was scanned.
+ */
+size_t n2t_linescan_next(linescan_t *s, linespan_t *spans, size_t max);
+/**
+ * Returns: `1' if the running CPU can execute `kernel', `0' otherwise.
+ */
+int n2t_linescan_supported(linescan_kernel_t kernel);
+
+/**
+ * Opens `filepath' for reading with `r'.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+int n2t_linereader_open(char const *filepath, linereader_t *r);
+/**
+ * Reads the next line of `r', as split by `n2t_linescan_next()'. `*line' is
+ * valid until the following call and is not null-terminated; its `*len'
+ * characters exclude the newline and any comment.
+ *
+ * Returns: `1' if a line was read, `0' at the end of the file, `-1' if an error
+ * occurs.
+ */
+int n2t_linereader_next(linereader_t *r, char const **line, size_t *len);
+/**
+ * Moves `r' back to the beginning of its file.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+int n2t_linereader_rewind(linereader_t *r);
+void n2t_linereader_close(linereader_t *r);
+
+
+#endif
@@ -22,117 +22,375 @@
 #include "memcache.h"
 #include <string.h>
 
+
+#define	FNV_OFFSET_BASIS 2166136261u
+#define	FNV_PRIME 16777619u
+
+/**
+ * Returns: a pointer to the unit of index `index', with no bound checking.
+ */
+static void* n2t_memcache_unit(memcache_t const *c, uint32_t index);
+/**
+ * Computes the FNV-1a hash of `obj', as if it were zero-padded up to
+ * `unitsize' bytes.
+ */
+static uint32_t n2t_memcache_hash(
+	void const *obj, uint32_t objsize, uint32_t unitsize
+);
+/**
+ * Returns: `1' if the unit pointed to by `unit' equals `mould' zero-padded up
+ * to `c->unitsize' bytes, `0' otherwise.
+ */
+static int n2t_memcache_equals(
+	memcache_t const *c, void const *unit, void const *mould, uint32_t mouldsize
+);
+/**
+ * Looks up `mould' in the hash index of `c'.
+ *
+ * Param `slot': if not `NULL', set to the slot holding `mould' or, when
+ * missing, to the empty slot where it should be inserted.
+ * Returns: the index of the unit equal to `mould', `-1' if none was found.
+ */
+static int64_t n2t_memcache_probe(
+	memcache_t const *c, void const *mould, uint32_t mouldsize, uint32_t hash,
+	uint32_t *slot
+);
+/**
+ * Appends `source' to `c', given that `slot' is the empty slot returned by
+ * `n2t_memcache_probe()' for it.
+ *
+ * Returns: the index `source' was stored at, `-1' if an error occurs.
+ */
+static int64_t n2t_memcache_insert(
+	memcache_t *c, void const *source, uint32_t objsize, uint32_t hash,
+	uint32_t slot
+);
+/**
+ * Rebuilds the hash index of `c' with `slots' slots.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_memcache_rehash(memcache_t *c, uint32_t slots);
+/**
+ * Allocates `n' zeroed objects of `size' bytes from the arena of `c', or from
+ * the heap if it has none.
+ *
+ * Returns: a pointer to them, or `NULL' if an error occurs.
+ */
+static void* n2t_memcache_zeroed(memcache_t const *c, size_t n, size_t size);
+
+
 memcache_t* n2t_memcache_alloc(uint32_t units, uint32_t unitsize) {
+	return n2t_memcache_alloc_in(units, unitsize, NULL);
+}
+
+memcache_t* n2t_memcache_alloc_in(
+	uint32_t units, uint32_t unitsize, arena_t *arena
+) {
 	memcache_t *o;
+	uint32_t slots = MEMCACHE_MIN_SLOTS;
 
 	if (units < 1 || unitsize < 1)
 		return NULL;
 
-	if ((o = malloc(sizeof(memcache_t))) == NULL)
-		return NULL;
-	
-	o->head = calloc(units, unitsize);
+	if (arena) {
+		// Units are zero-padded as they are stored: chunks need no clearing.
+		o = n2t_arena_push(arena, sizeof(memcache_t));
+
+		if (o == NULL)
+			return NULL;
+		if ((o->chunks[0] = n2t_arena_push(arena, units * unitsize)) == NULL)
+			return NULL;
+	} else {
+		if ((o = malloc(sizeof(memcache_t))) == NULL)
+			return NULL;
+
+		o->chunks[0] = calloc(units, unitsize);
+
+		if (o->chunks[0] == NULL) {
+			free(o);
+			return NULL;
+		}
+	}
+
+	while (slots < 2 * (uint64_t) units)
+		slots <<= 1;
+
+	o->arena = arena;
+	o->index = n2t_memcache_zeroed(o, slots, sizeof(uint32_t));
+
+	if (o->index == NULL) {
+		if (arena == NULL) {
+			free(o->chunks[0]);
+			free(o);
+		}
 
-	if (o->head == NULL) {
-		free(o);
 		return NULL;
 	}
 
+	o->nchunks = 1;
+	o->first = units;
 	o->unitsize = unitsize;
 	o->next = 0;
 	o->length = units;
+	o->slots = slots;
 	
 	return o;
 }
 
 int n2t_memcache_extend(memcache_t *c, uint32_t n) {
-	void *updated_head;
+	uint64_t const target = (uint64_t) c->length + n;
+	uint64_t chunklen;
+	void *chunk;
+
+	if (target > UINT32_MAX)
+		return 1;
 
-	if (n > 0) {
-		updated_head = realloc(c->head, c->unitsize * (c->length + n));
+	while (c->length < target) {
+		chunklen = (uint64_t) c->first << c->nchunks;
 
-		if (updated_head == NULL)
+		if (
+			c->nchunks >= MEMCACHE_MAX_CHUNKS ||
+			c->length + chunklen > UINT32_MAX
+		)
 			return 1;
+		chunk = c->arena ?
+			n2t_arena_push(c->arena, chunklen * c->unitsize):
+			malloc(chunklen * c->unitsize);
 
-		c->head = updated_head;
-		c->length += n;
+		if (chunk == NULL)
+			return 1;
+
+		c->chunks[c->nchunks] = chunk;
+		c->nchunks++;
+		c->length += chunklen;
 	}
 
 	return 0;
 }
 
 int64_t n2t_memcache_store(memcache_t *c, void const *source, uint32_t objsize) {
+	uint32_t hash, slot;
+
 	if (source == NULL) {
 		return -1;
 	} else if (objsize > c->unitsize) {
 		return -2;
-	} else if (n2t_memcache_fetch(c, source, objsize) != NULL) {
-		return -3;
 	}
-	
-	if (MEMCACHE_FULL(c)) {
-		n2t_memcache_extend(c, MEMCACHE_DEFAULT_EXTEND);
+
+	hash = n2t_memcache_hash(source, objsize, c->unitsize);
+
+	if (n2t_memcache_probe(c, source, objsize, hash, &slot) >= 0)
+		return -3;
+
+	return n2t_memcache_insert(c, source, objsize, hash, slot);
+}
+
+int64_t n2t_memcache_intern(memcache_t *c, void const *source, uint32_t objsize) {
+	uint32_t hash, slot;
+	int64_t i;
+
+	if (source == NULL) {
+		return -1;
+	} else if (objsize > c->unitsize) {
+		return -2;
 	}
 
-	memcpy(
-		c->head + MEMCACHE_OFFSET(c, c->next), source,
-		MIN(c->unitsize, objsize)
-	);
-	// Set the remaining memory to `0', if any.
-	memset(
-		c->head + MEMCACHE_OFFSET(c, c->next) + MIN(c->unitsize, objsize), 0,
-		c->unitsize - MIN(c->unitsize, objsize)
-	);
-	c->next++;
+	hash = n2t_memcache_hash(source, objsize, c->unitsize);
 
-	return c->next - 1;
+	if ((i = n2t_memcache_probe(c, source, objsize, hash, &slot)) >= 0)
+		return i;
+
+	return n2t_memcache_insert(c, source, objsize, hash, slot);
 }
 
 void* n2t_memcache_fetch(memcache_t const *c, void const *mould, uint32_t mouldsize) {
-	uint32_t const cmpsize = MIN(c->unitsize, mouldsize);
-	size_t i;
+	int64_t i;
 
 	if (mould == NULL)
 		return NULL;
 	if (mouldsize > c->unitsize)
 		return NULL;
 
-	for (i = 0; i < c->next; i++) {
-		if (memcmp(c->head + MEMCACHE_OFFSET(c, i), mould, cmpsize) == 0) {
-			return c->head + MEMCACHE_OFFSET(c, i);
-		}
-	}
+	i = n2t_memcache_probe(
+		c, mould, mouldsize, n2t_memcache_hash(mould, mouldsize, c->unitsize),
+		NULL
+	);
 
-	return NULL;
+	return i >= 0 ? n2t_memcache_unit(c, i): NULL;
 }
 
 int64_t n2t_memcache_index_of(
 	memcache_t const *c, void const *mould, uint32_t mouldsize
 ) {
-	uint32_t const cmpsize = MIN(c->unitsize, mouldsize);
-	uint32_t o;
-
 	if (mouldsize > c->unitsize)
 		return -2;
 	else if (mould == NULL)
 		return -3;
 
-	for (o = 0; o < c->next; o++) {
-		if (memcmp(c->head + MEMCACHE_OFFSET(c, o), mould, cmpsize) == 0)
-			return o;
-	}
-
-	return -1;
+	return n2t_memcache_probe(
+		c, mould, mouldsize, n2t_memcache_hash(mould, mouldsize, c->unitsize),
+		NULL
+	);
 }
 
 void* n2t_memcache_index_fetch(memcache_t const *c, uint32_t index) {
 	if (index >= c->next)
 		return NULL;
 
-	return c->head + MEMCACHE_OFFSET(c, index);
+	return n2t_memcache_unit(c, index);
 }
 
 void n2t_memcache_free(memcache_t *c) {
-	free(c->head);
+	uint32_t k;
+
+	// Released along with the arena.
+	if (c->arena)
+		return;
+
+	for (k = 0; k < c->nchunks; k++)
+		free(c->chunks[k]);
+
+	free(c->index);
 	free(c);
 }
+
+
+static void* n2t_memcache_unit(memcache_t const *c, uint32_t index) {
+	// `index' lies within chunk `k' if `2^k <= index / first + 1 < 2^(k + 1)'.
+	uint32_t const k = 31 - __builtin_clz(index / c->first + 1);
+	uint64_t const offset = index - (((uint64_t) c->first << k) - c->first);
+
+	return c->chunks[k] + offset * c->unitsize;
+}
+
+
+static uint32_t n2t_memcache_hash(
+	void const *obj, uint32_t objsize, uint32_t unitsize
+) {
+	unsigned char const *bytes = obj;
+	uint32_t hash = FNV_OFFSET_BASIS, i;
+
+	for (i = 0; i < objsize; i++)
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+	// Hashing the padding bytes, all `0', amounts to the multiplication alone.
+	for (; i < unitsize; i++)
+		hash *= FNV_PRIME;
+
+	return hash;
+}
+
+static int n2t_memcache_equals(
+	memcache_t const *c, void const *unit, void const *mould, uint32_t mouldsize
+) {
+	unsigned char const *bytes = unit;
+	uint32_t i;
+
+	if (memcmp(unit, mould, mouldsize))
+		return 0;
+
+	for (i = mouldsize; i < c->unitsize; i++) {
+		if (bytes[i])
+			return 0;
+	}
+
+	return 1;
+}
+
+static int64_t n2t_memcache_probe(
+	memcache_t const *c, void const *mould, uint32_t mouldsize, uint32_t hash,
+	uint32_t *slot
+) {
+	uint32_t const mask = c->slots - 1;
+	uint32_t i = hash & mask, unit;
+
+	// The index is never full, hence an empty slot is always met.
+	while (c->index[i]) {
+		unit = c->index[i] - 1;
+
+		if (
+			n2t_memcache_equals(
+				c, n2t_memcache_unit(c, unit), mould, mouldsize
+			)
+		) {
+			if (slot)
+				*slot = i;
+
+			return unit;
+		}
+
+		i = (i + 1) & mask;
+	}
+
+	if (slot)
+		*slot = i;
+
+	return -1;
+}
+
+static int64_t n2t_memcache_insert(
+	memcache_t *c, void const *source, uint32_t objsize, uint32_t hash,
+	uint32_t slot
+) {
+	void *unit;
+
+	// Every new chunk doubles the capacity of the cache.
+	if (MEMCACHE_FULL(c)) {
+		if (n2t_memcache_extend(c, 1))
+			return -1;
+	}
+
+	// Keep the load factor of the index at one half at most.
+	if (2 * ((uint64_t) c->next + 1) > c->slots) {
+		if (n2t_memcache_rehash(c, c->slots << 1))
+			return -1;
+
+		n2t_memcache_probe(c, source, objsize, hash, &slot);
+	}
+
+	unit = n2t_memcache_unit(c, c->next);
+	memcpy(unit, source, MIN(c->unitsize, objsize));
+	// Set the remaining memory to `0', if any.
+	memset(
+		unit + MIN(c->unitsize, objsize), 0,
+		c->unitsize - MIN(c->unitsize, objsize)
+	);
+	c->index[slot] = c->next + 1;
+	c->next++;
+
+	return c->next - 1;
+}
+
+static int n2t_memcache_rehash(memcache_t *c, uint32_t slots) {
+	uint32_t *const updated_index = n2t_memcache_zeroed(
+		c, slots, sizeof(uint32_t)
+	);
+	uint32_t const mask = slots - 1;
+	uint32_t u, i;
+
+	if (updated_index == NULL)
+		return 1;
+
+	for (u = 0; u < c->next; u++) {
+		i = n2t_memcache_hash(
+			n2t_memcache_unit(c, u), c->unitsize, c->unitsize
+		) & mask;
+
+		while (updated_index[i])
+			i = (i + 1) & mask;
+
+		updated_index[i] = u + 1;
+	}
+
+	if (c->arena == NULL)
+		free(c->index);
+
+	c->index = updated_index;
+	c->slots = slots;
+
+	return 0;
+}
+
+static void* n2t_memcache_zeroed(memcache_t const *c, size_t n, size_t size) {
+	return c->arena ? n2t_arena_zeroed(c->arena, n, size): calloc(n, size);
+}
@@ -25,26 +25,63 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include "utils.h"
+#include "arena.h"
 
 
-#define MEMCACHE_OFFSET(c, i)	(c->unitsize * i)
 #define MEMCACHE_FULL(c)	(c->next >= c->length)
-#define	MEMCACHE_DEFAULT_EXTEND 64
+// Upper bound to the number of chunks a `memcache_t' can be made of. Since
+// every chunk is twice as large as the previous one, 32 chunks cover more units
+// than a `uint32_t' index can address.
+#define	MEMCACHE_MAX_CHUNKS 32
+// Minimum number of slots of the hash index. Must be a power of two.
+#define	MEMCACHE_MIN_SLOTS 16
 
 /**
  * The `memcache_t' structure is a facility designed to "cache" same-valued
  * objects, which is particularly useful in enclosing project during the
  * parsing phase.
+ *
+ * Units are stored in a list of chunks: `chunks[0]' holds `first' units and
+ * each following chunk twice as many as its predecessor, so that `chunks[k]'
+ * begins at unit `first * (2^k - 1)'. Growing the cache only ever allocates a
+ * new chunk: stored objects are never moved nor copied, and pointers to them
+ * stay valid until `n2t_memcache_free()' is called.
+ *
+ * Lookups do not scan the chunks: an open-addressing hash table, `index', maps
+ * the hash of a unit to its position within the cache. Each slot holds the
+ * unit index plus one, or `0' if the slot is empty. `slots' is always a power
+ * of two and at least twice as large as `next', so that probe sequences stay
+ * short.
+ *
+ * Objects smaller than `unitsize' are stored and compared as if they were
+ * padded with zeros up to `unitsize' bytes.
+ *
+ * If `arena' is not `NULL', the cache, its chunks and its index are allocated
+ * from it, and released along with it.
  */
 typedef struct {
-	void *head;
+	void *chunks[MEMCACHE_MAX_CHUNKS];
+	uint32_t nchunks, first;
 	uint32_t unitsize;
 	uint32_t next, length;
+
+	uint32_t *index;
+	uint32_t slots;
+
+	arena_t *arena;
 } memcache_t;
 
 memcache_t* n2t_memcache_alloc(uint32_t units, uint32_t unitsize);
 /**
- * Extends the number of objects stored by `c' by an additional `n'.
+ * Same as `n2t_memcache_alloc()', allocating from `arena' unless `NULL'.
+ */
+memcache_t* n2t_memcache_alloc_in(
+	uint32_t units, uint32_t unitsize, arena_t *arena
+);
+/**
+ * Extends the number of objects storable by `c' by at least an additional
+ * `n', appending as many chunks as needed. Objects already stored are left in
+ * place.
  *
  * Returns: `1' if an error occurs, `0' otherwise.
  */
@@ -61,7 +98,19 @@ int n2t_memcache_extend(memcache_t *c, uint32_t n);
  */
 int64_t n2t_memcache_store(memcache_t *c, void const *source, uint32_t objsize);
 /**
- * Param `mouldsize': size of the objects to compare.
+ * Stores `source' into `c' unless an equal object is already present, looking
+ * it up only once.
+ *
+ * Returns:
+ *   - `-1' if `source == NULL' or the cache could not be extended
+ *   - `-2' if `objsize' was strictly greater than `c->unitsize'
+ *   - the index of the object equal to `source', whether it was already
+ *   stored or has just been inserted, otherwise.
+ */
+int64_t n2t_memcache_intern(memcache_t *c, void const *source, uint32_t objsize);
+/**
+ * Param `mouldsize': size of the objects to compare. `mould' is considered
+ * zero-padded up to `c->unitsize' bytes.
  *
  * Returns: a pointer to a memory area equal to `mould' or `NULL' if none was
  * found (or an error occurs, e.g. `mouldsize > c->unitsize).
@@ -21,14 +21,13 @@
 // SOFTWARE.
 #include "utils.h"
 #include "parser.h"
+#include "symtable.h"
+#include "linescan.h"
+#include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 
 
-typedef struct {
-	char id[BUFFSIZE_MED];
-	uint32_t address;
-} ramvar_t;
-
 ramvar_t const DEFAULT_RAMVARS[] = {
 	{"R0", RAMVAR_R0}, {"R1", RAMVAR_R1}, {"R2", RAMVAR_R2}, {"R3", RAMVAR_R3},
 	{"R4", RAMVAR_R4}, {"R5", RAMVAR_R5}, {"R6", RAMVAR_R6}, {"R7", RAMVAR_R7},
@@ -41,38 +40,290 @@ ramvar_t const DEFAULT_RAMVARS[] = {
 	{"THAT", RAMVAR_THAT},
 };
 
-static int n2t_parse_rom_labels(tokenseq_t *const s);
-static int n2t_assign_rom_labels(tokenseq_t *const s);
-static int n2t_assign_ram_labels(tokenseq_t *const s);
+/**
+ * A chunk of lines of the input to `n2t_parse_with()', tokenized by its own
+ * thread into `seq', whose labels and multiton are local to the chunk.
+ * `ninstrs' counts the instructions of the chunk, while `labels' lists its
+ * label definitions in order: the `label' field of each one is an identifier
+ * of `seq->labels', and the `location' field the number of instructions of
+ * the chunk preceding it.
+ */
+typedef struct {
+	char const *src;
+	size_t len;
+
+	tokenseq_t *seq;
+	size_t ninstrs;
+	memloc_t *labels;
+	size_t nlabels, capacity;
+} parsechunk_t;
 
 /**
- * Param `a': a `ramvar_t' array.
- * Param `n': number of elements in `a'.
- * Param `varname': RAM variable name to look for in `a'.
+ * Resolves the symbols of the freshly tokenized `s': predefined variables are
+ * seeded, then ROM labels defined and every A-instruction resolved. If
+ * `filepath' is not `NULL', `s' is empty and `filepath' is first tokenized into
+ * it with the threads requested by `opts'. `s' is freed on error. The phases
+ * are timed from `mark', which the caller started.
+ *
+ * Returns: `s', or `NULL' if an error occurs, described in `errmsg' if not
+ * `NULL'.
+ */
+static tokenseq_t* n2t_resolve_tokens(
+	tokenseq_t *s, char const *filepath, parseopts_t const *opts,
+	statsmark_t *mark, char errmsg[], size_t maxwrite
+);
+/**
+ * Tokenizes `filepath' with `nthreads' threads, one per chunk of lines, and
+ * merges the chunks into `s' in order, defining their ROM labels into
+ * `symbols' as `n2t_parse_rom_labels()' would.
+ *
+ * Returns: `0' if no errors occur, `SYMTABLE_DUPLICATE' if a label is defined
+ * more than once, `1' otherwise. On error, a description of it is written to
+ * `errmsg', if not `NULL'.
+ */
+static int n2t_tokenize_parallel(
+	char const *filepath, unsigned nthreads, tokenseq_t *s,
+	symtable_t *symbols, char errmsg[], size_t maxwrite
+);
+/**
+ * Thread routine tokenizing the `parsechunk_t' pointed to by `chunk'.
+ *
+ * Returns: `chunk' itself on success, `NULL' otherwise.
+ */
+static void* n2t_tokenize_chunk(void *chunk);
+/**
+ * Appends the tokens of `c' to `s', translating the label identifiers of the
+ * chunk into those of `s', and defines its labels into `symbols' with ROM
+ * address `instroffset' onwards.
+ *
+ * Returns: same as `n2t_tokenize_parallel()'.
+ */
+static int n2t_merge_chunk(
+	tokenseq_t *s, symtable_t *symbols, parsechunk_t const *c,
+	size_t instroffset, char errmsg[], size_t maxwrite
+);
+/**
+ * First pass of `n2t_parse_stream()': reads the whole of `r', defining only the
+ * ROM labels into `symbols', with the same rules as `n2t_parse_rom_labels()'.
+ *
+ * Returns: `0' if no errors occur, `SYMTABLE_DUPLICATE' if a label is defined
+ * more than once, `1' otherwise, describing the error in `errmsg'.
+ */
+static int n2t_stream_rom_labels(
+	linereader_t *r, strtable_t *labels, symtable_t *symbols, char errmsg[],
+	size_t maxwrite
+);
+/**
+ * Second pass of `n2t_parse_stream()': reads the whole of `r' again, resolving
+ * and encoding instructions as they come and handing them to `sink' a batch at
+ * a time. Variables are allocated as in `n2t_assign_ram_labels()'.
+ *
+ * Returns: `1' if an error occurs, describing it in `errmsg', `0' otherwise.
+ */
+static int n2t_stream_encode(
+	linereader_t *r, strtable_t *labels, symtable_t *symbols, wordsink_t sink,
+	void *arg, char errmsg[], size_t maxwrite
+);
+/**
+ * Reads and scans the next line of `r' holding a token. `*lineno' is advanced
+ * past the lines read.
  *
- * Returns: the `address' field value of a `ramvar_t' object in `a' having the
- * same `id' as `varname'.
+ * Returns: `1' if a token was stored into `dest', `0' at the end of `r', `-1'
+ * if an error occurs, describing it in `errmsg'.
+ */
+static int n2t_stream_next_token(
+	linereader_t *r, strtable_t *labels, token_t *dest, size_t *lineno,
+	char errmsg[], size_t maxwrite
+);
+/**
+ * Records into `stats', unless `NULL', the counters of an assembly: those of
+ * `s' if not `NULL', and the symbols of `symbols', `ndefined' of which were
+ * defined before the RAM variables were allocated.
  */
-static int64_t n2t_varname_to_address(
-	ramvar_t const *a, size_t const n, char const *varname
+static void n2t_record_stats(
+	asmstats_t *stats, tokenseq_t const *s, symtable_t const *symbols,
+	uint32_t ndefined
 );
 
 
-tokenseq_t* n2t_parse(char const *filepath) {
+tokenseq_t* n2t_parse(char const *filepath, char errmsg[], size_t maxwrite) {
+	return n2t_parse_with(filepath, NULL, errmsg, maxwrite);
+}
+
+tokenseq_t* n2t_parse_with(
+	char const *filepath, parseopts_t const *opts, char errmsg[],
+	size_t maxwrite
+) {
+	unsigned const nthreads = opts ? opts->nthreads: 1;
+	arena_t *const arena = opts ? opts->arena: NULL;
+	asmstats_t *const stats = opts ? opts->stats: NULL;
+	statsmark_t mark;
+	filemap_t input;
+	tokenseq_t *s = NULL;
+
+	n2t_stats_start(stats, &mark);
+
+	if (nthreads > 1) {
+		// Labels are defined while merging the chunks, after the predefined
+		// variables they might shadow: tokenization is timed along with them.
+		s = n2t_tokenseq_alloc_in(BUFFSIZE_LARGE, arena);
+	} else if (!n2t_filemap_open(filepath, &input)) {
+		s = n2t_tokenize_buffer_in(input.data, input.length, arena);
+		n2t_filemap_close(&input);
+		n2t_stats_lap(stats, STATS_TOKENIZE, &mark);
+	}
+
+	if (s == NULL) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not tokenize `%s'", filepath);
+
+		return NULL;
+	}
+
+	return n2t_resolve_tokens(
+		s, nthreads > 1 ? filepath: NULL, opts, &mark, errmsg, maxwrite
+	);
+}
+
+tokenseq_t* n2t_parse_buffer(
+	char const *src, size_t len, parseopts_t const *opts, char errmsg[],
+	size_t maxwrite
+) {
+	asmstats_t *const stats = opts ? opts->stats: NULL;
+	statsmark_t mark;
 	tokenseq_t *s;
 
-	if ((s = n2t_tokenize(filepath)) == NULL)
+	n2t_stats_start(stats, &mark);
+	s = n2t_tokenize_buffer_in(src, len, opts ? opts->arena: NULL);
+	n2t_stats_lap(stats, STATS_TOKENIZE, &mark);
+
+	if (s == NULL) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not tokenize the source");
+
 		return NULL;
+	}
 
-	n2t_parse_rom_labels(s);
-	n2t_assign_rom_labels(s);
-	n2t_assign_ram_labels(s);
+	return n2t_resolve_tokens(s, NULL, opts, &mark, errmsg, maxwrite);
+}
 
-	return s;
+int n2t_parse_stream(
+	char const *filepath, parseopts_t const *opts, wordsink_t sink, void *arg,
+	char errmsg[], size_t maxwrite
+) {
+	asmstats_t *const stats = opts ? opts->stats: NULL;
+	statsmark_t mark;
+	linereader_t r;
+	strtable_t *labels;
+	symtable_t *symbols;
+	uint32_t ndefined = 0;
+	int error = 1;
+
+	n2t_stats_start(stats, &mark);
+
+	if (n2t_linereader_open(filepath, &r)) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not read `%s'", filepath);
+
+		return 1;
+	}
+
+	labels = n2t_strtable_alloc_in(BUFFSIZE_LARGE, opts ? opts->arena: NULL);
+	symbols = n2t_symtable_alloc_in(BUFFSIZE_LARGE, opts ? opts->arena: NULL);
+
+	if (labels == NULL || symbols == NULL) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not allocate symbols");
+	} else if (
+		!n2t_seed_ram_labels(labels, symbols, opts, errmsg, maxwrite)
+	) {
+		if (!n2t_stream_rom_labels(&r, labels, symbols, errmsg, maxwrite)) {
+			ndefined = symbols->ndefined;
+			n2t_stats_lap(stats, STATS_PARSE_ROM_LABELS, &mark);
+
+			if (n2t_linereader_rewind(&r)) {
+				if (errmsg) {
+					snprintf(
+						errmsg, maxwrite, "could not reread `%s'", filepath
+					);
+				}
+			} else {
+				error = n2t_stream_encode(
+					&r, labels, symbols, sink, arg, errmsg, maxwrite
+				);
+			}
+
+			n2t_stats_lap(stats, STATS_EMIT, &mark);
+		}
+	}
+
+	if (!error)
+		n2t_record_stats(stats, NULL, symbols, ndefined);
+
+	if (symbols)
+		n2t_symtable_free(symbols);
+	if (labels)
+		n2t_strtable_free(labels);
+
+	n2t_linereader_close(&r);
+
+	return error;
+}
+
+size_t n2t_parse_arena_hint(size_t len) {
+	// The token indices take about half of `len', while programs defining
+	// many symbols need twice as much again for their labels.
+	return PARSER_ARENA_BASE + 3 * len;
 }
 
-static int n2t_parse_rom_labels(tokenseq_t *s) {
+int n2t_seed_ram_labels(
+	strtable_t *labels, symtable_t *symbols, parseopts_t const *opts,
+	char errmsg[], size_t maxwrite
+) {
+	size_t const ndefaults = sizeof(DEFAULT_RAMVARS) / sizeof(ramvar_t);
+	size_t const npredefs = opts ? opts->npredefs: 0;
+	ramvar_t const *v;
+	int64_t label;
+	size_t i;
+	int error;
+
+	for (i = 0; i < npredefs + ndefaults; i++) {
+		v = i < npredefs ? opts->predefs + i: DEFAULT_RAMVARS + i - npredefs;
+		label = n2t_strtable_intern(labels, v->id, strlen(v->id));
+
+		if (label < 0) {
+			if (errmsg)
+				snprintf(errmsg, maxwrite, "invalid variable `%s'", v->id);
+
+			return 1;
+		}
+
+		error = n2t_symtable_define(symbols, label, v->address, RAM);
+
+		// Default variables are simply overridden by those in `opts'.
+		if (error == SYMTABLE_DUPLICATE && i >= npredefs)
+			continue;
+
+		if (error) {
+			if (errmsg && error == SYMTABLE_DUPLICATE) {
+				snprintf(
+					errmsg, maxwrite, "variable `%s' is predefined more than"
+					" once", v->id
+				);
+			}
+
+			return error;
+		}
+	}
+
+	return 0;
+}
+
+int n2t_parse_rom_labels(
+	tokenseq_t *s, symtable_t *symbols, char errmsg[], size_t maxwrite
+) {
 	size_t i, instrcounter = 0;
+	memloc_t const *l;
 	token_t *t;
 
 	if (s == NULL)
@@ -81,7 +332,27 @@ static int n2t_parse_rom_labels(tokenseq_t *s) {
 	for (i = 0; i < s->next; i++) {
 		t = n2t_tokenseq_index_get(s, i);
 
-		if (t->type == LABEL && !t->data.label.loaded) {
+		if (t->type == LABEL) {
+			l = n2t_symtable_lookup(symbols, t->data.label.label);
+
+			if (l && l->type == ROM) {
+				if (errmsg) {
+					snprintf(
+						errmsg, maxwrite, "label `%s' is defined more than"
+						" once", n2t_strtable_get(s->labels, t->data.label.label)
+					);
+				}
+
+				return SYMTABLE_DUPLICATE;
+			}
+
+			if (
+				n2t_symtable_set(
+					symbols, t->data.label.label, instrcounter, ROM
+				)
+			)
+				return 1;
+
 			t->data.label.location = instrcounter;
 			t->data.label.loaded = 1;
 		} else if (t->type == INSTR) {
@@ -89,13 +360,15 @@ static int n2t_parse_rom_labels(tokenseq_t *s) {
 		}
 	}
 
+	s->ninstrs = instrcounter;
+
 	return 0;
 }
 
-static int n2t_assign_rom_labels(tokenseq_t *s) {
+int n2t_assign_rom_labels(tokenseq_t *s, symtable_t const *symbols) {
 	size_t i;
 	token_t *t;
-	memloc_t *l;
+	memloc_t const *l;
 
 	if (s == NULL)
 		return 1;
@@ -108,9 +381,11 @@ static int n2t_assign_rom_labels(tokenseq_t *s) {
 			t->data.instr.type == A &&
 			t->data.instr.instr.a.memptr.loaded == 0
 		) {
-			l = n2t_tokenseq_find_rom_label(s, t->data.instr.instr.a.memptr);
+			l = n2t_symtable_lookup(
+				symbols, t->data.instr.instr.a.memptr.label
+			);
 
-			if (l) {
+			if (l && l->type == ROM) {
 				t->data.instr.instr.a.memptr.location = l->location;
 				t->data.instr.instr.a.memptr.type = ROM;
 				t->data.instr.instr.a.memptr.loaded = 1;
@@ -121,9 +396,10 @@ static int n2t_assign_rom_labels(tokenseq_t *s) {
 	return 0;
 }
 
-static int n2t_assign_ram_labels(tokenseq_t *const s) {
+int n2t_assign_ram_labels(tokenseq_t *const s, symtable_t *symbols) {
 	size_t i, labelcounter = 16;
-	int64_t default_ramvar;
+	memloc_t const *l;
+	memloc_t *m;
 	token_t *t;
 
 	if (s == NULL)
@@ -131,44 +407,490 @@ static int n2t_assign_ram_labels(tokenseq_t *const s) {
 
 	for (i = 0; i < s->next; i++) {
 		t = n2t_tokenseq_index_get(s, i);
+		m = &t->data.instr.instr.a.memptr;
 
 		if (
 			t->type == INSTR && t->data.instr.type == A &&
-			!t->data.instr.instr.a.memptr.loaded &&
-			t->data.instr.instr.a.memptr.type != ROM
+			!m->loaded && m->type != ROM
 		) {
-			default_ramvar = n2t_varname_to_address(
-				DEFAULT_RAMVARS, sizeof(DEFAULT_RAMVARS) / sizeof(ramvar_t),
-				t->data.instr.instr.a.memptr.label
-			);
+			if ((l = n2t_symtable_lookup(symbols, m->label))) {
+				m->location = l->location;
+			} else {
+				if (n2t_symtable_define(symbols, m->label, labelcounter, RAM))
+					return 1;
+
+				m->location = labelcounter;
+				labelcounter++;
+			}
+
+			m->type = RAM;
+			m->loaded = 1;
+		}
+	}
+
+	return 0;
+}
+
+
+static tokenseq_t* n2t_resolve_tokens(
+	tokenseq_t *s, char const *filepath, parseopts_t const *opts,
+	statsmark_t *mark, char errmsg[], size_t maxwrite
+) {
+	unsigned const nthreads = opts ? opts->nthreads: 1;
+	asmstats_t *const stats = opts ? opts->stats: NULL;
+	uint32_t ndefined;
+	symtable_t *symbols;
+
+	symbols = n2t_symtable_alloc_in(n2t_strtable_length(s->labels), s->arena);
+
+	if (symbols == NULL) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not allocate symbols");
+
+		n2t_tokenseq_free(s);
+
+		return NULL;
+	}
+
+	if (n2t_seed_ram_labels(s->labels, symbols, opts, errmsg, maxwrite)) {
+		n2t_symtable_free(symbols);
+		n2t_tokenseq_free(s);
+
+		return NULL;
+	}
+
+	if (
+		filepath ?
+			n2t_tokenize_parallel(
+				filepath, nthreads, s, symbols, errmsg, maxwrite
+			):
+			n2t_parse_rom_labels(s, symbols, errmsg, maxwrite)
+	) {
+		n2t_symtable_free(symbols);
+		n2t_tokenseq_free(s);
+
+		return NULL;
+	}
+
+	ndefined = symbols->ndefined;
+	n2t_stats_lap(
+		stats, filepath ? STATS_TOKENIZE: STATS_PARSE_ROM_LABELS, mark
+	);
+	n2t_assign_rom_labels(s, symbols);
+	n2t_stats_lap(stats, STATS_ASSIGN_ROM_LABELS, mark);
+	n2t_assign_ram_labels(s, symbols);
+	n2t_stats_lap(stats, STATS_ASSIGN_RAM_LABELS, mark);
+
+	n2t_record_stats(stats, s, symbols, ndefined);
+	n2t_symtable_free(symbols);
+
+	return s;
+}
 
-			if (default_ramvar >= 0) {
-				t->data.instr.instr.a.memptr.location = default_ramvar;
+static int n2t_stream_rom_labels(
+	linereader_t *r, strtable_t *labels, symtable_t *symbols, char errmsg[],
+	size_t maxwrite
+) {
+	size_t lineno = 0, instrcounter = 0;
+	memloc_t const *l;
+	token_t t;
+	int status;
+
+	while (
+		(status = n2t_stream_next_token(
+			r, labels, &t, &lineno, errmsg, maxwrite
+		)) > 0
+	) {
+		if (t.type == INSTR) {
+			instrcounter++;
+			continue;
+		}
+
+		l = n2t_symtable_lookup(symbols, t.data.label.label);
+
+		if (l && l->type == ROM) {
+			if (errmsg) {
+				snprintf(
+					errmsg, maxwrite, "label `%s' is defined more than once",
+					n2t_strtable_get(labels, t.data.label.label)
+				);
+			}
+
+			return SYMTABLE_DUPLICATE;
+		}
+
+		if (n2t_symtable_set(symbols, t.data.label.label, instrcounter, ROM))
+			return 1;
+	}
+
+	return status < 0;
+}
+
+static int n2t_stream_encode(
+	linereader_t *r, strtable_t *labels, symtable_t *symbols, wordsink_t sink,
+	void *arg, char errmsg[], size_t maxwrite
+) {
+	word_t words[PARSER_STREAM_BATCH];
+	size_t lineno = 0, n = 0, labelcounter = 16;
+	memloc_t const *l;
+	memloc_t *m;
+	token_t t;
+	int status;
+
+	while (
+		(status = n2t_stream_next_token(
+			r, labels, &t, &lineno, errmsg, maxwrite
+		)) > 0
+	) {
+		if (t.type != INSTR)
+			continue;
+
+		m = &t.data.instr.instr.a.memptr;
+
+		if (t.data.instr.type == A && !m->loaded) {
+			if ((l = n2t_symtable_lookup(symbols, m->label))) {
+				m->location = l->location;
 			} else {
-				t->data.instr.instr.a.memptr.location = labelcounter;
+				if (n2t_symtable_define(symbols, m->label, labelcounter, RAM))
+					return 1;
+
+				m->location = labelcounter;
 				labelcounter++;
 			}
 
-			t->data.instr.instr.a.memptr.type = RAM;
-			t->data.instr.instr.a.memptr.loaded = 1;
+			m->loaded = 1;
+		}
+
+		words[n++] = n2t_instr_bits(t.data.instr);
+
+		if (n == PARSER_STREAM_BATCH) {
+			if (sink(words, n, arg)) {
+				if (errmsg)
+					snprintf(errmsg, maxwrite, "could not emit instructions");
+
+				return 1;
+			}
+
+			n = 0;
 		}
 	}
 
+	if (status < 0 || (n > 0 && sink(words, n, arg))) {
+		if (errmsg && status >= 0)
+			snprintf(errmsg, maxwrite, "could not emit instructions");
+
+		return 1;
+	}
+
 	return 0;
 }
 
-static int64_t n2t_varname_to_address(
-	ramvar_t const *a, size_t const n, char const *varname
+static int n2t_stream_next_token(
+	linereader_t *r, strtable_t *labels, token_t *dest, size_t *lineno,
+	char errmsg[], size_t maxwrite
+) {
+	char const *line;
+	size_t len;
+	int status;
+
+	while ((status = n2t_linereader_next(r, &line, &len)) > 0) {
+		(*lineno)++;
+
+		switch (n2t_scan_line(line, len, labels, dest)) {
+			case 0:
+				return 1;
+			case SCAN_BLANK:
+				continue;
+			default:
+				if (errmsg) {
+					snprintf(
+						errmsg, maxwrite, "line %lu is not valid: `%.*s'",
+						*lineno, (int) MIN(len, BUFFSIZE_MED), line
+					);
+				}
+
+				return -1;
+		}
+	}
+
+	if (status < 0 && errmsg)
+		snprintf(errmsg, maxwrite, "could not read line %lu", *lineno + 1);
+
+	return status;
+}
+
+static int n2t_tokenize_parallel(
+	char const *filepath, unsigned nthreads, tokenseq_t *s,
+	symtable_t *symbols, char errmsg[], size_t maxwrite
 ) {
+	parsechunk_t *chunks;
+	pthread_t *threads;
+	filemap_t map;
+	char const *begin, *end, *newline;
+	size_t ntokens = 0, instroffset = 0, i;
+	int error = 0;
+
+	if (n2t_filemap_open(filepath, &map)) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not read `%s'", filepath);
+
+		return 1;
+	}
+
+	nthreads = MIN(MAX(nthreads, 1), PARSER_MAX_THREADS);
+	chunks = calloc(nthreads, sizeof(parsechunk_t));
+	threads = calloc(nthreads, sizeof(pthread_t));
+
+	if (chunks == NULL || threads == NULL) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not allocate chunks");
+
+		free(chunks);
+		free(threads);
+		n2t_filemap_close(&map);
+
+		return 1;
+	}
+
+	// Chunks are about as large, but always end right after a newline.
+	for (i = 0, begin = map.data; i < nthreads; i++, begin = end) {
+		end = map.data + map.length;
+
+		if (i + 1 < nthreads && begin < end) {
+			end = MAX(begin, map.data + map.length * (i + 1) / nthreads);
+			newline = memchr(end, '\n', map.data + map.length - end);
+			end = newline ? newline + 1: map.data + map.length;
+		}
+
+		chunks[i].src = begin;
+		chunks[i].len = end - begin;
+
+		// Should the thread not start, the chunk is tokenized by this one.
+		if (pthread_create(threads + i, NULL, n2t_tokenize_chunk, chunks + i))
+			threads[i] = pthread_self();
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_equal(threads[i], pthread_self())) {
+			n2t_tokenize_chunk(chunks + i);
+		} else {
+			pthread_join(threads[i], NULL);
+		}
+
+		if (chunks[i].seq == NULL)
+			error = 1;
+
+		ntokens += chunks[i].seq ? chunks[i].seq->next: 0;
+	}
+
+	if (error && errmsg) {
+		snprintf(errmsg, maxwrite, "could not tokenize `%s'", filepath);
+	} else if (!error && ntokens > s->ntokens) {
+		if (n2t_tokenseq_extend(s, ntokens - s->ntokens) == NULL)
+			error = 1;
+	}
+
+	// Chunks are merged in order: the ROM address of a label is its offset
+	// within its chunk, plus the instruction count of all chunks before it.
+	for (i = 0; i < nthreads && !error; i++) {
+		error = n2t_merge_chunk(
+			s, symbols, chunks + i, instroffset, errmsg, maxwrite
+		);
+		instroffset += chunks[i].ninstrs;
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		if (chunks[i].seq)
+			n2t_tokenseq_free(chunks[i].seq);
+
+		free(chunks[i].labels);
+	}
+
+	free(chunks);
+	free(threads);
+	n2t_filemap_close(&map);
+
+	return error;
+}
+
+static void* n2t_tokenize_chunk(void *chunk) {
+	parsechunk_t *const c = chunk;
+	memloc_t *updated_labels;
+	token_t const *t;
 	size_t i;
 
-	if (a == NULL)
-		return -1;
+	if ((c->seq = n2t_tokenize_buffer(c->src, c->len)) == NULL)
+		return NULL;
+
+	for (i = 0; i < c->seq->next; i++) {
+		t = n2t_tokenseq_index_get(c->seq, i);
+
+		if (t->type == INSTR) {
+			c->ninstrs++;
+			continue;
+		}
+
+		if (c->nlabels == c->capacity) {
+			c->capacity = c->capacity ? 2 * c->capacity: BUFFSIZE_SMALL;
+			updated_labels = realloc(c->labels, c->capacity * sizeof(memloc_t));
+
+			if (updated_labels == NULL) {
+				n2t_tokenseq_free(c->seq);
+				c->seq = NULL;
+
+				return NULL;
+			}
+
+			c->labels = updated_labels;
+		}
+
+		c->labels[c->nlabels] = t->data.label;
+		c->labels[c->nlabels].location = c->ninstrs;
+		c->nlabels++;
+	}
+
+	return c;
+}
+
+static int n2t_merge_chunk(
+	tokenseq_t *s, symtable_t *symbols, parsechunk_t const *c,
+	size_t instroffset, char errmsg[], size_t maxwrite
+) {
+	size_t const nids = n2t_strtable_length(c->seq->labels);
+	size_t const nunique = c->seq->tokens_multiton->next;
+	uint32_t *ids, *unique;
+	memloc_t const *l;
+	memloc_t *m;
+	char const *name;
+	token_t t;
+	int64_t index;
+	size_t i;
+
+	ids = malloc((nids + 1) * sizeof(uint32_t));
+	unique = malloc((nunique + 1) * sizeof(uint32_t));
+
+	if (ids == NULL || unique == NULL) {
+		free(ids);
+		free(unique);
+
+		return 1;
+	}
+
+	// Label identifiers of the chunk to those of `s'.
+	for (i = 0; i < nids; i++) {
+		name = n2t_strtable_get(c->seq->labels, i);
+
+		if ((index = n2t_strtable_intern(s->labels, name, strlen(name))) < 0) {
+			free(ids);
+			free(unique);
+
+			return 1;
+		}
+
+		ids[i] = index;
+	}
+
+	for (i = 0; i < c->nlabels; i++) {
+		l = n2t_symtable_lookup(symbols, ids[c->labels[i].label]);
+
+		if (l && l->type == ROM) {
+			if (errmsg) {
+				snprintf(
+					errmsg, maxwrite, "label `%s' is defined more than once",
+					n2t_strtable_get(s->labels, ids[c->labels[i].label])
+				);
+			}
+
+			free(ids);
+			free(unique);
+
+			return SYMTABLE_DUPLICATE;
+		}
+
+		if (
+			n2t_symtable_set(
+				symbols, ids[c->labels[i].label],
+				instroffset + c->labels[i].location, ROM
+			)
+		) {
+			free(ids);
+			free(unique);
+
+			return 1;
+		}
+	}
+
+	// Each distinct token of the chunk is translated and interned only once.
+	for (i = 0; i < nunique; i++) {
+		t = *(token_t*) n2t_memcache_index_fetch(c->seq->tokens_multiton, i);
+
+		if (t.type == LABEL) {
+			t.data.label.label = ids[t.data.label.label];
+			t.data.label.location = n2t_symtable_lookup(
+				symbols, t.data.label.label
+			)->location;
+			t.data.label.loaded = 1;
+		} else {
+			m = &t.data.instr.instr.a.memptr;
+
+			if (t.data.instr.type == A && !m->loaded)
+				m->label = ids[m->label];
+		}
 
-	for (i = 0; i < n; i++) {
-		if (!strncmp(a[i].id, varname, BUFFSIZE_MED))
-			return a[i].address;
+		if ((index = n2t_tokenseq_intern_token(s, t)) < 0) {
+			free(ids);
+			free(unique);
+
+			return 1;
+		}
+
+		unique[i] = index;
 	}
 
-	return -1;
+	for (i = 0; i < c->seq->next; i++)
+		s->tokens[s->next + i] = unique[c->seq->tokens[i]];
+
+	s->next += c->seq->next;
+	s->ninstrs += c->ninstrs;
+	s->nlines += c->seq->nlines;
+
+	free(ids);
+	free(unique);
+
+	return 0;
+}
+
+static void n2t_record_stats(
+	asmstats_t *stats, tokenseq_t const *s, symtable_t const *symbols,
+	uint32_t ndefined
+) {
+#ifndef N2T_NO_STATS
+	memcache_t const *caches[2];
+	size_t i;
+
+	if (stats == NULL)
+		return;
+
+	// Labels shadowing predefined variables define no new entry.
+	stats->nlabels = symbols->nrom;
+	stats->nvariables = symbols->ndefined - ndefined;
+
+	if (s == NULL)
+		return;
+
+	stats->nlines = s->nlines;
+	stats->ntokens = s->next;
+	stats->nunique = s->tokens_multiton->next;
+
+	// Caches only grow by appending chunks past their first one.
+	caches[0] = s->tokens_multiton;
+	caches[1] = s->labels->strings;
+	stats->ngrows = stats->grow_bytes = 0;
+
+	for (i = 0; i < 2; i++) {
+		stats->ngrows += caches[i]->nchunks - 1;
+		stats->grow_bytes += (size_t) (caches[i]->length - caches[i]->first) *
+			caches[i]->unitsize;
+	}
+#endif
 }
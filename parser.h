@@ -23,6 +23,8 @@
 #define PARSER_H
 
 #include "lexer.h"
+#include "symtable.h"
+#include "stats.h"
 
 
 #define RAMVAR_R0	0
@@ -50,14 +52,145 @@
 #define RAMVAR_THIS		3
 #define RAMVAR_THAT		4
 
+/**
+ * A predefined RAM variable, such as `SP' or `R13'.
+ */
+typedef struct {
+	char const *id;
+	uint16_t address;
+} ramvar_t;
+
+/**
+ * Options tuning the behaviour of `n2t_parse_with()'. A zeroed-out
+ * `parseopts_t' yields the same results as `n2t_parse()'.
+ */
+typedef struct {
+	// Additional predefined RAM variables, taking precedence over the default
+	// ones (`R0', ..., `SP', ...).
+	ramvar_t const *predefs;
+	size_t npredefs;
+	// Number of threads tokenizing the input, each one a separate chunk of
+	// lines. `0' and `1' both mean no additional threads, while values above
+	// `PARSER_MAX_THREADS' are lowered to it.
+	unsigned nthreads;
+	// If not `NULL', the arena the tokens, labels and symbols of the assembly
+	// are allocated from: the caller releases them at once by resetting it,
+	// `n2t_tokenseq_free()' being then a no-op. See `n2t_parse_arena_hint()'.
+	arena_t *arena;
+	// If not `NULL', receives the statistics of the assembly. Having stored
+	// no tokens, `n2t_parse_stream()' only records labels, variables and its
+	// two passes, the second one as emission.
+	asmstats_t *stats;
+} parseopts_t;
+
+// Largest number of threads an assembly is shared out among. Each one
+// takes a chunk and a thread handle, allocated up front.
+#define	PARSER_MAX_THREADS 256
+
+// Bytes of arena an assembly takes whatever the length of its input.
+#define	PARSER_ARENA_BASE (64 * 1024)
+
+// Number of machine words handed at once to a `wordsink_t' by
+// `n2t_parse_stream()'.
+#define	PARSER_STREAM_BATCH 4096
+
+/**
+ * Receives the `n' machine words at `words', the next ones of a program being
+ * assembled, along with the argument given to `n2t_parse_stream()'.
+ *
+ * Returns: `1' if an error occurs, which stops the assembly, `0' otherwise.
+ */
+typedef int (*wordsink_t)(word_t const *words, size_t n, void *arg);
+
 /**
  * Parses the contents in `filepath' to produce a fully filled-out sequence
- * of tokens.
+ * of tokens. Defining the same label twice is an error.
  *
+ * Param `errmsg': if not `NULL', receives a description of the error that
+ * occurred, if any, of at most `maxwrite' bytes.
  * Returns: a list of tokens encoding the information of an `.asm' file, or
  * `NULL' if an error occurs.
  */
-tokenseq_t* n2t_parse(char const *filepath);
+tokenseq_t* n2t_parse(char const *filepath, char errmsg[], size_t maxwrite);
+/**
+ * Same as `n2t_parse()', according to `opts'. `opts' may be `NULL'.
+ *
+ * With more than one thread, chunks of lines are tokenized concurrently and
+ * their ROM labels located by summing the instruction counts of the preceding
+ * chunks. The resulting tokens are the same as those of the serial path.
+ */
+tokenseq_t* n2t_parse_with(
+	char const *filepath, parseopts_t const *opts, char errmsg[],
+	size_t maxwrite
+);
+/**
+ * Same as `n2t_parse_with()', for the program held by the `len' bytes at
+ * `src' rather than by a file. The input is always tokenized serially.
+ */
+tokenseq_t* n2t_parse_buffer(
+	char const *src, size_t len, parseopts_t const *opts, char errmsg[],
+	size_t maxwrite
+);
+/**
+ * Assembles `filepath' in two passes with bounded memory: the first one only
+ * records the addresses of ROM labels, the second one reads the file again and
+ * hands the encoded instructions to `sink' as they are resolved. Tokens are
+ * never stored, so memory use depends on the number of distinct symbols and
+ * not on the length of the program. Results match those of
+ * `n2t_parse_with()'.
+ *
+ * Param `errmsg': same as for `n2t_parse()'.
+ * Returns: `1' if an error occurs, `0' otherwise. `sink' might have received
+ * part of the program before an error is detected.
+ */
+int n2t_parse_stream(
+	char const *filepath, parseopts_t const *opts, wordsink_t sink, void *arg,
+	char errmsg[], size_t maxwrite
+);
+/**
+ * Estimates the bytes of arena an assembly allocates for an input `len' bytes
+ * long, so that an arena created with this capacity seldom needs another
+ * block.
+ *
+ * Returns: the estimate.
+ */
+size_t n2t_parse_arena_hint(size_t len);
+/**
+ * Defines into `symbols' the predefined RAM variables: those in `opts', if
+ * any, and then the default ones not overridden by `opts'. Their names are
+ * interned into `labels'.
+ *
+ * Returns: `0' if no errors occur, `SYMTABLE_DUPLICATE' if `opts' predefines
+ * the same variable twice, `1' otherwise. On error, a description of it is
+ * written to `errmsg', if not `NULL'.
+ */
+int n2t_seed_ram_labels(
+	strtable_t *labels, symtable_t *symbols, parseopts_t const *opts,
+	char errmsg[], size_t maxwrite
+);
+/**
+ * Assigns ROM addresses to the labels of `s', defining them in `symbols', and
+ * counts its instructions into `s->ninstrs'. A label shadows a predefined RAM
+ * variable of the same name.
+ *
+ * Returns: `0' if no errors occur, `SYMTABLE_DUPLICATE' if a label is defined
+ * more than once, `1' otherwise. On error, a description of it is written to
+ * `errmsg', if not `NULL'.
+ */
+int n2t_parse_rom_labels(
+	tokenseq_t *const s, symtable_t *symbols, char errmsg[], size_t maxwrite
+);
+/**
+ * Resolves the A-instructions of `s' referring to labels defined in
+ * `symbols'.
+ */
+int n2t_assign_rom_labels(tokenseq_t *s, symtable_t const *symbols);
+/**
+ * Resolves the remaining A-instructions of `s' to RAM variables: predefined
+ * ones are looked up in `symbols', while the other ones are allocated from
+ * address 16 onwards in order of first appearance, and defined in `symbols'.
+ */
+int n2t_assign_ram_labels(tokenseq_t *const s, symtable_t *symbols);
 
 
 #endif
@@ -0,0 +1,283 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include <unistd.h>
+#include "pool.h"
+
+
+/**
+ * Thread routine of every worker of a pool. `worker' points to a
+ * `poolworker_t'.
+ */
+static void* n2t_pool_work(void *worker);
+/**
+ * Takes a task from the front of `q' if `front' is non-zero, from its back
+ * otherwise.
+ *
+ * Returns: `1' if a task was stored into `dest', `0' if `q' is empty.
+ */
+static int n2t_poolqueue_take(poolqueue_t *q, int front, pooltask_t *dest);
+/**
+ * Appends `t' to the back of `q', doubling its capacity when full.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_poolqueue_push(poolqueue_t *q, pooltask_t t);
+/**
+ * Wakes up and joins the first `nstarted' workers of `p', then releases every
+ * resource of `p'.
+ */
+static void n2t_pool_stop(pool_t *p, unsigned nstarted);
+
+/**
+ * What a worker thread needs to know about itself.
+ */
+typedef struct {
+	pool_t *pool;
+	unsigned index;
+} poolworker_t;
+
+
+pool_t* n2t_pool_alloc(unsigned nworkers) {
+	pool_t *p;
+	poolworker_t *self;
+	long online;
+	unsigned i;
+
+	if (nworkers == 0) {
+		online = sysconf(_SC_NPROCESSORS_ONLN);
+		nworkers = online > 0 ? online: 1;
+	}
+
+	if ((p = calloc(1, sizeof(pool_t))) == NULL)
+		return NULL;
+
+	p->workers = calloc(nworkers, sizeof(pthread_t));
+	p->queues = calloc(nworkers, sizeof(poolqueue_t));
+
+	if (p->workers == NULL || p->queues == NULL) {
+		free(p->workers);
+		free(p->queues);
+		free(p);
+
+		return NULL;
+	}
+
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->wakeup, NULL);
+	pthread_cond_init(&p->idle, NULL);
+
+	for (i = 0; i < nworkers; i++)
+		pthread_mutex_init(&p->queues[i].lock, NULL);
+
+	// Workers only learn about each other through `nworkers', which must be
+	// final before any of them starts.
+	p->nworkers = nworkers;
+
+	for (i = 0; i < nworkers; i++) {
+		if ((self = malloc(sizeof(poolworker_t))) != NULL) {
+			self->pool = p;
+			self->index = i;
+		}
+
+		if (
+			self == NULL ||
+			pthread_create(p->workers + i, NULL, n2t_pool_work, self)
+		) {
+			free(self);
+			n2t_pool_stop(p, i);
+
+			return NULL;
+		}
+	}
+
+	return p;
+}
+
+int n2t_pool_submit(pool_t *p, void (*run)(void*), void *arg) {
+	pooltask_t const t = {run, arg};
+	unsigned queue;
+
+	// Counters go up before the task is visible, so that they never fall
+	// below the number of tasks actually queued.
+	pthread_mutex_lock(&p->lock);
+	queue = p->nextqueue;
+	p->nextqueue = (p->nextqueue + 1) % p->nworkers;
+	p->queued++;
+	p->pending++;
+	pthread_mutex_unlock(&p->lock);
+
+	if (n2t_poolqueue_push(p->queues + queue, t)) {
+		pthread_mutex_lock(&p->lock);
+		p->queued--;
+
+		if (--p->pending == 0)
+			pthread_cond_broadcast(&p->idle);
+
+		pthread_mutex_unlock(&p->lock);
+
+		return 1;
+	}
+
+	pthread_mutex_lock(&p->lock);
+	pthread_cond_signal(&p->wakeup);
+	pthread_mutex_unlock(&p->lock);
+
+	return 0;
+}
+
+void n2t_pool_wait(pool_t *p) {
+	pthread_mutex_lock(&p->lock);
+
+	while (p->pending > 0)
+		pthread_cond_wait(&p->idle, &p->lock);
+
+	pthread_mutex_unlock(&p->lock);
+}
+
+void n2t_pool_free(pool_t *p) {
+	n2t_pool_wait(p);
+	n2t_pool_stop(p, p->nworkers);
+}
+
+
+static void* n2t_pool_work(void *worker) {
+	pool_t *const p = ((poolworker_t*) worker)->pool;
+	unsigned const index = ((poolworker_t*) worker)->index;
+	pooltask_t t;
+	unsigned i;
+	int found;
+
+	free(worker);
+
+	while (1) {
+		// Own tasks go first, then those of the following workers.
+		for (i = 0, found = 0; i < p->nworkers && !found; i++) {
+			found = n2t_poolqueue_take(
+				p->queues + (index + i) % p->nworkers, i == 0, &t
+			);
+		}
+
+		pthread_mutex_lock(&p->lock);
+
+		if (found) {
+			p->queued--;
+			pthread_mutex_unlock(&p->lock);
+
+			t.run(t.arg);
+
+			pthread_mutex_lock(&p->lock);
+
+			if (--p->pending == 0)
+				pthread_cond_broadcast(&p->idle);
+		} else {
+			while (p->queued == 0 && !p->stopping)
+				pthread_cond_wait(&p->wakeup, &p->lock);
+
+			if (p->queued == 0 && p->stopping) {
+				pthread_mutex_unlock(&p->lock);
+				break;
+			}
+		}
+
+		pthread_mutex_unlock(&p->lock);
+	}
+
+	return NULL;
+}
+
+static int n2t_poolqueue_take(poolqueue_t *q, int front, pooltask_t *dest) {
+	int found = 0;
+
+	pthread_mutex_lock(&q->lock);
+
+	if (q->length > 0) {
+		if (front) {
+			*dest = q->tasks[q->head];
+			q->head = (q->head + 1) % q->capacity;
+		} else {
+			*dest = q->tasks[(q->head + q->length - 1) % q->capacity];
+		}
+
+		q->length--;
+		found = 1;
+	}
+
+	pthread_mutex_unlock(&q->lock);
+
+	return found;
+}
+
+static int n2t_poolqueue_push(poolqueue_t *q, pooltask_t t) {
+	pooltask_t *updated_tasks;
+	size_t capacity, i;
+
+	pthread_mutex_lock(&q->lock);
+
+	if (q->length == q->capacity) {
+		capacity = q->capacity ? 2 * q->capacity: POOL_QUEUE_SIZE;
+
+		if ((updated_tasks = malloc(capacity * sizeof(pooltask_t))) == NULL) {
+			pthread_mutex_unlock(&q->lock);
+			return 1;
+		}
+
+		// The ring is unrolled from `head' onwards.
+		for (i = 0; i < q->length; i++)
+			updated_tasks[i] = q->tasks[(q->head + i) % q->capacity];
+
+		free(q->tasks);
+		q->tasks = updated_tasks;
+		q->head = 0;
+		q->capacity = capacity;
+	}
+
+	q->tasks[(q->head + q->length) % q->capacity] = t;
+	q->length++;
+
+	pthread_mutex_unlock(&q->lock);
+
+	return 0;
+}
+
+static void n2t_pool_stop(pool_t *p, unsigned nstarted) {
+	unsigned i;
+
+	pthread_mutex_lock(&p->lock);
+	p->stopping = 1;
+	pthread_cond_broadcast(&p->wakeup);
+	pthread_mutex_unlock(&p->lock);
+
+	for (i = 0; i < nstarted; i++)
+		pthread_join(p->workers[i], NULL);
+
+	for (i = 0; i < p->nworkers; i++) {
+		pthread_mutex_destroy(&p->queues[i].lock);
+		free(p->queues[i].tasks);
+	}
+
+	pthread_mutex_destroy(&p->lock);
+	pthread_cond_destroy(&p->wakeup);
+	pthread_cond_destroy(&p->idle);
+	free(p->workers);
+	free(p->queues);
+	free(p);
+}
@@ -0,0 +1,98 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+
+// Initial number of tasks each worker queue can hold before growing.
+#define	POOL_QUEUE_SIZE 16
+
+/**
+ * A task for a `pool_t': `run(arg)' is called by one of its workers.
+ */
+typedef struct {
+	void (*run)(void *arg);
+	void *arg;
+} pooltask_t;
+
+/**
+ * The queue of tasks of a single worker: a growable ring buffer of `capacity'
+ * tasks, holding `length' ones starting from `head'. The owner takes tasks
+ * from the front, while other workers steal them from the back.
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	pooltask_t *tasks;
+	size_t head, length, capacity;
+} poolqueue_t;
+
+/**
+ * A `pool_t' is a fixed set of worker threads, each one with its own queue of
+ * tasks. Submitted tasks are dealt to the queues in turn; a worker running out
+ * of tasks steals from the queues of the others before going to sleep, so
+ * that workers stay busy as long as any task is queued.
+ *
+ * `queued' counts the tasks waiting in any queue, `pending' those submitted
+ * and not completed yet. Both are protected by `lock'.
+ */
+typedef struct {
+	pthread_t *workers;
+	poolqueue_t *queues;
+	unsigned nworkers, nextqueue;
+
+	pthread_mutex_t lock;
+	pthread_cond_t wakeup, idle;
+	size_t queued, pending;
+	uint8_t stopping;
+} pool_t;
+
+
+/**
+ * Starts a pool of `nworkers' threads, or of as many threads as online
+ * processors if `nworkers' is `0'.
+ *
+ * Returns: the pool, or `NULL' if an error occurs.
+ */
+pool_t* n2t_pool_alloc(unsigned nworkers);
+/**
+ * Queues `run(arg)' for execution. Tasks submitted in a row start roughly in
+ * submission order, so submitting the longest ones first shortens the time
+ * needed to complete all of them.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+int n2t_pool_submit(pool_t *p, void (*run)(void*), void *arg);
+/**
+ * Waits until every task submitted to `p' is completed.
+ */
+void n2t_pool_wait(pool_t *p);
+/**
+ * Waits for the tasks of `p' to complete, then stops its workers and frees it.
+ */
+void n2t_pool_free(pool_t *p);
+
+
+#endif
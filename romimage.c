@@ -0,0 +1,228 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include <string.h>
+#include "romimage.h"
+
+
+/**
+ * Stores the lowest `bytes' bytes of `value' at `dest' in `endian' order.
+ */
+static void n2t_romimage_put(
+	uint8_t *dest, uint32_t value, size_t bytes, romendian_t endian
+);
+/**
+ * Returns: the `bytes' bytes integer stored at `src' in `endian' order.
+ */
+static uint32_t n2t_romimage_get(
+	uint8_t const *src, size_t bytes, romendian_t endian
+);
+/**
+ * Carries on the Fletcher-32 checksum `checksum' over the `n' words of `src',
+ * reading word `i' as `get(src, i)'.
+ */
+static uint32_t n2t_romimage_fletcher(
+	uint32_t checksum, word_t (*get)(void const*, size_t), void const *src,
+	size_t n
+);
+static word_t n2t_romimage_array_word(void const *words, size_t i);
+static word_t n2t_romimage_image_word(void const *r, size_t i);
+
+
+size_t n2t_romimage_size(size_t n, int header) {
+	return (header ? ROMIMAGE_HEADER_SIZE: 0) + 2 * n;
+}
+
+size_t n2t_romimage_write(
+	word_t const *words, size_t n, romendian_t endian, int header,
+	uint8_t *dest
+) {
+	uint8_t *p = dest;
+	size_t i;
+
+	if (header) {
+		p += n2t_romimage_write_header(
+			n, n2t_romimage_checksum(words, n), endian, p
+		);
+	}
+
+	for (i = 0; i < n; i++, p += 2)
+		n2t_romimage_put(p, words[i], 2, endian);
+
+	return p - dest;
+}
+
+size_t n2t_romimage_write_header(
+	size_t n, uint32_t checksum, romendian_t endian, uint8_t *dest
+) {
+	memcpy(dest, ROMIMAGE_MAGIC, 4);
+	dest[4] = ROMIMAGE_VERSION;
+	dest[5] = endian == ROMIMAGE_BIG ? ROMIMAGE_FLAG_BIG: 0;
+	dest[6] = dest[7] = 0;
+	n2t_romimage_put(dest + 8, n, 4, endian);
+	n2t_romimage_put(dest + 12, checksum, 4, endian);
+
+	return ROMIMAGE_HEADER_SIZE;
+}
+
+uint32_t n2t_romimage_checksum(word_t const *words, size_t n) {
+	return n2t_romimage_checksum_update(ROMIMAGE_CHECKSUM_INIT, words, n);
+}
+
+uint32_t n2t_romimage_checksum_bytes(
+	uint8_t const *words, size_t n, romendian_t endian
+) {
+	romimage_t const view = {{NULL, 0, 0}, words, n, endian};
+
+	return n2t_romimage_fletcher(
+		ROMIMAGE_CHECKSUM_INIT, n2t_romimage_image_word, &view, n
+	);
+}
+
+uint32_t n2t_romimage_checksum_update(
+	uint32_t checksum, word_t const *words, size_t n
+) {
+	return n2t_romimage_fletcher(
+		checksum, n2t_romimage_array_word, words, n
+	);
+}
+
+int n2t_romimage_open(
+	char const *filepath, romendian_t endian, int header, romimage_t *dest
+) {
+	uint8_t const *data;
+	size_t length;
+
+	if (n2t_filemap_open(filepath, &dest->map))
+		return 1;
+
+	data = (uint8_t const*) dest->map.data;
+	length = dest->map.length;
+	dest->endian = endian;
+
+	if (header) {
+		if (
+			length < ROMIMAGE_HEADER_SIZE ||
+			memcmp(data, ROMIMAGE_MAGIC, 4) || data[4] != ROMIMAGE_VERSION
+		) {
+			n2t_filemap_close(&dest->map);
+			return 1;
+		}
+
+		dest->endian = data[5] & ROMIMAGE_FLAG_BIG ?
+			ROMIMAGE_BIG: ROMIMAGE_LITTLE;
+		data += ROMIMAGE_HEADER_SIZE;
+		length -= ROMIMAGE_HEADER_SIZE;
+	}
+
+	if (length % 2 || length / 2 > UINT32_MAX) {
+		n2t_filemap_close(&dest->map);
+		return 1;
+	}
+
+	dest->words = data;
+	dest->nwords = length / 2;
+
+	if (header) {
+		if (
+			n2t_romimage_get(data - 8, 4, dest->endian) != dest->nwords ||
+			n2t_romimage_get(data - 4, 4, dest->endian) != n2t_romimage_checksum_bytes(
+				dest->words, dest->nwords, dest->endian
+			)
+		) {
+			n2t_romimage_close(dest);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void n2t_romimage_close(romimage_t *r) {
+	n2t_filemap_close(&r->map);
+	r->words = NULL;
+	r->nwords = 0;
+}
+
+
+static void n2t_romimage_put(
+	uint8_t *dest, uint32_t value, size_t bytes, romendian_t endian
+) {
+	size_t i;
+
+	for (i = 0; i < bytes; i++) {
+		if (endian == ROMIMAGE_BIG)
+			dest[bytes - 1 - i] = value >> (8 * i);
+		else
+			dest[i] = value >> (8 * i);
+	}
+}
+
+static uint32_t n2t_romimage_get(
+	uint8_t const *src, size_t bytes, romendian_t endian
+) {
+	uint32_t value = 0;
+	size_t i;
+
+	for (i = 0; i < bytes; i++) {
+		if (endian == ROMIMAGE_BIG)
+			value = (value << 8) | src[i];
+		else
+			value |= (uint32_t) src[i] << (8 * i);
+	}
+
+	return value;
+}
+
+static uint32_t n2t_romimage_fletcher(
+	uint32_t checksum, word_t (*get)(void const*, size_t), void const *src,
+	size_t n
+) {
+	// Both sums are kept reduced to 16 bits between calls, hence `checksum'
+	// holds the whole state of the computation.
+	uint32_t sum1 = checksum & 0xFFFF, sum2 = checksum >> 16;
+	size_t i = 0, block;
+
+	while (i < n) {
+		// 359 is the largest block for which the sums can not overflow before
+		// being reduced.
+		for (block = MIN(n - i, 359); block > 0; block--) {
+			sum1 += get(src, i++);
+			sum2 += sum1;
+		}
+
+		sum1 = (sum1 & 0xFFFF) + (sum1 >> 16);
+		sum2 = (sum2 & 0xFFFF) + (sum2 >> 16);
+	}
+
+	sum1 = (sum1 & 0xFFFF) + (sum1 >> 16);
+	sum2 = (sum2 & 0xFFFF) + (sum2 >> 16);
+
+	return (sum2 << 16) | sum1;
+}
+
+static word_t n2t_romimage_array_word(void const *words, size_t i) {
+	return ((word_t const*) words)[i];
+}
+
+static word_t n2t_romimage_image_word(void const *r, size_t i) {
+	return n2t_romimage_word(r, i);
+}
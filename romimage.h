@@ -0,0 +1,145 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef ROMIMAGE_H
+#define ROMIMAGE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "utils.h"
+#include "lexer.h"
+
+
+#define	ROMIMAGE_MAGIC "HACK"
+#define	ROMIMAGE_VERSION 1
+// Size in bytes of the optional header of a ROM image.
+#define	ROMIMAGE_HEADER_SIZE 16
+// Set within the `flags' header byte of big-endian images.
+#define	ROMIMAGE_FLAG_BIG 0x1
+// Checksum of an empty sequence of words.
+#define	ROMIMAGE_CHECKSUM_INIT 0xFFFFFFFF
+
+/**
+ * Byte order of the 16-bit words of a ROM image.
+ */
+typedef enum {
+	ROMIMAGE_LITTLE,
+	ROMIMAGE_BIG
+} romendian_t;
+
+/**
+ * A ROM image is the raw sequence of the machine words of a program, two bytes
+ * each, optionally preceded by a `ROMIMAGE_HEADER_SIZE' bytes header laid out
+ * as follows:
+ *
+ * 	- bytes 0-3: `ROMIMAGE_MAGIC';
+ * 	- byte 4: `ROMIMAGE_VERSION';
+ * 	- byte 5: flags, `ROMIMAGE_FLAG_BIG' if words are big-endian;
+ * 	- bytes 6-7: zero;
+ * 	- bytes 8-11: number of words;
+ * 	- bytes 12-15: `n2t_romimage_checksum()' of the words.
+ *
+ * Header fields share the byte order of the words.
+ *
+ * `romimage_t' is a loaded image: `words' points to the first word within the
+ * memory mapping `map', and should be read through `n2t_romimage_word()'.
+ */
+typedef struct {
+	filemap_t map;
+	uint8_t const *words;
+	uint32_t nwords;
+	romendian_t endian;
+} romimage_t;
+
+
+/**
+ * Returns: the size in bytes of an image of `n' words, with a header if
+ * `header' is non-zero.
+ */
+size_t n2t_romimage_size(size_t n, int header);
+/**
+ * Stores the image of the `n' words at `words' into `dest', which must be at
+ * least `n2t_romimage_size(n, header)' bytes large.
+ *
+ * Returns: the number of bytes written to `dest'.
+ */
+size_t n2t_romimage_write(
+	word_t const *words, size_t n, romendian_t endian, int header,
+	uint8_t *dest
+);
+/**
+ * Stores into `dest' the header of an image of `n' words in `endian' byte
+ * order, having checksum `checksum'.
+ *
+ * Returns: the number of bytes written to `dest', `ROMIMAGE_HEADER_SIZE'.
+ */
+size_t n2t_romimage_write_header(
+	size_t n, uint32_t checksum, romendian_t endian, uint8_t *dest
+);
+/**
+ * Returns: the Fletcher-32 checksum of the `n' words at `words'. It is computed
+ * on word values, hence it does not depend on the byte order of an image.
+ */
+uint32_t n2t_romimage_checksum(word_t const *words, size_t n);
+/**
+ * Same as `n2t_romimage_checksum()', on the `n' words at `words' encoded in
+ * `endian' byte order, as found within an image.
+ */
+uint32_t n2t_romimage_checksum_bytes(
+	uint8_t const *words, size_t n, romendian_t endian
+);
+/**
+ * Returns: the checksum of the words summarized by `checksum' followed by the
+ * `n' words at `words', so that images can be checksummed a block at a time
+ * starting from `ROMIMAGE_CHECKSUM_INIT'.
+ */
+uint32_t n2t_romimage_checksum_update(
+	uint32_t checksum, word_t const *words, size_t n
+);
+/**
+ * Memory maps the ROM image at `filepath' into `dest'. If `header' is non-zero
+ * the image must begin with a valid header, which dictates the byte order and
+ * is checked against the length and checksum of the words; `endian' is then
+ * ignored. Headerless images are read as `endian' words.
+ *
+ * Returns: `1' if the file can not be read or is not a valid image, `0'
+ * otherwise. On success, `dest' should be released with
+ * `n2t_romimage_close()'.
+ */
+int n2t_romimage_open(
+	char const *filepath, romendian_t endian, int header, romimage_t *dest
+);
+/**
+ * Releases an image loaded by `n2t_romimage_open()'.
+ */
+void n2t_romimage_close(romimage_t *r);
+
+/**
+ * Returns: word `i' of `r', which must be lower than `r->nwords'.
+ */
+static inline word_t n2t_romimage_word(romimage_t const *r, size_t i) {
+	uint8_t const *w = r->words + 2 * i;
+
+	return r->endian == ROMIMAGE_BIG ? (w[0] << 8) | w[1]: (w[1] << 8) | w[0];
+}
+
+
+#endif
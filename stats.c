@@ -0,0 +1,83 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "stats.h"
+#include <sys/resource.h>
+
+
+#ifndef N2T_NO_STATS
+/**
+ * Returns: the seconds elapsed from `from' to `to'.
+ */
+static double n2t_stats_seconds(
+	struct timespec const *from, struct timespec const *to
+);
+#endif
+
+
+char const* n2t_stats_phase_name(int phase) {
+	static char const *names[STATS_PHASES_NO] = {
+		"tokenize", "parse_rom_labels", "assign_rom_labels",
+		"assign_ram_labels", "emit"
+	};
+
+	return phase >= 0 && phase < STATS_PHASES_NO ? names[phase]: "";
+}
+
+size_t n2t_stats_peak_rss(void) {
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage))
+		return 0;
+
+	// Linux reports kilobytes.
+	return (size_t) usage.ru_maxrss * 1024;
+}
+
+#ifndef N2T_NO_STATS
+void n2t_stats_start(asmstats_t const *stats, statsmark_t *mark) {
+	if (stats == NULL)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &mark->wall);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &mark->cpu);
+}
+
+void n2t_stats_lap(asmstats_t *stats, int phase, statsmark_t *mark) {
+	statsmark_t now;
+
+	if (stats == NULL)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now.wall);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now.cpu);
+	stats->wall[phase] += n2t_stats_seconds(&mark->wall, &now.wall);
+	stats->cpu[phase] += n2t_stats_seconds(&mark->cpu, &now.cpu);
+	*mark = now;
+}
+
+
+static double n2t_stats_seconds(
+	struct timespec const *from, struct timespec const *to
+) {
+	return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1E9;
+}
+#endif
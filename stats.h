@@ -0,0 +1,89 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+
+// Phases of an assembly timed by `asmstats_t'.
+#define	STATS_TOKENIZE 0
+#define	STATS_PARSE_ROM_LABELS 1
+#define	STATS_ASSIGN_ROM_LABELS 2
+#define	STATS_ASSIGN_RAM_LABELS 3
+#define	STATS_EMIT 4
+#define	STATS_PHASES_NO 5
+
+/**
+ * What an assembly went through: `nlines' lines of source, `ntokens' tokens,
+ * `nunique' of them distinct and kept in the multiton, `nlabels' ROM labels
+ * and `nvariables' RAM variables. The memory caches of tokens and labels grew
+ * `ngrows' times, by `grow_bytes' bytes in all.
+ *
+ * `wall' and `cpu' hold the seconds spent in each phase, on the clock and by
+ * the calling thread respectively. Phases an assembly skips, such as those of
+ * an output found in the cache, are left at zero; when tokenizing with
+ * several threads, locating ROM labels is part of tokenization.
+ */
+typedef struct {
+	size_t nlines, ntokens, nunique, nlabels, nvariables;
+	size_t ngrows, grow_bytes;
+	double wall[STATS_PHASES_NO], cpu[STATS_PHASES_NO];
+} asmstats_t;
+
+/**
+ * A point in time, on the clock and in CPU time of the calling thread.
+ */
+typedef struct {
+	struct timespec wall, cpu;
+} statsmark_t;
+
+/**
+ * Returns: the name of `phase', such as "tokenize".
+ */
+char const* n2t_stats_phase_name(int phase);
+/**
+ * Returns: the peak resident set size of the process so far, in bytes.
+ */
+size_t n2t_stats_peak_rss(void);
+
+// Collecting statistics costs a few clock readings per assembly, and nothing
+// at all once compiled out by defining `N2T_NO_STATS'.
+#ifndef N2T_NO_STATS
+/**
+ * Records the current time into `mark', unless `stats' is `NULL'.
+ */
+void n2t_stats_start(asmstats_t const *stats, statsmark_t *mark);
+/**
+ * Adds the time elapsed since `mark' to `phase' of `stats', then records the
+ * current time into `mark'. Does nothing if `stats' is `NULL'.
+ */
+void n2t_stats_lap(asmstats_t *stats, int phase, statsmark_t *mark);
+#else
+#define	n2t_stats_start(stats, mark) ((void) (stats), (void) (mark))
+#define	n2t_stats_lap(stats, phase, mark) ((void) (stats), (void) (mark))
+#endif
+
+
+#endif
@@ -0,0 +1,181 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "strtable.h"
+#include <string.h>
+
+
+/**
+ * Reference to a string stored into `long_strings[class]' at `index', as held
+ * by its unit of `strings'. `mark' is the last byte of the unit.
+ */
+typedef struct {
+	uint32_t index;
+	uint8_t class;
+	char padding[STRTABLE_UNITSIZE - sizeof(uint32_t) - 2];
+	char mark;
+} longref_t;
+
+/**
+ * Returns: the size class of a string of `len >= STRTABLE_UNITSIZE' bytes, or
+ * `-1' if it is too long for any.
+ */
+static int n2t_strtable_class(size_t len);
+/**
+ * Looks up, or interns if `intern' is non-zero, a string of at least
+ * `STRTABLE_UNITSIZE' bytes.
+ *
+ * Returns: the same as `n2t_strtable_intern()' or `n2t_strtable_find()'.
+ */
+static int64_t n2t_strtable_long(
+	strtable_t *t, char const *s, size_t len, int intern
+);
+
+strtable_t* n2t_strtable_alloc(uint32_t n) {
+	return n2t_strtable_alloc_in(n, NULL);
+}
+
+strtable_t* n2t_strtable_alloc_in(uint32_t n, arena_t *arena) {
+	strtable_t *o;
+
+	o = arena ?
+		n2t_arena_push(arena, sizeof(strtable_t)): malloc(sizeof(strtable_t));
+
+	if (o == NULL)
+		return NULL;
+
+	memset(o->long_strings, 0, sizeof(o->long_strings));
+	o->strings = n2t_memcache_alloc_in(n + 1, STRTABLE_UNITSIZE, arena);
+
+	if (o->strings == NULL) {
+		if (arena == NULL)
+			free(o);
+
+		return NULL;
+	}
+
+	// The empty string, all zeros, gets identifier `STRTABLE_EMPTY'.
+	if (n2t_memcache_intern(o->strings, "", 0) != STRTABLE_EMPTY) {
+		n2t_strtable_free(o);
+		return NULL;
+	}
+
+	return o;
+}
+
+int64_t n2t_strtable_intern(strtable_t *t, char const *s, size_t len) {
+	if (s == NULL)
+		return -1;
+	// Room must be left for the terminating null byte, which is added by the
+	// zero-padding of `memcache_t'.
+	if (len >= STRTABLE_UNITSIZE)
+		return n2t_strtable_long(t, s, len, 1);
+
+	return n2t_memcache_intern(t->strings, s, len);
+}
+
+int64_t n2t_strtable_find(strtable_t const *t, char const *s, size_t len) {
+	if (s == NULL)
+		return -1;
+	// Nothing is modified unless interning.
+	if (len >= STRTABLE_UNITSIZE)
+		return n2t_strtable_long((strtable_t*) t, s, len, 0);
+
+	return n2t_memcache_index_of(t->strings, s, len);
+}
+
+char const* n2t_strtable_get(strtable_t const *t, uint32_t id) {
+	longref_t const *ref = n2t_memcache_index_fetch(t->strings, id);
+
+	if (ref == NULL || ref->mark == '\0')
+		return (char const*) ref;
+
+	return n2t_memcache_index_fetch(t->long_strings[ref->class], ref->index);
+}
+
+uint32_t n2t_strtable_length(strtable_t const *t) {
+	return t->strings->next;
+}
+
+void n2t_strtable_free(strtable_t *t) {
+	int k;
+
+	if (t->strings->arena)
+		return;
+
+	for (k = 0; k < STRTABLE_CLASSES; k++) {
+		if (t->long_strings[k])
+			n2t_memcache_free(t->long_strings[k]);
+	}
+
+	n2t_memcache_free(t->strings);
+	free(t);
+}
+
+
+static int n2t_strtable_class(size_t len) {
+	int k;
+
+	for (k = 0; k < STRTABLE_CLASSES; k++) {
+		if (len < (size_t) STRTABLE_UNITSIZE << (k + 1))
+			return k;
+	}
+
+	return -1;
+}
+
+static int64_t n2t_strtable_long(
+	strtable_t *t, char const *s, size_t len, int intern
+) {
+	int const k = n2t_strtable_class(len);
+	longref_t ref = {0};
+	int64_t index;
+
+	if (k < 0)
+		return -1;
+
+	if (t->long_strings[k] == NULL) {
+		if (!intern)
+			return -1;
+
+		t->long_strings[k] = n2t_memcache_alloc_in(
+			1, STRTABLE_UNITSIZE << (k + 1), t->strings->arena
+		);
+
+		if (t->long_strings[k] == NULL)
+			return -1;
+	}
+
+	index = intern ?
+		n2t_memcache_intern(t->long_strings[k], s, len):
+		n2t_memcache_index_of(t->long_strings[k], s, len);
+
+	if (index < 0)
+		return -1;
+
+	ref.index = index;
+	ref.class = k;
+	ref.mark = 1;
+
+	return intern ?
+		n2t_memcache_intern(t->strings, &ref, sizeof(ref)):
+		n2t_memcache_index_of(t->strings, &ref, sizeof(ref));
+}
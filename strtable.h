@@ -0,0 +1,97 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef STRTABLE_H
+#define STRTABLE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "utils.h"
+#include "memcache.h"
+#include "arena.h"
+
+
+// Storage reserved to every string, terminating null byte included. Longer
+// strings are stored apart, see `strtable_t'.
+#define	STRTABLE_UNITSIZE BUFFSIZE_MED
+// Number of size classes for strings of `STRTABLE_UNITSIZE' bytes or more:
+// class `k' holds units of `STRTABLE_UNITSIZE << (k + 1)' bytes.
+#define	STRTABLE_CLASSES 25
+// Identifier of the empty string, always present in a `strtable_t'.
+#define	STRTABLE_EMPTY 0
+
+/**
+ * `strtable_t' interns strings, such as label names, so that each distinct
+ * string is stored exactly once and referred to by a 32-bit identifier.
+ * Identifiers are dense and assigned in order of insertion, starting from
+ * `STRTABLE_EMPTY'. Two strings are equal if and only if their identifiers
+ * are, and interned strings never move in memory.
+ *
+ * Every identifier is a unit of `strings'. Strings too long for it are
+ * interned into `long_strings[k]', the smallest size class they fit in, and
+ * their unit of `strings' holds `k' and their index there instead. Such a
+ * unit ends with a non-zero byte, which no string stored in place does.
+ * Size classes are only allocated once needed.
+ */
+typedef struct {
+	memcache_t *strings;
+	memcache_t *long_strings[STRTABLE_CLASSES];
+} strtable_t;
+
+/**
+ * Allocates a `strtable_t' with initial room for `n' strings.
+ *
+ * Returns: the new table or `NULL' if an error occurs.
+ */
+strtable_t* n2t_strtable_alloc(uint32_t n);
+/**
+ * Same as `n2t_strtable_alloc()', allocating the table and its strings from
+ * `arena' unless `NULL'. They are then released along with `arena'.
+ */
+strtable_t* n2t_strtable_alloc_in(uint32_t n, arena_t *arena);
+/**
+ * Interns the `len' characters starting at `s', which need not be
+ * null-terminated.
+ *
+ * Returns: the identifier of the string, or `-1' if an error occurs.
+ */
+int64_t n2t_strtable_intern(strtable_t *t, char const *s, size_t len);
+/**
+ * Returns: the identifier of the `len' characters starting at `s', or `-1' if
+ * they were never interned.
+ */
+int64_t n2t_strtable_find(strtable_t const *t, char const *s, size_t len);
+/**
+ * Returns: the null-terminated string with identifier `id', or `NULL' if no
+ * such string exists.
+ */
+char const* n2t_strtable_get(strtable_t const *t, uint32_t id);
+/**
+ * Returns: the number of strings interned into `t'.
+ */
+uint32_t n2t_strtable_length(strtable_t const *t);
+/**
+ * Frees up the memory associated with a `strtable_t' object.
+ */
+void n2t_strtable_free(strtable_t *t);
+
+
+#endif
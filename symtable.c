@@ -0,0 +1,146 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "symtable.h"
+#include <string.h>
+
+
+symtable_t* n2t_symtable_alloc(uint32_t n) {
+	return n2t_symtable_alloc_in(n, NULL);
+}
+
+symtable_t* n2t_symtable_alloc_in(uint32_t n, arena_t *arena) {
+	symtable_t *o;
+
+	if (n < 1)
+		return NULL;
+
+	if (arena) {
+		if ((o = n2t_arena_push(arena, sizeof(symtable_t))) == NULL)
+			return NULL;
+		if ((o->entries = n2t_arena_zeroed(arena, n, sizeof(memloc_t))) == NULL)
+			return NULL;
+	} else {
+		if ((o = malloc(sizeof(symtable_t))) == NULL)
+			return NULL;
+
+		if ((o->entries = calloc(n, sizeof(memloc_t))) == NULL) {
+			free(o);
+			return NULL;
+		}
+	}
+
+	o->length = n;
+	o->ndefined = o->nrom = 0;
+	o->arena = arena;
+
+	return o;
+}
+
+/**
+ * Makes room in `t' for at least `label + 1' entries.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_symtable_reserve(symtable_t *t, uint32_t label);
+
+
+int n2t_symtable_define(
+	symtable_t *t, uint32_t label, uint16_t location, memtype_t type
+) {
+	if (n2t_symtable_reserve(t, label))
+		return 1;
+
+	if (t->entries[label].loaded)
+		return SYMTABLE_DUPLICATE;
+
+	return n2t_symtable_set(t, label, location, type);
+}
+
+int n2t_symtable_set(
+	symtable_t *t, uint32_t label, uint16_t location, memtype_t type
+) {
+	if (n2t_symtable_reserve(t, label))
+		return 1;
+
+	t->ndefined += !t->entries[label].loaded;
+
+	// Redefining an entry moves it from one memory to the other at most.
+	if (t->entries[label].loaded && t->entries[label].type == ROM)
+		t->nrom--;
+	if (type == ROM)
+		t->nrom++;
+
+	t->entries[label].label = label;
+	t->entries[label].location = location;
+	t->entries[label].loaded = 1;
+	t->entries[label].type = type;
+
+	return 0;
+}
+
+memloc_t const* n2t_symtable_lookup(symtable_t const *t, uint32_t label) {
+	if (label >= t->length || !t->entries[label].loaded)
+		return NULL;
+
+	return t->entries + label;
+}
+
+void n2t_symtable_free(symtable_t *t) {
+	if (t->arena)
+		return;
+
+	free(t->entries);
+	free(t);
+}
+
+
+static int n2t_symtable_reserve(symtable_t *t, uint32_t label) {
+	memloc_t *updated_entries;
+	uint64_t length = t->length;
+
+	if (label >= t->length) {
+		while (length <= label)
+			length <<= 1;
+
+		if (length > UINT32_MAX)
+			return 1;
+
+		updated_entries = t->arena ?
+			n2t_arena_resize(
+				t->arena, t->entries, t->length * sizeof(memloc_t),
+				length * sizeof(memloc_t)
+			):
+			realloc(t->entries, length * sizeof(memloc_t));
+
+		if (updated_entries == NULL)
+			return 1;
+
+		memset(
+			updated_entries + t->length, 0,
+			(length - t->length) * sizeof(memloc_t)
+		);
+		t->entries = updated_entries;
+		t->length = length;
+	}
+
+	return 0;
+}
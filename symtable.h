@@ -0,0 +1,92 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef SYMTABLE_H
+#define SYMTABLE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "lexer.h"
+#include "arena.h"
+
+
+#define	SYMTABLE_DUPLICATE 2
+
+/**
+ * `symtable_t' maps label names, as interned into a `strtable_t', to the
+ * memory locations they stand for.
+ *
+ * Since label identifiers are dense and start from `0', they index `entries'
+ * directly: a lookup is a bound check followed by an array access. An entry
+ * whose `loaded' field is `0' is not defined. `ndefined' counts the defined
+ * entries, and `nrom' those of them in ROM.
+ *
+ * If `arena' is not `NULL', the table and its entries are allocated from it.
+ */
+typedef struct {
+	memloc_t *entries;
+	uint32_t length, ndefined, nrom;
+
+	arena_t *arena;
+} symtable_t;
+
+/**
+ * Allocates a `symtable_t' with initial room for `n' labels.
+ *
+ * Returns: the new table or `NULL' if an error occurs.
+ */
+symtable_t* n2t_symtable_alloc(uint32_t n);
+/**
+ * Same as `n2t_symtable_alloc()', allocating from `arena' unless `NULL'.
+ */
+symtable_t* n2t_symtable_alloc_in(uint32_t n, arena_t *arena);
+/**
+ * Binds `label' to `location' within memory `type'.
+ *
+ * Returns:
+ *   - `1' if an error occurs
+ *   - `SYMTABLE_DUPLICATE' if `label' was already defined, in which case the
+ *   existing definition is left untouched
+ *   - `0' otherwise.
+ */
+int n2t_symtable_define(
+	symtable_t *t, uint32_t label, uint16_t location, memtype_t type
+);
+/**
+ * Binds `label' to `location' within memory `type', replacing any existing
+ * definition.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+int n2t_symtable_set(
+	symtable_t *t, uint32_t label, uint16_t location, memtype_t type
+);
+/**
+ * Returns: the definition of `label' or `NULL' if `label' is not defined.
+ */
+memloc_t const* n2t_symtable_lookup(symtable_t const *t, uint32_t label);
+/**
+ * Frees up the memory associated with a `symtable_t' object.
+ */
+void n2t_symtable_free(symtable_t *t);
+
+
+#endif
@@ -23,11 +23,26 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #include "lexer.h"
 #include "parser.h"
 #include "utils.h"
 #include "memcache.h"
+#include "strtable.h"
+#include "linescan.h"
+#include "romimage.h"
+#include "pool.h"
+#include "hash.h"
+#include "cache.h"
+#include "incremental.h"
+#include "arena.h"
+#include "hackasm.h"
+#include "workload.h"
 
 
 #define	TEST_DIR_ROOT "test_fixtures/"
@@ -42,6 +57,18 @@ int test_n2t_ends_with(void *const args, char errmsg[], size_t maxwrite);
 
 // lexer.h
 int test_n2t_instr_to_bitstr(void *const args, char errmsg[], size_t maxwrite);
+/**
+ * Formats every possible machine word, checking it against a digit-by-digit
+ * conversion.
+ */
+int test_n2t_words_to_bitlines(void *const args, char errmsg[], size_t maxwrite);
+int test_n2t_str_to_Cinstr(void *const args, char errmsg[], size_t maxwrite);
+/**
+ * Tokenizes an in-memory buffer with long lines, comments, Windows line
+ * endings and no terminating newline.
+ */
+int test_n2t_tokenize_buffer(void *const args, char errmsg[], size_t maxwrite);
+int test_n2t_scan_line(void *const args, char errmsg[], size_t maxwrite);
 /**
  * Reads a filepath from `args', interpreting it as an .asm file to parse,
  * interpret, translate and confront with the original input.
@@ -59,6 +86,115 @@ int test_batch_back_translation(void *const args, char errmsg[], size_t maxwrite
 int test_n2t_memcache_fetch(void *const args, char errmsg[], size_t maxwrite);
 int test_n2t_memcache_index_fetch(void *const args, char errmsg[], size_t maxwrite);
 int test_n2t_memcache_extend(void *const args, char errmsg[], size_t maxwrite);
+int test_n2t_memcache_index_of(void *const args, char errmsg[], size_t maxwrite);
+int test_n2t_memcache_intern(void *const args, char errmsg[], size_t maxwrite);
+
+// strtable.h
+int test_n2t_strtable_intern(void *const args, char errmsg[], size_t maxwrite);
+
+// arena.h
+/**
+ * Checks the alignment of allocations, growth in place of the last one, and
+ * that an arena reset after spilling into several blocks holds the same work
+ * in a single one. Parses a program within an arena as on the heap.
+ */
+int test_n2t_arena_push(void *const args, char errmsg[], size_t maxwrite);
+
+// linescan.h
+/**
+ * Splits a buffer with comments, slashes and lines straddling the vector
+ * widths with every supported kernel, a few spans at a time.
+ */
+int test_n2t_linescan_next(void *const args, char errmsg[], size_t maxwrite);
+
+// romimage.h
+/**
+ * Writes and loads back images in both byte orders, with and without header,
+ * then checks that a corrupted image is refused.
+ */
+int test_n2t_romimage_open(void *const args, char errmsg[], size_t maxwrite);
+
+// hash.h
+/**
+ * Checks digests against those of the reference xxHash implementation.
+ */
+int test_n2t_hash64(void *const args, char errmsg[], size_t maxwrite);
+
+// cache.h
+/**
+ * Stores and fetches entries, checking that identical outputs are left
+ * untouched and that the least recently used entry is evicted.
+ */
+int test_n2t_cache_fetch(void *const args, char errmsg[], size_t maxwrite);
+
+// pool.h
+/**
+ * Parses a few programs many times over on a pool, checking that concurrent
+ * parses assemble the same words.
+ */
+int test_n2t_pool_submit(void *const args, char errmsg[], size_t maxwrite);
+
+// parser.h
+/**
+ * Checks that `n2t_parse()' refuses a file defining the same label twice.
+ */
+int test_n2t_parse_duplicate_label(
+	void *const args, char errmsg[], size_t maxwrite
+);
+/**
+ * Checks the addresses assigned to default, user-defined and automatically
+ * allocated RAM variables by `n2t_parse_with()'.
+ */
+int test_n2t_parse_with_predefs(
+	void *const args, char errmsg[], size_t maxwrite
+);
+/**
+ * Checks that `n2t_parse_stream()' emits the same words `n2t_parse_with()'
+ * assembles, on a program spanning several read chunks and sink batches.
+ */
+int test_n2t_parse_stream(void *const args, char errmsg[], size_t maxwrite);
+/**
+ * Checks that tokenizing with several threads yields the same words as the
+ * serial path, and still detects labels defined in different chunks.
+ */
+int test_n2t_parse_parallel(void *const args, char errmsg[], size_t maxwrite);
+/**
+ * Checks that `n2t_parse_buffer()' assembles a program held in memory as
+ * `n2t_parse_with()' assembles its file.
+ */
+int test_n2t_parse_buffer(void *const args, char errmsg[], size_t maxwrite);
+/**
+ * Checks the counters `n2t_parse_buffer()', `n2t_parse_with()' with several
+ * threads and `n2t_parse_stream()' record into `asmstats_t'.
+ */
+int test_n2t_parse_stats(void *const args, char errmsg[], size_t maxwrite);
+
+// incremental.h
+/**
+ * Updates a state through a few edits of a program, checking its words
+ * against those `n2t_parse_buffer()' assembles, that it survives being saved
+ * and loaded, and that it does not grow with labels renamed.
+ */
+int test_n2t_asmstate_update(void *const args, char errmsg[], size_t maxwrite);
+
+// hackasm.h
+/**
+ * Assembles programs held in memory into words, `.hack' text and ROM images,
+ * checking them against the reference outputs. The texts and images are then
+ * emitted again by several threads, which must produce the same bytes, while
+ * a single thread must reserve the exact length of its output.
+ */
+int test_n2t_assemble_buffer(void *const args, char errmsg[], size_t maxwrite);
+
+// workload.h
+/**
+ * Generates programs from many seeds and parameters, checking that they are
+ * reproducible and that the assembler translates them as expected, also
+ * beyond the instructions labels can refer to.
+ */
+int test_n2t_workload_generate(
+	void *const args, char errmsg[], size_t maxwrite
+);
 
 // assembler.c
 /**
@@ -68,6 +204,17 @@ int test_n2t_memcache_extend(void *const args, char errmsg[], size_t maxwrite);
  */
 int test_assembler(void *const args, char errmsg[], size_t maxwrite);
 int test_assembler_batch(void *const args, char errmsg[], size_t maxwrite);
+/**
+ * Has a daemon serving ROM images assemble a file for a client given no
+ * format, checking that the output is named and formatted after the daemon.
+ */
+int test_assembler_daemon(void *const args, char errmsg[], size_t maxwrite);
+/**
+ * Has the assembler write `.hack' texts and ROM images with several threads,
+ * into its mapped output files, checking them against single-threaded
+ * assembly.
+ */
+int test_assembler_threads(void *const args, char errmsg[], size_t maxwrite);
 
 
 typedef int (*test_function)(void*, char[], size_t);
@@ -78,23 +225,76 @@ int main (int argc, char *argv[]) {
 		test_n2t_strip, test_n2t_composed_of, test_n2t_decomment,
 		test_n2t_replace_any, test_n2t_collapse_any, test_n2t_ends_with,
 
-		test_n2t_instr_to_bitstr, test_batch_back_translation,
+		test_n2t_instr_to_bitstr, test_n2t_words_to_bitlines,
+		test_n2t_str_to_Cinstr,
+		test_n2t_tokenize_buffer, test_n2t_scan_line,
+		test_batch_back_translation,
 
 		test_n2t_memcache_fetch, test_n2t_memcache_extend,
-		test_n2t_memcache_index_fetch,
+		test_n2t_memcache_index_fetch, test_n2t_memcache_index_of,
+		test_n2t_memcache_intern,
+
+		test_n2t_strtable_intern,
+
+		test_n2t_arena_push,
+
+		test_n2t_linescan_next,
+
+		test_n2t_romimage_open,
 
-		test_assembler_batch
+		test_n2t_hash64, test_n2t_cache_fetch,
+
+		test_n2t_pool_submit,
+
+		test_n2t_parse_duplicate_label, test_n2t_parse_with_predefs,
+		test_n2t_parse_stream, test_n2t_parse_parallel,
+		test_n2t_parse_buffer, test_n2t_parse_stats,
+
+		test_n2t_asmstate_update,
+
+		test_n2t_assemble_buffer,
+
+		test_n2t_workload_generate,
+
+		test_assembler_batch, test_assembler_daemon, test_assembler_threads
 	};
 	char *test_names[] = {
 		"test_n2t_strip", "test_n2t_composed_of", "test_n2t_decomment",
 		"test_n2t_replace_any", "test_n2t_collapse_any", "test_n2t_ends_with",
 
-		"test_n2t_instr_to_bitstr", "test_batch_back_translation",
+		"test_n2t_instr_to_bitstr", "test_n2t_words_to_bitlines",
+		"test_n2t_str_to_Cinstr",
+		"test_n2t_tokenize_buffer", "test_n2t_scan_line",
+		"test_batch_back_translation",
 
 		"test_n2t_memcache_fetch", "test_n2t_memcache_extend",
-		"test_n2t_memcache_index_fetch",
+		"test_n2t_memcache_index_fetch", "test_n2t_memcache_index_of",
+		"test_n2t_memcache_intern",
+
+		"test_n2t_strtable_intern",
+
+		"test_n2t_arena_push",
 
-		"test_assembler_batch"
+		"test_n2t_linescan_next",
+
+		"test_n2t_romimage_open",
+
+		"test_n2t_hash64", "test_n2t_cache_fetch",
+
+		"test_n2t_pool_submit",
+
+		"test_n2t_parse_duplicate_label", "test_n2t_parse_with_predefs",
+		"test_n2t_parse_stream", "test_n2t_parse_parallel",
+		"test_n2t_parse_buffer", "test_n2t_parse_stats",
+
+		"test_n2t_asmstate_update",
+
+		"test_n2t_assemble_buffer",
+
+		"test_n2t_workload_generate",
+
+		"test_assembler_batch", "test_assembler_daemon",
+		"test_assembler_threads"
 	};
 	char errmsg[BUFFSIZE_VLARGE];
 	size_t const tests_no = sizeof(tests) / sizeof(test_function);
@@ -319,6 +519,240 @@ int test_n2t_instr_to_bitstr(
 	return 0;
 }
 
+int test_n2t_words_to_bitlines(
+	void *const args, char errmsg[], size_t maxwrite
+) {
+	size_t const words_no = 1 << 16;
+	word_t *words = malloc(words_no * sizeof(word_t));
+	char *lines = malloc(words_no * BITLINE_LENGTH), exp[BITLINE_LENGTH];
+	size_t i, j;
+
+	if (words == NULL || lines == NULL) {
+		snprintf(errmsg, maxwrite, "Could not allocate the buffers.");
+		free(words);
+		free(lines);
+
+		return 1;
+	}
+
+	for (i = 0; i < words_no; i++)
+		words[i] = i;
+
+	if (n2t_words_to_bitlines(words, words_no, lines) != words_no * BITLINE_LENGTH) {
+		snprintf(errmsg, maxwrite, "Unexpected number of characters written.");
+		free(words);
+		free(lines);
+
+		return 1;
+	}
+
+	for (i = 0; i < words_no; i++) {
+		for (j = 0; j < 16; j++)
+			exp[j] = i & (1 << (15 - j)) ? '1': '0';
+		exp[16] = '\n';
+
+		if (memcmp(lines + i * BITLINE_LENGTH, exp, BITLINE_LENGTH)) {
+			snprintf(
+				errmsg, maxwrite, "Word %04lx was formatted as `%.16s'.", i,
+				lines + i * BITLINE_LENGTH
+			);
+			free(words);
+			free(lines);
+
+			return 1;
+		}
+	}
+
+	free(words);
+	free(lines);
+
+	return 0;
+}
+
+int test_n2t_str_to_Cinstr(void *const args, char errmsg[], size_t maxwrite) {
+	char const *comps[] = {
+		"0", "1", "-1", "D", "A", "!D", "!A", "-D", "-A", "D+1", "A+1", "D-1",
+		"A-1", "D+A", "D-A", "A-D", "D&A", "D|A", "M", "!M", "-M", "M+1",
+		"M-1", "D+M", "D-M", "M-D", "D&M", "D|M"
+	};
+	char const *prefixes[] = {"", "M=", "AMD="}, *suffixes[] = {"", ";JLE"};
+	char const *invalid[] = {
+		"", "D+2", "A+D", "1+D", "DD", "D=", "D;", "D;JXX", "D;JMPP", "X=D",
+		"MM=D", "D+1+1"
+	};
+	char input[BUFFSIZE_SMALL], output[BUFFSIZE_SMALL];
+	Cinstr_t c;
+	size_t i, j, k;
+
+	// Every valid instruction must translate back to itself.
+	for (i = 0; i < sizeof(comps) / sizeof(char*); i++) {
+		for (j = 0; j < sizeof(prefixes) / sizeof(char*); j++) {
+			for (k = 0; k < sizeof(suffixes) / sizeof(char*); k++) {
+				n2t_join(
+					input, BUFFSIZE_SMALL, 3, prefixes[j], comps[i],
+					suffixes[k]
+				);
+
+				if (
+					n2t_str_to_Cinstr(input, &c) ||
+					n2t_Cinstr_to_str(c, output, BUFFSIZE_SMALL) ||
+					strcmp(input, output)
+				) {
+					snprintf(
+						errmsg, maxwrite, "`%s' was translated back to `%s'.",
+						input, output
+					);
+
+					return 1;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < sizeof(invalid) / sizeof(char*); i++) {
+		if (n2t_str_to_Cinstr(invalid[i], &c) == 0) {
+			snprintf(errmsg, maxwrite, "`%s' was accepted.", invalid[i]);
+
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int test_n2t_scan_line(void *const args, char errmsg[], size_t maxwrite) {
+	struct {
+		char const *line;
+		int result;
+		char const *repr;
+	} const cases[] = {
+		{"", SCAN_BLANK, NULL}, {" \t\r", SCAN_BLANK, NULL},
+		{"  // @17", SCAN_BLANK, NULL}, {"@17// A comment", 0, "@17"},
+		{" @LOOP.end$1 \r", 0, "@LOOP.end$1"}, {"(LOOP)//", 0, "(LOOP)"},
+		{" AM = M + 1 ; JNE ", 0, "AM=M+1;JNE"}, {"0;JMP\r", 0, "0;JMP"},
+		{"@", 1, NULL}, {"@1x", 1, NULL}, {"@LOOP x", 1, NULL},
+		{"()", 1, NULL}, {"(LOOP", 1, NULL}, {"(LOOP) x", 1, NULL},
+		{"D=D+1 x", 1, NULL}, {"DD=1", 1, NULL}, {"D=1;", 1, NULL},
+		{"/", 1, NULL}, {"@32767", 0, "@32767"}, {"@032767", 0, "@32767"},
+		{"@32768", 1, NULL}, {"@65536", 1, NULL}, {"@4294967296", 1, NULL},
+	};
+	size_t const cases_no = sizeof(cases) / sizeof(cases[0]);
+	char actual_repr[BUFFSIZE_LARGE];
+	strtable_t *labels = n2t_strtable_alloc(BUFFSIZE_SMALL);
+	token_t t;
+	size_t i;
+	int result;
+
+	for (i = 0; i < cases_no; i++) {
+		result = n2t_scan_line(
+			cases[i].line, strlen(cases[i].line), labels, &t
+		);
+
+		if (result != cases[i].result) {
+			snprintf(
+				errmsg, maxwrite, "Scanning `%s' returned %d rather than %d.",
+				cases[i].line, result, cases[i].result
+			);
+			n2t_strtable_free(labels);
+
+			return 1;
+		} else if (cases[i].repr == NULL) {
+			continue;
+		}
+
+		if (t.type == INSTR) {
+			n2t_instr_to_str(
+				t.data.instr, labels, actual_repr, BUFFSIZE_LARGE
+			);
+		} else {
+			snprintf(
+				actual_repr, BUFFSIZE_LARGE, "(%s)",
+				n2t_strtable_get(labels, t.data.label.label)
+			);
+		}
+
+		if (strcmp(actual_repr, cases[i].repr)) {
+			snprintf(
+				errmsg, maxwrite, "`%s' was scanned as `%s' rather than `%s'.",
+				cases[i].line, actual_repr, cases[i].repr
+			);
+			n2t_strtable_free(labels);
+
+			return 1;
+		}
+	}
+
+	n2t_strtable_free(labels);
+
+	return 0;
+}
+
+int test_n2t_tokenize_buffer(void *const args, char errmsg[], size_t maxwrite) {
+	char const *exp_reprs[] = {"@LOOP", "(LOOP)", "D=D-1;JGT", "@17", "M=D"};
+	size_t const exp_no = sizeof(exp_reprs) / sizeof(char*), padding = 300;
+	char src[4 * padding], actual_repr[BUFFSIZE_LARGE];
+	size_t len = 0, i;
+	tokenseq_t *s;
+	token_t *t;
+
+	// A comment far longer than any fixed-size line buffer.
+	len += sprintf(src + len, "// ");
+	memset(src + len, 'x', padding);
+	len += padding;
+	len += sprintf(src + len, "\r\n@LOOP\r\n\n   \t\n(LOOP) // A label.\r\n");
+	// An instruction preceded by a long run of whitespaces.
+	memset(src + len, ' ', padding);
+	len += padding;
+	len += sprintf(src + len, "D=D-1;JGT\n//\n@17\nM=D");
+	// Bytes past `len' must be ignored.
+	strcpy(src + len, "\nD=A");
+
+	if ((s = n2t_tokenize_buffer(src, len)) == NULL) {
+		snprintf(errmsg, maxwrite, "Could not tokenize the buffer.");
+
+		return 1;
+	}
+
+	for (i = 0; i < s->next && i < exp_no; i++) {
+		t = n2t_tokenseq_index_get(s, i);
+
+		if (t->type == INSTR) {
+			n2t_instr_to_str(
+				t->data.instr, s->labels, actual_repr, BUFFSIZE_LARGE
+			);
+		} else {
+			snprintf(
+				actual_repr, BUFFSIZE_LARGE, "(%s)",
+				n2t_strtable_get(s->labels, t->data.label.label)
+			);
+		}
+
+		if (strcmp(actual_repr, exp_reprs[i])) {
+			snprintf(
+				errmsg, maxwrite, "Token %lu is `%s' rather than `%s'.", i,
+				actual_repr, exp_reprs[i]
+			);
+			n2t_tokenseq_free(s);
+
+			return 1;
+		}
+	}
+
+	if (s->next != exp_no) {
+		snprintf(
+			errmsg, maxwrite, "%u tokens were read, but %lu expected.",
+			s->next, exp_no
+		);
+		n2t_tokenseq_free(s);
+
+		return 1;
+	}
+
+	n2t_tokenseq_free(s);
+
+	return 0;
+}
+
 int test_batch_back_translation(
 	void *const args, char errmsg[], size_t maxwrite
 ) {
@@ -382,9 +816,14 @@ int test_back_translation(void *const args, char errmsg[], size_t maxwrite) {
 		}
 
 		if (t->type == INSTR) {
-			n2t_instr_to_str(t->data.instr, actual_repr, BUFFSIZE_LARGE);
+			n2t_instr_to_str(
+				t->data.instr, s->labels, actual_repr, BUFFSIZE_LARGE
+			);
 		} else if (t->type == LABEL) {
-			snprintf(actual_repr, BUFFSIZE_LARGE, "(%s)", t->data.label.label);
+			snprintf(
+				actual_repr, BUFFSIZE_LARGE, "(%s)",
+				n2t_strtable_get(s->labels, t->data.label.label)
+			);
 		} else {
 			snprintf(
 				errmsg, maxwrite,
@@ -513,34 +952,61 @@ int test_n2t_memcache_index_fetch(
 int test_n2t_memcache_extend(
 	void *const args, char errmsg[], size_t maxwrite
 ) {
-	size_t nmemb = 1000, membsize = 1, last;
-	int8_t const check = 0xFF;
-	int8_t *actual;
+	size_t const nmemb = 1000;
+	uint32_t const membsize = 3;
 	memcache_t *c = n2t_memcache_alloc(1, membsize);
+	uint8_t value[membsize];
+	void *stored[nmemb];
+	uint32_t length;
+	size_t i, j;
 
-	for (last = c->length; last < nmemb; last++) {
-		// This might ensure no segmentation faults are caused.
-		memset(c->head + MEMCACHE_OFFSET(c, last - 1), check, membsize);
-		n2t_memcache_extend(c, 1);
+	for (i = 0; i < nmemb; i++) {
+		// Every extension appends a new chunk, so only a few are requested
+		// explicitly. The other ones are triggered by storing objects.
+		if (i % 100 == 0) {
+			length = c->length;
+
+			if (n2t_memcache_extend(c, i) || c->length < length + i) {
+				snprintf(
+					errmsg, maxwrite, "`c->length' = %u, but at least %lu was"
+					" expected.", c->length, length + i
+				);
+				n2t_memcache_free(c);
+
+				return 1;
+			}
+		}
 
-		if (c->length != last + 1) {
-			snprintf(
-				errmsg, maxwrite, "`c->length' = %u, but %lu was expected.",
-				c->length, last + 1
-			);
+		memset(value, i % 0xFF, membsize);
+		value[0] = i & 0xFF;
+		value[1] = i >> 8;
+		n2t_memcache_store(c, value, membsize);
+		stored[i] = n2t_memcache_index_fetch(c, i);
+	}
+
+	// Growing the cache must have neither moved nor altered any object.
+	for (i = 0; i < nmemb; i++) {
+		memset(value, i % 0xFF, membsize);
+		value[0] = i & 0xFF;
+		value[1] = i >> 8;
+
+		if (stored[i] != n2t_memcache_index_fetch(c, i)) {
+			snprintf(errmsg, maxwrite, "Object at index %lu was moved.", i);
+			n2t_memcache_free(c);
 
 			return 1;
 		}
 
-		actual = c->head + MEMCACHE_OFFSET(c, last - 1);
-		
-		if (*actual != check) {
-			snprintf(
-				errmsg, maxwrite, "Value at index %lu = %d != %d.",
-				last - 1, *actual, check
-			);
+		for (j = 0; j < membsize; j++) {
+			if (((uint8_t*) stored[i])[j] != value[j]) {
+				snprintf(
+					errmsg, maxwrite, "Value at index %lu, byte %lu = %d !="
+					" %d.", i, j, ((uint8_t*) stored[i])[j], value[j]
+				);
+				n2t_memcache_free(c);
 
-			return 1;
+				return 1;
+			}
 		}
 	}
 
@@ -549,67 +1015,1724 @@ int test_n2t_memcache_extend(
 	return 0;
 }
 
+int test_n2t_memcache_index_of(
+	void *const args, char errmsg[], size_t maxwrite
+) {
+	// Starting from a single unit forces the hash index to be rebuilt several
+	// times along the way.
+	size_t nmemb = 50000, i;
+	memcache_t *c = n2t_memcache_alloc(1, sizeof(int64_t));
+	int64_t temp, index;
+	int32_t narrow;
 
-// assembler.c
-int test_assembler_batch(void *const args, char errmsg[], size_t maxwrite) {
-	char *filenames[] = {
-		"Add.asm", "Max.asm", "MaxL.asm", "Pong.asm", "PongL.asm", "Rect.asm",
-		"RectL.asm"
-	};
-	char
-		test_dir[BUFFSIZE_LARGE],
-		filepath[BUFFSIZE_LARGE], hack_filepath[BUFFSIZE_LARGE],
-		*subcall_args[2];
-	size_t filenames_no = sizeof(filenames) / sizeof(char*);
-	size_t i;
-
-	n2t_join(
-		test_dir, BUFFSIZE_LARGE, 2, TEST_DIR_ROOT, "test_assembler_batch/"
-	);
-
-	for (i = 0; i < filenames_no; i++) {
-		n2t_join(filepath, BUFFSIZE_LARGE, 2, test_dir, filenames[i]);
-		n2t_join(hack_filepath, BUFFSIZE_LARGE, 2, test_dir, filenames[i]);
-
-		*index(hack_filepath, '.') = '\0';
-		strcat(hack_filepath, ".hack");
+	for (i = 0; i < nmemb; i++) {
+		temp = i * 3;
 
-		subcall_args[0] = filepath;
-		subcall_args[1] = hack_filepath;
+		if (n2t_memcache_store(c, &temp, sizeof(temp)) != i) {
+			snprintf(errmsg, maxwrite, "Could not store value %ld.", temp);
+			n2t_memcache_free(c);
 
-		if (test_assembler(subcall_args, errmsg, maxwrite))
 			return 1;
+		}
 	}
 
-	return 0;
-}
+	for (i = 0; i < nmemb; i++) {
+		temp = i * 3;
 
-int test_assembler(void *const args, char errmsg[], size_t maxwrite) {
-	char **argv = args;
-	char
-		exp[BITSTR_BUFFSIZE + 2], actual[BITSTR_BUFFSIZE + 1],
-		instr_repr[BUFFSIZE_MED];
-	tokenseq_t *s;
-	token_t *t;
+		if ((index = n2t_memcache_index_of(c, &temp, sizeof(temp))) != i) {
+			snprintf(
+				errmsg, maxwrite, "Value %ld found at index %ld, not %lu.",
+				temp, index, i
+			);
+			n2t_memcache_free(c);
 
-	FILE *exp_stream;
-	size_t i, actual_lineno = 0, exp_lineno = 0;
+			return 1;
+		}
 
-	if ((s = n2t_parse(argv[0])) == NULL) {
-		snprintf(errmsg, maxwrite, "Could not parse `%s'.", argv[0]);
+		// Values that were never stored must not be found.
+		temp = i * 3 + 1;
 
-		return 1;
+		if (n2t_memcache_index_of(c, &temp, sizeof(temp)) != -1) {
+			snprintf(errmsg, maxwrite, "Value %ld was never stored.", temp);
+			n2t_memcache_free(c);
+
+			return 1;
+		}
 	}
 
-	if ((exp_stream = fopen(argv[1], "rt")) == NULL) {
-		snprintf(errmsg, maxwrite, "Could not open `%s'.", argv[1]);
-		n2t_tokenseq_free(s);
+	// Duplicates are refused, and shorter objects are zero-padded.
+	temp = 0;
+	narrow = 3;
+
+	if (
+		n2t_memcache_store(c, &temp, sizeof(temp)) != -3 ||
+		n2t_memcache_index_of(c, &narrow, sizeof(narrow)) != 1
+	) {
+		snprintf(errmsg, maxwrite, "Duplicates were not detected.");
+		n2t_memcache_free(c);
 
 		return 1;
 	}
 
-	for (i = 0; i < s->next; i++) {
-		t = n2t_tokenseq_index_get(s, i);
+	n2t_memcache_free(c);
+
+	return 0;
+}
+
+int test_n2t_memcache_intern(void *const args, char errmsg[], size_t maxwrite) {
+	char const *source[] = {
+		"aaaaaaaaaa", "bbbbbbbbbb", "cccccccccc", "dddddddddd", "eeeeeeeeee"
+	};
+	size_t const strsize = 11, sourcesize = 5, rounds = 100;
+	memcache_t *c = n2t_memcache_alloc(1, BUFFSIZE_SMALL);
+	int64_t index;
+	size_t i;
+
+	for (i = 0; i < rounds * sourcesize; i++) {
+		index = n2t_memcache_intern(c, source[i % sourcesize], strsize);
+
+		// The first occurrence of each string is inserted, and all of the
+		// following ones resolve to that same index.
+		if (index != i % sourcesize) {
+			snprintf(
+				errmsg, maxwrite, "`%s' interned at %ld rather than %lu.",
+				source[i % sourcesize], index, i % sourcesize
+			);
+			n2t_memcache_free(c);
+
+			return 1;
+		}
+	}
+
+	if (c->next != sourcesize) {
+		snprintf(
+			errmsg, maxwrite, "%u objects stored, but %lu had to.", c->next,
+			sourcesize
+		);
+		n2t_memcache_free(c);
+
+		return 1;
+	}
+
+	n2t_memcache_free(c);
+
+	return 0;
+}
+
+
+// strtable.h
+int test_n2t_strtable_intern(void *const args, char errmsg[], size_t maxwrite) {
+	// Labels are read out of the middle of a line, hence not null-terminated.
+	char const *line = "LOOP END LOOP END.1 ";
+	size_t const offsets[] = {0, 5, 9, 14}, lengths[] = {4, 3, 4, 5};
+	int64_t const exp_ids[] = {1, 2, 1, 3};
+	char const *exp_strings[] = {"LOOP", "END", "LOOP", "END.1"};
+	// Long names straddle size classes, some differing in their last byte.
+	size_t const long_lengths[] = {
+		STRTABLE_UNITSIZE, STRTABLE_UNITSIZE, 2 * STRTABLE_UNITSIZE - 1,
+		2 * STRTABLE_UNITSIZE, 5 * STRTABLE_UNITSIZE
+	};
+	int64_t long_ids[sizeof(long_lengths) / sizeof(size_t)];
+	char longname[5 * STRTABLE_UNITSIZE + 1];
+	strtable_t *t = n2t_strtable_alloc(1);
+	int64_t id;
+	size_t i;
+
+	for (i = 0; i < sizeof(offsets) / sizeof(size_t); i++) {
+		id = n2t_strtable_intern(t, line + offsets[i], lengths[i]);
+
+		if (id != exp_ids[i]) {
+			snprintf(
+				errmsg, maxwrite, "`%s' was given id %ld, not %ld.",
+				exp_strings[i], id, exp_ids[i]
+			);
+			n2t_strtable_free(t);
+
+			return 1;
+		}
+
+		if (strcmp(n2t_strtable_get(t, id), exp_strings[i])) {
+			snprintf(
+				errmsg, maxwrite, "Id %ld maps to `%s', not `%s'.", id,
+				n2t_strtable_get(t, id), exp_strings[i]
+			);
+			n2t_strtable_free(t);
+
+			return 1;
+		}
+	}
+
+	if (
+		n2t_strtable_length(t) != 4 ||
+		strcmp(n2t_strtable_get(t, STRTABLE_EMPTY), "") ||
+		n2t_strtable_find(t, "END", 3) != 2 ||
+		n2t_strtable_find(t, "START", 5) != -1
+	) {
+		snprintf(errmsg, maxwrite, "Unexpected lookup results.");
+		n2t_strtable_free(t);
+
+		return 1;
+	}
+
+	memset(longname, 'a', sizeof(longname));
+
+	if (n2t_strtable_find(t, longname, STRTABLE_UNITSIZE) != -1) {
+		snprintf(errmsg, maxwrite, "A long name was found before interning.");
+		n2t_strtable_free(t);
+
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(long_lengths) / sizeof(size_t); i++) {
+		longname[long_lengths[i] - 1] = 'a' + i % 2;
+		long_ids[i] = n2t_strtable_intern(t, longname, long_lengths[i]);
+		longname[long_lengths[i] - 1] = 'a';
+
+		if (long_ids[i] != 4 + (int64_t) i) {
+			snprintf(
+				errmsg, maxwrite, "Long name %lu was given id %ld, not %ld.", i,
+				long_ids[i], 4 + (int64_t) i
+			);
+			n2t_strtable_free(t);
+
+			return 1;
+		}
+	}
+
+	for (i = 0; i < sizeof(long_lengths) / sizeof(size_t); i++) {
+		longname[long_lengths[i] - 1] = 'a' + i % 2;
+
+		if (
+			n2t_strtable_intern(t, longname, long_lengths[i]) != long_ids[i] ||
+			n2t_strtable_find(t, longname, long_lengths[i]) != long_ids[i] ||
+			strlen(n2t_strtable_get(t, long_ids[i])) != long_lengths[i] ||
+			memcmp(
+				n2t_strtable_get(t, long_ids[i]), longname, long_lengths[i]
+			)
+		) {
+			snprintf(
+				errmsg, maxwrite, "Long name %lu does not map back to id %ld.",
+				i, long_ids[i]
+			);
+			n2t_strtable_free(t);
+
+			return 1;
+		}
+
+		longname[long_lengths[i] - 1] = 'a';
+	}
+
+	n2t_strtable_free(t);
+
+	return 0;
+}
+
+
+// arena.h
+int test_n2t_arena_push(void *const args, char errmsg[], size_t maxwrite) {
+	char const *const path = TEST_DIR_ROOT "test_assembler_batch/Pong.asm";
+	arena_t *a = n2t_arena_alloc(0);
+	parseopts_t opts = {NULL, 0, 0, NULL};
+	word_t *exp_words = NULL, *words = NULL;
+	tokenseq_t *s;
+	uint32_t from;
+	size_t exp_no = 0, n = 0, nblocks, i;
+	char *p, *q;
+	int error = 1;
+
+	if (a == NULL) {
+		snprintf(errmsg, maxwrite, "Could not allocate an arena.");
+
+		return 1;
+	}
+
+	p = n2t_arena_push(a, 3);
+	q = n2t_arena_push(a, 5);
+
+	if (
+		p == NULL || q == NULL || (uintptr_t) p % ARENA_ALIGN ||
+		(uintptr_t) q % ARENA_ALIGN
+	) {
+		snprintf(errmsg, maxwrite, "Allocations are not aligned.");
+	} else if (n2t_arena_resize(a, q, 5, 100) != q) {
+		snprintf(errmsg, maxwrite, "The last allocation was moved.");
+	} else if (
+		(q = n2t_arena_resize(a, p, 3, 50)) == p || q == NULL ||
+		memcmp(q, p, 3)
+	) {
+		snprintf(errmsg, maxwrite, "An earlier allocation grew in place.");
+	} else {
+		// Spilling over into more blocks.
+		for (i = 0; i < 4 && n2t_arena_push(a, ARENA_MIN_BLOCK); i++);
+
+		n2t_arena_reset(a);
+		nblocks = a->nblocks;
+
+		for (i = 0; i < 4 && n2t_arena_push(a, ARENA_MIN_BLOCK); i++);
+
+		if (i < 4 || a->block->prev != NULL || a->nblocks != nblocks) {
+			snprintf(errmsg, maxwrite, "The reset arena spilled over again.");
+		} else {
+			error = 0;
+		}
+	}
+
+	n2t_arena_reset(a);
+
+	if (!error && (s = n2t_parse_with(path, &opts, errmsg, maxwrite))) {
+		from = 0;
+		exp_words = malloc(s->next * sizeof(word_t));
+		exp_no = n2t_tokenseq_encode(s, &from, exp_words, s->next);
+		n2t_tokenseq_free(s);
+
+		opts.arena = a;
+
+		if ((s = n2t_parse_with(path, &opts, errmsg, maxwrite))) {
+			from = 0;
+			words = malloc(s->next * sizeof(word_t));
+			n = n2t_tokenseq_encode(s, &from, words, s->next);
+			n2t_tokenseq_free(s);
+		}
+
+		if (
+			s == NULL || n != exp_no ||
+			memcmp(words, exp_words, n * sizeof(word_t))
+		) {
+			snprintf(
+				errmsg, maxwrite, "Parsed %lu words within an arena, "
+				"differing from the %lu parsed on the heap.", n, exp_no
+			);
+			error = 1;
+		}
+	} else {
+		error = 1;
+	}
+
+	n2t_arena_free(a);
+	free(exp_words);
+	free(words);
+
+	return error;
+}
+
+
+// linescan.h
+int test_n2t_linescan_next(void *const args, char errmsg[], size_t maxwrite) {
+	linescan_kernel_t const kernels[] = {
+		LINESCAN_SCALAR, LINESCAN_SSE2, LINESCAN_AVX2
+	};
+	char const *kernel_names[] = {"scalar", "SSE2", "AVX2"};
+	char const *lines[] = {
+		"@1", "D=M // A comment / with // slashes", "/", "a/b//x//y", "//",
+		"", "  \r", "0;JMP/", "M=D //end"
+	};
+	size_t const kernels_no = sizeof(kernels) / sizeof(linescan_kernel_t);
+	size_t const lines_no = sizeof(lines) / sizeof(char*);
+	// Enough copies for comment openings and newlines to fall on every offset
+	// within a 32-byte block.
+	size_t const rounds = 40, batch = 3;
+
+	char src[BUFFSIZE_XLARGE * 8], *comment;
+	linespan_t exp_spans[BUFFSIZE_XLARGE], spans[BUFFSIZE_XLARGE];
+	size_t len = 0, exp_no = 0, actual_no, n, i, j;
+	linescan_t scan;
+
+	for (i = 0; i < rounds; i++) {
+		for (j = 0; j < lines_no; j++) {
+			// A run of `i' spaces shifts the subsequent lines by one byte per
+			// round.
+			exp_spans[exp_no].start = len;
+			len += sprintf(src + len, "%*s%s\n", (int) (i % 7), "", lines[j]);
+			comment = strstr(src + exp_spans[exp_no].start, "//");
+			exp_spans[exp_no].cut = comment && comment < src + len ?
+				comment - src: len - 1;
+			exp_no++;
+		}
+	}
+	// The last line is not terminated by a newline.
+	len--;
+
+	for (i = 0; i < kernels_no; i++) {
+		if (!n2t_linescan_supported(kernels[i]))
+			continue;
+		if (n2t_linescan_init(&scan, src, len, kernels[i])) {
+			snprintf(
+				errmsg, maxwrite, "Could not set up the %s kernel.",
+				kernel_names[i]
+			);
+
+			return 1;
+		}
+
+		for (
+			actual_no = 0;
+			(n = n2t_linescan_next(&scan, spans + actual_no, batch)) > 0;
+			actual_no += n
+		) {
+			if (actual_no + n > exp_no) {
+				snprintf(
+					errmsg, maxwrite, "The %s kernel reported too many lines.",
+					kernel_names[i]
+				);
+
+				return 1;
+			}
+		}
+
+		if (actual_no != exp_no) {
+			snprintf(
+				errmsg, maxwrite, "The %s kernel reported %lu lines, not %lu.",
+				kernel_names[i], actual_no, exp_no
+			);
+
+			return 1;
+		}
+
+		for (j = 0; j < exp_no; j++) {
+			if (
+				spans[j].start != exp_spans[j].start ||
+				spans[j].cut != exp_spans[j].cut
+			) {
+				snprintf(
+					errmsg, maxwrite,
+					"The %s kernel split line %lu as [%u, %u) not [%u, %u).",
+					kernel_names[i], j, spans[j].start, spans[j].cut,
+					exp_spans[j].start, exp_spans[j].cut
+				);
+
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+
+// romimage.h
+int test_n2t_romimage_open(void *const args, char errmsg[], size_t maxwrite) {
+	word_t const words[] = {0x0000, 0x0001, 0x7FFF, 0xEC10, 0xFC88, 0xA5A5};
+	size_t const words_no = sizeof(words) / sizeof(word_t);
+	romendian_t const endians[] = {ROMIMAGE_LITTLE, ROMIMAGE_BIG};
+	char path[] = "/tmp/n2t_romimage_XXXXXX";
+	uint8_t image[ROMIMAGE_HEADER_SIZE + sizeof(words)];
+	romimage_t r;
+	size_t length, e, header, i;
+	int fd;
+
+	if ((fd = mkstemp(path)) < 0) {
+		snprintf(errmsg, maxwrite, "Could not create a temporary file.");
+
+		return 1;
+	}
+
+	for (e = 0; e < 2; e++) {
+		for (header = 0; header < 2; header++) {
+			length = n2t_romimage_write(
+				words, words_no, endians[e], header, image
+			);
+
+			if (
+				length != n2t_romimage_size(words_no, header) ||
+				ftruncate(fd, 0) || pwrite(fd, image, length, 0) != length
+			) {
+				snprintf(errmsg, maxwrite, "Could not write the image.");
+				close(fd);
+				unlink(path);
+
+				return 1;
+			}
+
+			// The byte order must be read from the header, if any.
+			if (
+				n2t_romimage_open(
+					path, header ? endians[1 - e]: endians[e], header, &r
+				)
+			) {
+				snprintf(
+					errmsg, maxwrite, "Could not open the image (endian %lu, "
+					"header %lu).", e, header
+				);
+				close(fd);
+				unlink(path);
+
+				return 1;
+			}
+
+			for (i = 0; i < words_no && r.nwords == words_no; i++) {
+				if (n2t_romimage_word(&r, i) != words[i])
+					break;
+			}
+
+			n2t_romimage_close(&r);
+
+			if (i < words_no) {
+				snprintf(
+					errmsg, maxwrite, "Word %lu of the image (endian %lu, "
+					"header %lu) does not match.", i, e, header
+				);
+				close(fd);
+				unlink(path);
+
+				return 1;
+			}
+		}
+	}
+
+	// Flipping a single bit of the last word must break the checksum.
+	image[length - 1] ^= 1;
+
+	if (
+		pwrite(fd, image, length, 0) != length ||
+		!n2t_romimage_open(path, ROMIMAGE_LITTLE, 1, &r)
+	) {
+		snprintf(errmsg, maxwrite, "A corrupted image was accepted.");
+		close(fd);
+		unlink(path);
+
+		return 1;
+	}
+
+	close(fd);
+	unlink(path);
+
+	return 0;
+}
+
+
+// hash.h
+int test_n2t_hash64(void *const args, char errmsg[], size_t maxwrite) {
+	// Digests of the reference implementation, with seed `0'.
+	char const *inputs[] = {
+		"", "a", "abc", "Nobody inspects the spammish repetition"
+	};
+	uint64_t const digests[] = {
+		0xEF46DB3751D8E999ULL, 0xD24EC4F1A98C6E5BULL, 0x44BC2CF5AD770999ULL,
+		0xFBCEA83C8A378BF1ULL
+	};
+	size_t const inputs_no = sizeof(inputs) / sizeof(char*);
+	size_t i;
+
+	for (i = 0; i < inputs_no; i++) {
+		if (n2t_hash64(inputs[i], strlen(inputs[i]), 0) != digests[i]) {
+			snprintf(
+				errmsg, maxwrite, "Wrong digest of `%s'.", inputs[i]
+			);
+
+			return 1;
+		}
+	}
+
+	if (n2t_hash64("abc", 3, 1) == digests[2]) {
+		snprintf(errmsg, maxwrite, "The seed does not affect the digest.");
+
+		return 1;
+	}
+
+	return 0;
+}
+
+
+// cache.h
+int test_n2t_cache_fetch(void *const args, char errmsg[], size_t maxwrite) {
+	char dir[] = "/tmp/n2t_cache_XXXXXX";
+	char cache_dir[BUFFSIZE_LARGE], output[BUFFSIZE_LARGE];
+	char entry[BUFFSIZE_VLARGE];
+	char const data[] = "0000000000000101\n";
+	cache_t c;
+	struct stat before, after;
+	size_t length = 0;
+	int error = 1;
+
+	if (mkdtemp(dir) == NULL) {
+		snprintf(errmsg, maxwrite, "Could not create a temporary directory.");
+
+		return 1;
+	}
+
+	n2t_join(cache_dir, BUFFSIZE_LARGE, 2, dir, "/cache");
+	n2t_join(output, BUFFSIZE_LARGE, 2, dir, "/Out.hack");
+
+	// Evicting down to three quarters of the limit leaves room for one entry.
+	if (n2t_cache_open(cache_dir, 2 * (sizeof(data) - 1) - 1, &c)) {
+		snprintf(errmsg, maxwrite, "Could not open `%s'.", cache_dir);
+		rmdir(dir);
+
+		return 1;
+	}
+
+	if (n2t_cache_fetch(&c, 1, output, &length) != CACHE_MISS) {
+		snprintf(errmsg, maxwrite, "Hit on an empty cache.");
+	} else if (n2t_cache_store(&c, 1, data, sizeof(data) - 1, output)) {
+		snprintf(errmsg, maxwrite, "Could not store an entry.");
+	} else if (
+		unlink(output) || n2t_cache_fetch(&c, 1, output, &length) ||
+		length != sizeof(data) - 1 || stat(output, &before)
+	) {
+		snprintf(errmsg, maxwrite, "Could not fetch a stored entry.");
+	} else if (
+		n2t_cache_fetch(&c, 1, output, &length) || stat(output, &after) ||
+		before.st_mtim.tv_sec != after.st_mtim.tv_sec ||
+		before.st_mtim.tv_nsec != after.st_mtim.tv_nsec ||
+		c.stats.unchanged != 1
+	) {
+		snprintf(errmsg, maxwrite, "An identical output was rewritten.");
+	} else if (
+		n2t_cache_store(&c, 2, data, sizeof(data) - 1, output) ||
+		n2t_cache_fetch(&c, 1, output, &length) != CACHE_MISS ||
+		n2t_cache_fetch(&c, 2, output, &length) ||
+		c.stats.evicted != 1 || c.stats.hits != 3 || c.stats.misses != 2
+	) {
+		snprintf(errmsg, maxwrite, "The size limit was not enforced.");
+	} else {
+		error = 0;
+	}
+
+	n2t_cache_close(&c);
+
+	snprintf(entry, BUFFSIZE_VLARGE, "%s/%016x", cache_dir, 1);
+	unlink(entry);
+	snprintf(entry, BUFFSIZE_VLARGE, "%s/%016x", cache_dir, 2);
+	unlink(entry);
+	unlink(output);
+	rmdir(cache_dir);
+	rmdir(dir);
+
+	return error;
+}
+
+
+// pool.h
+/**
+ * Argument of the tasks run by `test_n2t_pool_submit()': the program at
+ * `filepath' is parsed and its words encoded into `words', holding room for
+ * `capacity' of them.
+ */
+typedef struct {
+	char const *filepath;
+	word_t *words;
+	size_t capacity, nwords;
+	int error;
+} parsetask_t;
+
+/**
+ * Pool task parsing and encoding the `parsetask_t' at `task'.
+ */
+static void parse_task(void *task) {
+	parsetask_t *const t = task;
+	tokenseq_t *s;
+	uint32_t from = 0;
+
+	if ((s = n2t_parse(t->filepath, NULL, 0)) == NULL) {
+		t->error = 1;
+		return;
+	}
+
+	t->nwords = n2t_tokenseq_encode(s, &from, t->words, t->capacity);
+	t->error = from != s->next;
+	n2t_tokenseq_free(s);
+}
+
+int test_n2t_pool_submit(void *const args, char errmsg[], size_t maxwrite) {
+	char *filenames[] = {
+		"Pong.asm", "Add.asm", "PongL.asm", "Max.asm", "Rect.asm", "MaxL.asm"
+	};
+	size_t const filenames_no = sizeof(filenames) / sizeof(char*);
+	size_t const tasks_no = 4 * filenames_no, capacity = 1 << 15;
+	char filepaths[filenames_no][BUFFSIZE_LARGE];
+	parsetask_t tasks[tasks_no];
+	word_t *words = malloc(tasks_no * capacity * sizeof(word_t));
+	pool_t *pool = n2t_pool_alloc(4);
+	size_t i;
+	int error = 0;
+
+	if (words == NULL || pool == NULL) {
+		snprintf(errmsg, maxwrite, "Could not start the pool.");
+		free(words);
+
+		if (pool)
+			n2t_pool_free(pool);
+
+		return 1;
+	}
+
+	for (i = 0; i < tasks_no; i++) {
+		if (i < filenames_no) {
+			n2t_join(
+				filepaths[i], BUFFSIZE_LARGE, 3, TEST_DIR_ROOT,
+				"test_assembler_batch/", filenames[i]
+			);
+		}
+
+		tasks[i].filepath = filepaths[i % filenames_no];
+		tasks[i].words = words + i * capacity;
+		tasks[i].capacity = capacity;
+		tasks[i].nwords = 0;
+		tasks[i].error = 0;
+
+		// The last round is queued while the previous ones are running.
+		if (i == 3 * filenames_no)
+			n2t_pool_wait(pool);
+
+		if (n2t_pool_submit(pool, parse_task, tasks + i)) {
+			snprintf(errmsg, maxwrite, "Could not submit task %lu.", i);
+			error = 1;
+			break;
+		}
+	}
+
+	n2t_pool_free(pool);
+
+	// Every program parsed concurrently must match its first parse.
+	for (i = 0; i < tasks_no && !error; i++) {
+		if (tasks[i].error) {
+			snprintf(
+				errmsg, maxwrite, "Task %lu could not parse `%s'.", i,
+				tasks[i].filepath
+			);
+			error = 1;
+		} else if (
+			tasks[i].nwords != tasks[i % filenames_no].nwords || memcmp(
+				tasks[i].words, tasks[i % filenames_no].words,
+				tasks[i].nwords * sizeof(word_t)
+			)
+		) {
+			snprintf(
+				errmsg, maxwrite, "Task %lu did not assemble `%s' as task "
+				"%lu.", i, tasks[i].filepath, i % filenames_no
+			);
+			error = 1;
+		}
+	}
+
+	free(words);
+
+	return error;
+}
+
+
+// parser.h
+int test_n2t_parse_duplicate_label(
+	void *const args, char errmsg[], size_t maxwrite
+) {
+	char filepath[BUFFSIZE_LARGE], parse_errmsg[BUFFSIZE_VLARGE];
+	tokenseq_t *s;
+
+	n2t_join(
+		filepath, BUFFSIZE_LARGE, 2, TEST_DIR_ROOT,
+		"test_parse_errors/DuplicateLabel.asm"
+	);
+
+	if ((s = n2t_parse(filepath, parse_errmsg, BUFFSIZE_VLARGE))) {
+		snprintf(errmsg, maxwrite, "`%s' was parsed successfully.", filepath);
+		n2t_tokenseq_free(s);
+
+		return 1;
+	}
+
+	if (strstr(parse_errmsg, "`LOOP'") == NULL) {
+		snprintf(
+			errmsg, maxwrite, "Unexpected error message: `%s'.", parse_errmsg
+		);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+int test_n2t_parse_with_predefs(
+	void *const args, char errmsg[], size_t maxwrite
+) {
+	ramvar_t const predefs[] = {{"FOO", 1234}, {"SP", 7}};
+	parseopts_t const opts = {predefs, sizeof(predefs) / sizeof(ramvar_t)};
+	// `@SP', `@R15', `@SCREEN', `@FOO', `@counter', `@BAR', `@counter' and
+	// `@R1', the latter shadowed by the `(R1)' label.
+	word_t const exp_locations[] = {7, 15, 16384, 1234, 16, 17, 16, 7};
+	char filepath[BUFFSIZE_LARGE], parse_errmsg[BUFFSIZE_VLARGE];
+	tokenseq_t *s;
+	token_t *t;
+	size_t i, instrs = 0;
+
+	n2t_join(
+		filepath, BUFFSIZE_LARGE, 2, TEST_DIR_ROOT,
+		"test_parse_predefs/Predefs.asm"
+	);
+
+	s = n2t_parse_with(filepath, &opts, parse_errmsg, BUFFSIZE_VLARGE);
+
+	if (s == NULL) {
+		snprintf(errmsg, maxwrite, "Could not parse: %s.", parse_errmsg);
+
+		return 1;
+	}
+
+	for (i = 0; i < s->next; i++) {
+		t = n2t_tokenseq_index_get(s, i);
+
+		if (t->type != INSTR)
+			continue;
+
+		if (
+			instrs >= sizeof(exp_locations) / sizeof(word_t) ||
+			t->data.instr.instr.a.memptr.location != exp_locations[instrs]
+		) {
+			snprintf(
+				errmsg, maxwrite, "Instruction %lu refers to %u.", instrs,
+				t->data.instr.instr.a.memptr.location
+			);
+			n2t_tokenseq_free(s);
+
+			return 1;
+		}
+
+		instrs++;
+	}
+
+	n2t_tokenseq_free(s);
+
+	return 0;
+}
+
+
+/**
+ * A `wordsink_t' appending words to the `words_collector_t' at `arg'.
+ */
+typedef struct {
+	word_t *words;
+	size_t n, capacity;
+} words_collector_t;
+
+static int collect_words(word_t const *words, size_t n, void *arg) {
+	words_collector_t *c = arg;
+
+	if (c->n + n > c->capacity)
+		return 1;
+
+	memcpy(c->words + c->n, words, n * sizeof(word_t));
+	c->n += n;
+
+	return 0;
+}
+
+int test_n2t_parse_stream(void *const args, char errmsg[], size_t maxwrite) {
+	char const *const path = TEST_DIR_ROOT "test_assembler_batch/Pong.asm";
+	ramvar_t const predefs[] = {{"ball.new", 100}};
+	parseopts_t const opts = {predefs, 1};
+	words_collector_t c = {NULL, 0, 0};
+	word_t *exp_words;
+	tokenseq_t *s;
+	uint32_t from = 0;
+	size_t exp_no;
+
+	if ((s = n2t_parse_with(path, &opts, errmsg, maxwrite)) == NULL)
+		return 1;
+
+	exp_words = malloc(s->next * sizeof(word_t));
+	c.words = malloc(s->next * sizeof(word_t));
+	c.capacity = s->next;
+	exp_no = n2t_tokenseq_encode(s, &from, exp_words, s->next);
+	n2t_tokenseq_free(s);
+
+	if (n2t_parse_stream(path, &opts, collect_words, &c, errmsg, maxwrite)) {
+		free(exp_words);
+		free(c.words);
+
+		return 1;
+	}
+
+	if (c.n != exp_no || memcmp(c.words, exp_words, exp_no * sizeof(word_t))) {
+		snprintf(
+			errmsg, maxwrite, "Streamed %lu words, differing from the %lu "
+			"expected.", c.n, exp_no
+		);
+		free(exp_words);
+		free(c.words);
+
+		return 1;
+	}
+
+	free(exp_words);
+	free(c.words);
+
+	return 0;
+}
+
+
+int test_n2t_parse_parallel(void *const args, char errmsg[], size_t maxwrite) {
+	char const *paths[] = {
+		TEST_DIR_ROOT "test_assembler_batch/Pong.asm",
+		TEST_DIR_ROOT "test_assembler_batch/Max.asm",
+		TEST_DIR_ROOT "test_parse_predefs/Predefs.asm",
+	};
+	unsigned const nthreads[] = {2, 3, 8, 64};
+	ramvar_t const predefs[] = {{"FOO", 7}};
+	parseopts_t opts = {predefs, 1, 1};
+	word_t *exp_words = NULL, *words = NULL;
+	size_t exp_no = 0, n, i, j;
+	tokenseq_t *s;
+	uint32_t from;
+	int error = 0;
+
+	for (i = 0; i < sizeof(paths) / sizeof(char*) && !error; i++) {
+		for (j = 0; j <= sizeof(nthreads) / sizeof(unsigned) && !error; j++) {
+			// The serial path goes first, as a reference.
+			opts.nthreads = j ? nthreads[j - 1]: 1;
+
+			if ((s = n2t_parse_with(paths[i], &opts, errmsg, maxwrite)) == NULL)
+				return 1;
+
+			from = 0;
+			words = malloc((s->next + 1) * sizeof(word_t));
+			n = n2t_tokenseq_encode(s, &from, words, s->next);
+			n2t_tokenseq_free(s);
+
+			if (j == 0) {
+				exp_words = words;
+				exp_no = n;
+				continue;
+			}
+
+			if (n != exp_no || memcmp(words, exp_words, n * sizeof(word_t))) {
+				snprintf(
+					errmsg, maxwrite, "`%s' assembles differently with %u "
+					"threads.", paths[i], opts.nthreads
+				);
+				error = 1;
+			}
+
+			free(words);
+		}
+
+		free(exp_words);
+	}
+
+	if (error)
+		return 1;
+
+	opts.nthreads = 4;
+	s = n2t_parse_with(
+		TEST_DIR_ROOT "test_parse_errors/DuplicateLabel.asm", &opts, errmsg,
+		maxwrite
+	);
+
+	if (s != NULL) {
+		snprintf(errmsg, maxwrite, "A label defined twice was accepted.");
+		n2t_tokenseq_free(s);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+int test_n2t_parse_buffer(void *const args, char errmsg[], size_t maxwrite) {
+	char const *const path = TEST_DIR_ROOT "test_assembler_batch/Pong.asm";
+	ramvar_t const predefs[] = {{"ball.new", 100}};
+	parseopts_t const opts = {predefs, 1};
+	word_t *exp_words = NULL, *words = NULL;
+	size_t exp_no = 0, n = 0;
+	uint32_t from;
+	tokenseq_t *s;
+	filemap_t input;
+	int error = 1;
+
+	if (n2t_filemap_open(path, &input)) {
+		snprintf(errmsg, maxwrite, "Could not map `%s'.", path);
+
+		return 1;
+	}
+
+	if ((s = n2t_parse_with(path, &opts, errmsg, maxwrite))) {
+		from = 0;
+		exp_words = malloc(s->next * sizeof(word_t));
+		exp_no = n2t_tokenseq_encode(s, &from, exp_words, s->next);
+		n2t_tokenseq_free(s);
+	}
+
+	if (
+		exp_words &&
+		(s = n2t_parse_buffer(
+			input.data, input.length, &opts, errmsg, maxwrite
+		))
+	) {
+		from = 0;
+		words = malloc(s->next * sizeof(word_t));
+		n = n2t_tokenseq_encode(s, &from, words, s->next);
+		n2t_tokenseq_free(s);
+
+		if (n != exp_no || memcmp(words, exp_words, n * sizeof(word_t))) {
+			snprintf(
+				errmsg, maxwrite, "Parsed %lu words from memory, differing "
+				"from the %lu parsed from `%s'.", n, exp_no, path
+			);
+		} else {
+			error = 0;
+		}
+	}
+
+	n2t_filemap_close(&input);
+	free(exp_words);
+	free(words);
+
+	return error;
+}
+
+int test_n2t_parse_stats(void *const args, char errmsg[], size_t maxwrite) {
+	// `R1' shadows a predefined variable.
+	char const *const src = "@i\nM=1\n(LOOP)\n@i\nM=M+1\n@LOOP\n(R1)\n0;JMP\n"
+		"// The end.\n@j\n";
+	char const *const path = TEST_DIR_ROOT "test_assembler_batch/Pong.asm";
+	asmstats_t stats = {0}, file_stats = {0}, stream_stats = {0};
+	parseopts_t opts = {NULL, 0, 0, NULL, &stats};
+	words_collector_t c = {NULL, 0, 0};
+	tokenseq_t *s;
+	int phase;
+
+#ifdef N2T_NO_STATS
+	return 0;
+#endif
+
+	if ((s = n2t_parse_buffer(src, strlen(src), &opts, errmsg, maxwrite)))
+		n2t_tokenseq_free(s);
+	else
+		return 1;
+
+	if (
+		stats.nlines != 10 || stats.ntokens != 9 || stats.nunique != 8 ||
+		stats.nlabels != 2 || stats.nvariables != 2
+	) {
+		snprintf(
+			errmsg, maxwrite, "Counted %lu lines, %lu tokens, %lu distinct, %lu "
+			"labels and %lu variables.", stats.nlines, stats.ntokens,
+			stats.nunique, stats.nlabels, stats.nvariables
+		);
+
+		return 1;
+	}
+
+	for (phase = 0; phase < STATS_PHASES_NO; phase++) {
+		if (stats.wall[phase] < 0 || stats.cpu[phase] < 0) {
+			snprintf(
+				errmsg, maxwrite, "Phase `%s' took negative time.",
+				n2t_stats_phase_name(phase)
+			);
+
+			return 1;
+		}
+	}
+
+	// The threaded path locates labels while merging its chunks.
+	opts.nthreads = 3;
+	opts.stats = &file_stats;
+
+	if ((s = n2t_parse_with(path, &opts, errmsg, maxwrite)) == NULL)
+		return 1;
+
+	c.capacity = s->next;
+	n2t_tokenseq_free(s);
+
+	if (
+		file_stats.nlines != 28374 ||
+		file_stats.ntokens != 27483 + file_stats.nlabels ||
+		file_stats.nlabels != 882 || file_stats.nvariables != 14
+	) {
+		snprintf(
+			errmsg, maxwrite, "Counted %lu lines, %lu tokens, %lu labels and "
+			"%lu variables in `%s'.", file_stats.nlines, file_stats.ntokens,
+			file_stats.nlabels, file_stats.nvariables, path
+		);
+
+		return 1;
+	}
+
+	opts.nthreads = 0;
+	opts.stats = &stream_stats;
+
+	if ((c.words = malloc(c.capacity * sizeof(word_t))) == NULL)
+		return 1;
+
+	if (n2t_parse_stream(path, &opts, collect_words, &c, errmsg, maxwrite)) {
+		free(c.words);
+
+		return 1;
+	}
+
+	free(c.words);
+
+	if (
+		stream_stats.nlabels != file_stats.nlabels ||
+		stream_stats.nvariables != file_stats.nvariables
+	) {
+		snprintf(
+			errmsg, maxwrite, "Streaming `%s' counted %lu labels and %lu "
+			"variables.", path, stream_stats.nlabels, stream_stats.nvariables
+		);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+
+// incremental.h
+/**
+ * Checks that the words of `s' are those `n2t_parse_buffer()' assembles from
+ * the `src' string, after `s' was updated with it scanning `nscanned' lines.
+ * A negative `exp_scanned' is not checked.
+ */
+static int check_asmstate(
+	asmstate_t const *s, char const *src, size_t nscanned, long exp_scanned,
+	char errmsg[], size_t maxwrite
+) {
+	tokenseq_t *seq;
+	word_t *words;
+	uint32_t from = 0;
+	size_t n;
+	int error;
+
+	seq = n2t_parse_buffer(src, strlen(src), NULL, errmsg, maxwrite);
+
+	if (seq == NULL)
+		return 1;
+
+	words = malloc(MAX(seq->next, 1) * sizeof(word_t));
+	n = n2t_tokenseq_encode(seq, &from, words, seq->next);
+	n2t_tokenseq_free(seq);
+	error = n != s->nwords || memcmp(words, s->words, n * sizeof(word_t));
+	free(words);
+
+	if (error) {
+		snprintf(
+			errmsg, maxwrite, "The state holds %u words, differing from the "
+			"%lu parsed.", s->nwords, n
+		);
+	} else if (exp_scanned >= 0 && nscanned != (size_t)exp_scanned) {
+		snprintf(
+			errmsg, maxwrite, "Scanned %lu lines instead of %ld.", nscanned,
+			exp_scanned
+		);
+		error = 1;
+	}
+
+	return error;
+}
+
+int test_n2t_asmstate_update(void *const args, char errmsg[], size_t maxwrite) {
+	char const *const sources[] = {
+		"// Sums 1 to 100.\n@i\nM=1\n@sum\nM=0\n(LOOP)\n@i\nD=M\n@100\n"
+		"D=D-A\n@END\nD;JGT\n@i\nD=M\n@sum\nM=D+M\n@i\nM=M+1\n@LOOP\n0;JMP\n"
+		"(END)\n@END\n0;JMP\n",
+		// Edited in place.
+		"// Sums 1 to 100.\n@i\nM=1\n@sum\nM=0\n(LOOP)\n@i\nD=M\n@100\n"
+		"D=D-A\n@END\nD;JGT\n@i\nD=M\n@sum\nM=D-M // Subtracts.\n@i\n"
+		"M=M+1\n@LOOP\n0;JMP\n(END)\n@END\n0;JMP\n",
+		// Shifting the labels and allocating a variable before the others.
+		"// Sums 1 to 100.\n@extra\nM=0\n@i\nM=1\n@sum\nM=0\n(LOOP)\n@i\n"
+		"D=M\n@100\nD=D-A\n@END\nD;JGT\n@i\nD=M\n@sum\nM=D-M // Subtracts.\n"
+		"@i\nM=M+1\n@LOOP\n0;JMP\n(END)\n@END\n0;JMP\n",
+		// Shifting the labels alone.
+		"// Sums 1 to 100.\n@extra\nM=0\n@i\nM=1\n@sum\nM=0\nD=0\n(LOOP)\n"
+		"@i\nD=M\n@100\nD=D-A\n@END\nD;JGT\n@i\nD=M\n@sum\n"
+		"M=D-M // Subtracts.\n@i\nM=M+1\n@LOOP\n0;JMP\n(END)\n@END\n0;JMP\n",
+		// Renaming a label.
+		"// Sums 1 to 100.\n@extra\nM=0\n@i\nM=1\n@sum\nM=0\nD=0\n(AGAIN)\n"
+		"@i\nD=M\n@100\nD=D-A\n@END\nD;JGT\n@i\nD=M\n@sum\n"
+		"M=D-M // Subtracts.\n@i\nM=M+1\n@AGAIN\n0;JMP\n(END)\n@END\n"
+		"0;JMP\n"
+	};
+	size_t const sources_no = sizeof(sources) / sizeof(char*);
+	long const exp_scanned[] = {-1, 1, 2, 1, 2};
+	char path[] = "/tmp/n2t_asmstate_XXXXXX", renamed[BUFFSIZE_LARGE];
+	char const *const last = sources[sources_no - 1];
+	asmstate_t *s = n2t_asmstate_alloc(7), *loaded;
+	size_t i, nscanned;
+	int fd, error = 0;
+
+	if (s == NULL || (fd = mkstemp(path)) == -1) {
+		snprintf(errmsg, maxwrite, "Could not allocate a state.");
+
+		if (s)
+			n2t_asmstate_free(s);
+
+		return 1;
+	}
+
+	close(fd);
+
+	for (i = 0; i < sources_no && !error; i++) {
+		error = n2t_asmstate_update(
+			s, sources[i], strlen(sources[i]), NULL, &nscanned, errmsg,
+			maxwrite
+		) || check_asmstate(
+			s, sources[i], nscanned, exp_scanned[i], errmsg, maxwrite
+		);
+	}
+
+	// A failed update must leave the state untouched.
+	if (error) {
+		// Described by the update.
+	} else if (
+		n2t_asmstate_update(
+			s, "(END)\n(END)\n", 12, NULL, NULL, errmsg, maxwrite
+		) == 0 || check_asmstate(s, last, 0, -1, errmsg, maxwrite)
+	) {
+		snprintf(errmsg, maxwrite, "A failed update changed the state.");
+		error = 1;
+	} else if (n2t_asmstate_save(s, path)) {
+		snprintf(errmsg, maxwrite, "Could not save the state to `%s'.", path);
+		error = 1;
+	} else if ((loaded = n2t_asmstate_load(path, 8)) != NULL) {
+		snprintf(errmsg, maxwrite, "Loaded a state saved with other settings.");
+		n2t_asmstate_free(loaded);
+		error = 1;
+	} else if ((loaded = n2t_asmstate_load(path, 7)) == NULL) {
+		snprintf(errmsg, maxwrite, "Could not load the state from `%s'.", path);
+		error = 1;
+	} else {
+		error = n2t_asmstate_update(
+			loaded, last, strlen(last), NULL, &nscanned, errmsg, maxwrite
+		) || check_asmstate(loaded, last, nscanned, 0, errmsg, maxwrite);
+		n2t_asmstate_free(loaded);
+	}
+
+	// The names of labels renamed over and over must not pile up.
+	for (i = 0; i < 1000 && !error; i++) {
+		snprintf(
+			renamed, BUFFSIZE_LARGE, "@i\nM=1\n(LOOP%lu)\n@i\nM=M+1\n"
+			"@LOOP%lu\n0;JMP\n", i, i
+		);
+		error = n2t_asmstate_update(
+			s, renamed, strlen(renamed), NULL, NULL, errmsg, maxwrite
+		) || check_asmstate(s, renamed, 0, -1, errmsg, maxwrite);
+	}
+
+	if (!error && n2t_strtable_length(s->labels) > 200) {
+		snprintf(
+			errmsg, maxwrite, "%u names are kept for a program using a few.",
+			n2t_strtable_length(s->labels)
+		);
+		error = 1;
+	}
+
+	n2t_asmstate_free(s);
+	unlink(path);
+
+	return error;
+}
+
+
+// hackasm.h
+/**
+ * An output obtained through `reserve_output()', with the length asked for.
+ */
+typedef struct {
+	char *data;
+	size_t length;
+} reserved_output_t;
+
+static char* reserve_output(size_t length, void *arg) {
+	reserved_output_t *r = arg;
+
+	r->length = length;
+	r->data = malloc(length + 1);
+
+	return r->data;
+}
+
+/**
+ * Checks that emitting `source' in format `o' with `nthreads' threads yields
+ * the `exp_length' bytes at `exp', reserving exactly that many with a single
+ * thread.
+ */
+static int check_emission(
+	filemap_t const *source, emitopts_t const *o, unsigned nthreads,
+	char const *exp, size_t exp_length, char errmsg[], size_t maxwrite
+) {
+	parseopts_t const opts = {NULL, 0, nthreads};
+	reserved_output_t r = {NULL, 0};
+	tokenseq_t *s;
+	size_t nwords;
+	int error = 1;
+
+	s = n2t_parse_buffer(source->data, source->length, &opts, errmsg, maxwrite);
+
+	if (s == NULL)
+		return 1;
+
+	if (n2t_emit_tokenseq(s, o, nthreads, reserve_output, &r, &nwords)) {
+		snprintf(errmsg, maxwrite, "Could not emit with %u threads.", nthreads);
+	} else if (
+		n2t_emit_length(o, nwords) != exp_length ||
+		memcmp(r.data, exp, exp_length)
+	) {
+		snprintf(
+			errmsg, maxwrite, "%u threads emitted a different output.", nthreads
+		);
+	} else if (nthreads <= 1 && r.length != exp_length) {
+		snprintf(
+			errmsg, maxwrite, "%lu bytes were reserved for an output of %lu.",
+			r.length, exp_length
+		);
+	} else {
+		error = 0;
+	}
+
+	free(r.data);
+	n2t_tokenseq_free(s);
+
+	return error;
+}
+
+int test_n2t_assemble_buffer(void *const args, char errmsg[], size_t maxwrite) {
+	char *filenames[] = {"Max", "PongL", "Rect"};
+	size_t const filenames_no = sizeof(filenames) / sizeof(char*);
+	// `Max' has fewer tokens than 64: one thread is left per token, and those
+	// given a label have no instruction.
+	unsigned const nthreads[] = {1, 2, 3, 64};
+	size_t const nthreads_no = sizeof(nthreads) / sizeof(unsigned);
+	emitopts_t const hack = {0, 0, ROMIMAGE_LITTLE};
+	emitopts_t const image = {1, 1, ROMIMAGE_BIG};
+	char asm_path[BUFFSIZE_LARGE], hack_path[BUFFSIZE_LARGE];
+	filemap_t source, expected;
+	word_t *words;
+	char *output, *bin;
+	size_t nwords, length, bin_length, i, j;
+	int error = 0;
+
+	for (i = 0; i < filenames_no && !error; i++) {
+		n2t_join(
+			asm_path, BUFFSIZE_LARGE, 4, TEST_DIR_ROOT,
+			"test_assembler_batch/", filenames[i], ".asm"
+		);
+		n2t_join(
+			hack_path, BUFFSIZE_LARGE, 4, TEST_DIR_ROOT,
+			"test_assembler_batch/", filenames[i], ".hack"
+		);
+
+		if (n2t_filemap_open(asm_path, &source)) {
+			snprintf(errmsg, maxwrite, "Could not map `%s'.", asm_path);
+
+			return 1;
+		} else if (n2t_filemap_open(hack_path, &expected)) {
+			snprintf(errmsg, maxwrite, "Could not map `%s'.", hack_path);
+			n2t_filemap_close(&source);
+
+			return 1;
+		}
+
+		words = NULL;
+		output = bin = NULL;
+
+		if (
+			n2t_assemble_buffer(
+				source.data, source.length, NULL, &words, &nwords, errmsg,
+				maxwrite
+			) || n2t_assemble_image(
+				source.data, source.length, NULL, &hack, &output, &length,
+				errmsg, maxwrite
+			) || n2t_assemble_image(
+				source.data, source.length, NULL, &image, &bin, &bin_length,
+				errmsg, maxwrite
+			)
+		) {
+			error = 1;
+		} else if (
+			length != expected.length ||
+			memcmp(output, expected.data, length) ||
+			nwords * BITLINE_LENGTH != length
+		) {
+			snprintf(
+				errmsg, maxwrite, "`%s' was assembled differently in memory.",
+				asm_path
+			);
+			error = 1;
+		} else if (
+			bin_length != n2t_romimage_size(nwords, 1) ||
+			n2t_romimage_write(
+				words, nwords, ROMIMAGE_BIG, 1, (uint8_t*) output
+			) != bin_length || memcmp(output, bin, bin_length)
+		) {
+			snprintf(
+				errmsg, maxwrite, "The image of `%s' does not match its words.",
+				asm_path
+			);
+			error = 1;
+		}
+
+		// Every share of the output lands where a single thread puts it.
+		for (j = 0; j < nthreads_no && !error; j++) {
+			error = check_emission(
+				&source, &hack, nthreads[j], expected.data, expected.length,
+				errmsg, maxwrite
+			) || check_emission(
+				&source, &image, nthreads[j], bin, bin_length, errmsg, maxwrite
+			);
+		}
+
+		free(words);
+		free(output);
+		free(bin);
+		n2t_filemap_close(&source);
+		n2t_filemap_close(&expected);
+	}
+
+	return error;
+}
+
+
+// workload.h
+int test_n2t_workload_generate(
+	void *const args, char errmsg[], size_t maxwrite
+) {
+	// Sizes spanning past the largest address an A-instruction holds, then
+	// many short programs, whose last lines are likely to refer to labels.
+	size_t const sizes[] = {1, 1000, 80000};
+	size_t const sizes_no = sizeof(sizes) / sizeof(size_t), seeds_no = 400;
+	workload_t w;
+	word_t *words;
+	char *src, *again, *hack, *output;
+	size_t len, again_len, hacklen, nwords, i;
+	int error = 0;
+
+	for (i = 0; i < sizes_no + seeds_no && !error; i++) {
+		if (i < sizes_no) {
+			n2t_workload_defaults(&w, sizes[i], i);
+			w.label_density = i * 0.1;
+		} else {
+			n2t_workload_defaults(&w, 1 + i % 8, i);
+			w.label_density = 0.3;
+		}
+
+		if (
+			n2t_workload_generate(
+				&w, &src, &len, &hack, &hacklen, errmsg, maxwrite
+			)
+		) {
+			return 1;
+		} else if (
+			n2t_workload_generate(
+				&w, &again, &again_len, NULL, NULL, errmsg, maxwrite
+			)
+		) {
+			free(src);
+			free(hack);
+
+			return 1;
+		}
+
+		words = NULL;
+		output = NULL;
+
+		if (again_len != len || memcmp(src, again, len)) {
+			snprintf(
+				errmsg, maxwrite, "Seed %lu generated two different programs.", i
+			);
+			error = 1;
+		} else if (
+			n2t_assemble_buffer(
+				src, len, NULL, &words, &nwords, errmsg, maxwrite
+			) || (output = malloc(nwords * BITLINE_LENGTH + 1)) == NULL
+		) {
+			error = 1;
+		} else if (
+			n2t_words_to_bitlines(words, nwords, output) != hacklen ||
+			memcmp(output, hack, hacklen)
+		) {
+			snprintf(
+				errmsg, maxwrite, "The program of seed %lu was assembled "
+				"differently than expected.", i
+			);
+			error = 1;
+		}
+
+		free(src);
+		free(again);
+		free(hack);
+		free(words);
+		free(output);
+	}
+
+	return error;
+}
+
+
+// assembler.c
+int test_assembler_batch(void *const args, char errmsg[], size_t maxwrite) {
+	char *filenames[] = {
+		"Add.asm", "Max.asm", "MaxL.asm", "Pong.asm", "PongL.asm", "Rect.asm",
+		"RectL.asm"
+	};
+	char
+		test_dir[BUFFSIZE_LARGE],
+		filepath[BUFFSIZE_LARGE], hack_filepath[BUFFSIZE_LARGE],
+		*subcall_args[2];
+	size_t filenames_no = sizeof(filenames) / sizeof(char*);
+	size_t i;
+
+	n2t_join(
+		test_dir, BUFFSIZE_LARGE, 2, TEST_DIR_ROOT, "test_assembler_batch/"
+	);
+
+	for (i = 0; i < filenames_no; i++) {
+		n2t_join(filepath, BUFFSIZE_LARGE, 2, test_dir, filenames[i]);
+		n2t_join(hack_filepath, BUFFSIZE_LARGE, 2, test_dir, filenames[i]);
+
+		*index(hack_filepath, '.') = '\0';
+		strcat(hack_filepath, ".hack");
+
+		subcall_args[0] = filepath;
+		subcall_args[1] = hack_filepath;
+
+		if (test_assembler(subcall_args, errmsg, maxwrite))
+			return 1;
+	}
+
+	return 0;
+}
+
+int test_assembler_daemon(void *const args, char errmsg[], size_t maxwrite) {
+	emitopts_t const image = {1, 0, ROMIMAGE_LITTLE};
+	char
+		cwd[PATH_MAX], assembler[PATH_MAX], asm_path[PATH_MAX],
+		dir[] = "/tmp/n2t_daemon_XXXXXX", socket_path[BUFFSIZE_LARGE],
+		bin_path[BUFFSIZE_LARGE], hack_path[BUFFSIZE_LARGE], *expected = NULL;
+	filemap_t source, output;
+	struct stat info;
+	size_t length;
+	pid_t daemon, client;
+	int i, status, error = 1;
+
+	if (getcwd(cwd, PATH_MAX) == NULL || mkdtemp(dir) == NULL) {
+		snprintf(errmsg, maxwrite, "Could not create a temporary directory.");
+
+		return 1;
+	}
+
+	// The client runs from the temporary directory.
+	n2t_join(assembler, PATH_MAX, 2, cwd, "/assembler");
+	n2t_join(
+		asm_path, PATH_MAX, 3, cwd, "/" TEST_DIR_ROOT,
+		"test_assembler_batch/Max.asm"
+	);
+	n2t_join(socket_path, BUFFSIZE_LARGE, 2, dir, "/socket");
+	n2t_join(bin_path, BUFFSIZE_LARGE, 2, dir, "/Max.bin");
+	n2t_join(hack_path, BUFFSIZE_LARGE, 2, dir, "/Max.hack");
+
+	if ((daemon = fork()) == 0) {
+		freopen("/dev/null", "w", stderr);
+		execl(
+			assembler, "assembler", "--format=bin", "--serve", socket_path,
+			(char*) NULL
+		);
+		_exit(127);
+	}
+
+	// The daemon is given up to five seconds to listen.
+	for (i = 0; i < 500 && stat(socket_path, &info); i++)
+		usleep(10000);
+
+	if (daemon < 0 || i == 500) {
+		snprintf(errmsg, maxwrite, "Could not start the daemon.");
+	} else if ((client = fork()) == 0) {
+		freopen("/dev/null", "w", stdout);
+
+		if (chdir(dir) == 0)
+			execl(
+				assembler, "assembler", "--connect", socket_path, asm_path,
+				(char*) NULL
+			);
+
+		_exit(127);
+	} else if (
+		client < 0 || waitpid(client, &status, 0) != client ||
+		!WIFEXITED(status) || WEXITSTATUS(status) != 0
+	) {
+		snprintf(errmsg, maxwrite, "The client failed.");
+	} else if (stat(hack_path, &info) == 0) {
+		snprintf(errmsg, maxwrite, "The daemon wrote `%s'.", hack_path);
+	} else if (n2t_filemap_open(asm_path, &source)) {
+		snprintf(errmsg, maxwrite, "Could not read `%s'.", asm_path);
+	} else {
+		if (n2t_assemble_image(
+			source.data, source.length, NULL, &image, &expected, &length,
+			errmsg, maxwrite
+		)) {
+			// `errmsg' tells the reason.
+		} else if (n2t_filemap_open(bin_path, &output)) {
+			snprintf(
+				errmsg, maxwrite, "The daemon did not write `%s'.", bin_path
+			);
+		} else {
+			if (
+				output.length != length ||
+				memcmp(output.data, expected, length)
+			)
+				snprintf(
+					errmsg, maxwrite, "`%s' is not a ROM image of `%s'.",
+					bin_path, asm_path
+				);
+			else
+				error = 0;
+
+			n2t_filemap_close(&output);
+		}
+
+		free(expected);
+		n2t_filemap_close(&source);
+	}
+
+	if (daemon > 0) {
+		kill(daemon, SIGTERM);
+		waitpid(daemon, NULL, 0);
+	}
+
+	unlink(bin_path);
+	unlink(hack_path);
+	unlink(socket_path);
+	rmdir(dir);
+
+	return error;
+}
+
+int test_assembler_threads(void *const args, char errmsg[], size_t maxwrite) {
+	char *filenames[] = {"Max", "PongL", "Rect"};
+	size_t const filenames_no = sizeof(filenames) / sizeof(char*);
+	emitopts_t const formats[] = {{0, 0, ROMIMAGE_LITTLE}, {1, 1, ROMIMAGE_BIG}};
+	char const *extensions[] = {".hack", ".bin"};
+	char
+		cwd[PATH_MAX], assembler[PATH_MAX], dir[] = "/tmp/n2t_threads_XXXXXX",
+		asm_paths[3][PATH_MAX], out_path[BUFFSIZE_LARGE], *expected;
+	filemap_t source, output;
+	size_t length, i, j;
+	pid_t child;
+	int status, error = 0;
+
+	if (getcwd(cwd, PATH_MAX) == NULL || mkdtemp(dir) == NULL) {
+		snprintf(errmsg, maxwrite, "Could not create a temporary directory.");
+
+		return 1;
+	}
+
+	n2t_join(assembler, PATH_MAX, 2, cwd, "/assembler");
+
+	for (i = 0; i < filenames_no; i++) {
+		n2t_join(
+			asm_paths[i], PATH_MAX, 5, cwd, "/" TEST_DIR_ROOT,
+			"test_assembler_batch/", filenames[i], ".asm"
+		);
+	}
+
+	for (j = 0; j < 2 && !error; j++) {
+		// Outputs are written to the directory the assembler runs from.
+		if ((child = fork()) == 0) {
+			freopen("/dev/null", "w", stdout);
+
+			if (chdir(dir) == 0) {
+				if (formats[j].binary)
+					execl(
+						assembler, "assembler", "--threads=3", "--format=bin",
+						"--endian=big", "--header", asm_paths[0], asm_paths[1],
+						asm_paths[2], (char*) NULL
+					);
+				else
+					execl(
+						assembler, "assembler", "--threads=3", asm_paths[0],
+						asm_paths[1], asm_paths[2], (char*) NULL
+					);
+			}
+
+			_exit(127);
+		} else if (
+			child < 0 || waitpid(child, &status, 0) != child ||
+			!WIFEXITED(status) || WEXITSTATUS(status) != 0
+		) {
+			snprintf(errmsg, maxwrite, "The assembler failed.");
+			error = 1;
+		}
+
+		for (i = 0; i < filenames_no && !error; i++) {
+			n2t_join(
+				out_path, BUFFSIZE_LARGE, 4, dir, "/", filenames[i],
+				extensions[j]
+			);
+			expected = NULL;
+			error = 1;
+
+			if (n2t_filemap_open(asm_paths[i], &source)) {
+				snprintf(errmsg, maxwrite, "Could not read `%s'.", asm_paths[i]);
+				break;
+			}
+
+			if (n2t_assemble_image(
+				source.data, source.length, NULL, formats + j, &expected,
+				&length, errmsg, maxwrite
+			)) {
+				// `errmsg' tells the reason.
+			} else if (n2t_filemap_open(out_path, &output)) {
+				snprintf(errmsg, maxwrite, "Could not read `%s'.", out_path);
+			} else {
+				if (
+					output.length != length ||
+					memcmp(output.data, expected, length)
+				)
+					snprintf(
+						errmsg, maxwrite, "`%s' differs from a single-threaded"
+						" assembly.", out_path
+					);
+				else
+					error = 0;
+
+				n2t_filemap_close(&output);
+			}
+
+			free(expected);
+			n2t_filemap_close(&source);
+		}
+	}
+
+	for (j = 0; j < 2; j++) {
+		for (i = 0; i < filenames_no; i++) {
+			n2t_join(
+				out_path, BUFFSIZE_LARGE, 4, dir, "/", filenames[i],
+				extensions[j]
+			);
+			unlink(out_path);
+		}
+	}
+
+	rmdir(dir);
+
+	return error;
+}
+
+int test_assembler(void *const args, char errmsg[], size_t maxwrite) {
+	char **argv = args;
+	char
+		exp[BITSTR_BUFFSIZE + 2], actual[BITSTR_BUFFSIZE + 1],
+		instr_repr[BUFFSIZE_MED];
+	tokenseq_t *s;
+	token_t *t;
+
+	FILE *exp_stream;
+	size_t i, actual_lineno = 0, exp_lineno = 0;
+
+	if ((s = n2t_parse(argv[0], NULL, 0)) == NULL) {
+		snprintf(errmsg, maxwrite, "Could not parse `%s'.", argv[0]);
+
+		return 1;
+	}
+
+	if ((exp_stream = fopen(argv[1], "rt")) == NULL) {
+		snprintf(errmsg, maxwrite, "Could not open `%s'.", argv[1]);
+		n2t_tokenseq_free(s);
+
+		return 1;
+	}
+
+	for (i = 0; i < s->next; i++) {
+		t = n2t_tokenseq_index_get(s, i);
 
 		if (t->type == INSTR) {
 			// `BITSTR_BUFFSIZE + 1' is due to the newline.
@@ -633,7 +2756,9 @@ int test_assembler(void *const args, char errmsg[], size_t maxwrite) {
 		}
 
 		if (strncmp(actual, exp, BITSTR_BUFFSIZE)) {
-			n2t_instr_to_str(t->data.instr, instr_repr, BUFFSIZE_MED);
+			n2t_instr_to_str(
+				t->data.instr, s->labels, instr_repr, BUFFSIZE_MED
+			);
 			snprintf(
 				errmsg, maxwrite, "%s:%lu: wrong bitstring output: expected"
 				" `%s', got `%s'. Alleged instruction: `%s'.", argv[1],
@@ -0,0 +1,13 @@
+// The label LOOP is defined twice.
+@0
+D=M
+(LOOP)
+D=D-1
+@LOOP
+D;JGT
+(END)
+@END
+0;JMP
+(LOOP)
+@LOOP
+0;JMP
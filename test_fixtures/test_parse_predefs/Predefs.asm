@@ -0,0 +1,10 @@
+// Default, user-defined and allocated RAM variables.
+@SP
+@R15
+@SCREEN
+@FOO
+@counter
+@BAR
+@counter
+(R1)
+@R1
@@ -21,6 +21,11 @@
 // SOFTWARE.
 #include "utils.h"
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 int n2t_join(char *dest, size_t const maxwrite, size_t n, ...) {
@@ -163,3 +168,107 @@ char* n2t_filename(char *const filepath) {
 	else
 		return filepath;
 }
+
+
+int n2t_filemap_open(char const *filepath, filemap_t *dest) {
+	struct stat info;
+	size_t capacity = BUFFSIZE_XLARGE;
+	ssize_t nread;
+	char *data, *updated_data;
+	int fd;
+
+	if ((fd = open(filepath, O_RDONLY)) < 0)
+		return 1;
+
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+		dest->length = info.st_size;
+		dest->mapped = 1;
+
+		// Empty files can not be mapped, but neither need to.
+		if (dest->length == 0) {
+			dest->data = "";
+			close(fd);
+
+			return 0;
+		}
+
+		data = mmap(NULL, dest->length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (data != MAP_FAILED) {
+			madvise(data, dest->length, MADV_SEQUENTIAL);
+			dest->data = data;
+			close(fd);
+
+			return 0;
+		}
+
+		capacity = dest->length + 1;
+	}
+
+	// Fall back to reading the whole file, doubling the buffer as needed.
+	if ((data = malloc(capacity)) == NULL) {
+		close(fd);
+		return 1;
+	}
+
+	dest->length = 0;
+
+	while (
+		(nread = read(fd, data + dest->length, capacity - dest->length)) > 0
+	) {
+		dest->length += nread;
+
+		if (dest->length == capacity) {
+			if ((updated_data = realloc(data, capacity * 2)) == NULL) {
+				free(data);
+				close(fd);
+
+				return 1;
+			}
+
+			data = updated_data;
+			capacity *= 2;
+		}
+	}
+
+	close(fd);
+
+	if (nread < 0) {
+		free(data);
+		return 1;
+	}
+
+	dest->data = data;
+	dest->mapped = 0;
+
+	return 0;
+}
+
+void n2t_filemap_close(filemap_t *m) {
+	if (m->mapped && m->length > 0)
+		munmap((void*) m->data, m->length);
+	else if (!m->mapped)
+		free((void*) m->data);
+
+	m->data = NULL;
+	m->length = 0;
+}
+
+int n2t_write_all(int fd, void const *data, size_t len) {
+	char const *p = data;
+	ssize_t written;
+
+	while (len > 0) {
+		if ((written = write(fd, p, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return 1;
+		}
+
+		p += written;
+		len -= written;
+	}
+
+	return 0;
+}
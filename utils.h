@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 
 #define	BUFFSIZE_MICRO 16
@@ -36,10 +37,24 @@
 #define ASCII_LETTERS "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
 
 #define	MIN(a, b)	(a < b ? a: b)
+#define	MAX(a, b)	(a > b ? a: b)
 #define IS_IN(c, s)	(index(s, c) != NULL)
 #define	IS_SPACE(c)	(c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v')
 
 
+/**
+ * The read-only contents of a file, as loaded by `n2t_filemap_open()'.
+ *
+ * `mapped' tells whether `data' is a memory mapping of the file or a heap copy
+ * of it, for those files that can not be mapped (e.g. pipes).
+ */
+typedef struct {
+	char const *data;
+	size_t length;
+	uint8_t mapped;
+} filemap_t;
+
+
 /**
  * Joins `n' `char*' arguments to `dest', writing at most `maxwrite' bytes of
  * data.
@@ -109,5 +124,25 @@ int n2t_ends_with(char const *s, char const *end);
  */
 char* n2t_filename(char *const filepath);
 
+/**
+ * Loads the contents of `filepath' into `dest', memory mapping them whenever
+ * possible or reading them in a single block otherwise.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+int n2t_filemap_open(char const *filepath, filemap_t *dest);
+/**
+ * Releases the contents previously loaded by `n2t_filemap_open()'.
+ */
+void n2t_filemap_close(filemap_t *m);
+/**
+ * Writes the `len' bytes at `data' to the file descriptor `fd', retrying on
+ * partial writes and interruptions. A regular file normally takes a single
+ * `write()' call.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+int n2t_write_all(int fd, void const *data, size_t len);
+
 
 #endif
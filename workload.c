@@ -0,0 +1,424 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "workload.h"
+#include <stdio.h>
+#include <string.h>
+
+
+// Upper bound on the length of an instruction or label declaration, comments
+// and indentation aside.
+#define	WORKLOAD_MAX_INSTR 32
+// Characters of the generated comments, blanks included for realism.
+#define	WORKLOAD_COMMENT_CHARSET "abcdefghijklmnopqrstuvwxyz     "
+
+/**
+ * A mnemonic of the Hack specification and its bits, written down here rather
+ * than borrowed from the lexer so that the expected translation of a program
+ * does not share the assembler's mistakes.
+ */
+typedef struct {
+	char const *mnemonic;
+	uint16_t bits;
+} encoding_t;
+
+/**
+ * Generation state of `n2t_workload_generate()'.
+ *
+ * `text' holds `len' bytes of program out of `capacity'. `words' (if any)
+ * holds its first `pc' instructions, those at `pending' waiting for the
+ * address of label `nlabels', the next one to be declared. The first
+ * `nreachable' labels lie at `labels' within `WORKLOAD_MAX_ADDRESS'. `last'
+ * tells whether the line being generated is the last one, past which no label
+ * can be declared. `variables' holds the address of each variable, `0' until it is first
+ * referred to, and `nextvar' the address of the next one.
+ */
+typedef struct {
+	workload_t const *w;
+	uint64_t state;
+	char *text;
+	size_t len, capacity, pc, nlabels, nreachable, npending;
+	uint16_t *words, *labels, *variables, nextvar;
+	uint32_t *pending;
+	int last;
+} genstate_t;
+
+// The `comp' fragments, each preceded by the `a' bit.
+static encoding_t const COMPS[] = {
+	{"0", 0x2A}, {"1", 0x3F}, {"-1", 0x3A}, {"D", 0x0C}, {"A", 0x30},
+	{"!D", 0x0D}, {"!A", 0x31}, {"-D", 0x0F}, {"-A", 0x33}, {"D+1", 0x1F},
+	{"A+1", 0x37}, {"D-1", 0x0E}, {"A-1", 0x32}, {"D+A", 0x02}, {"D-A", 0x13},
+	{"A-D", 0x07}, {"D&A", 0x00}, {"D|A", 0x15}, {"M", 0x70}, {"!M", 0x71},
+	{"-M", 0x73}, {"M+1", 0x77}, {"M-1", 0x72}, {"D+M", 0x42}, {"D-M", 0x53},
+	{"M-D", 0x47}, {"D&M", 0x40}, {"D|M", 0x55}
+};
+static encoding_t const DESTS[] = {
+	{"M", 1}, {"D", 2}, {"MD", 3}, {"A", 4}, {"AM", 5}, {"AD", 6}, {"AMD", 7}
+};
+static encoding_t const JUMPS[] = {
+	{"JGT", 1}, {"JEQ", 2}, {"JGE", 3}, {"JLT", 4}, {"JNE", 5}, {"JLE", 6},
+	{"JMP", 7}
+};
+static encoding_t const PREDEFS[] = {
+	{"SP", 0}, {"LCL", 1}, {"ARG", 2}, {"THIS", 3}, {"THAT", 4}, {"R0", 0},
+	{"R1", 1}, {"R2", 2}, {"R3", 3}, {"R4", 4}, {"R5", 5}, {"R6", 6},
+	{"R7", 7}, {"R8", 8}, {"R9", 9}, {"R10", 10}, {"R11", 11}, {"R12", 12},
+	{"R13", 13}, {"R14", 14}, {"R15", 15}, {"SCREEN", 16384}, {"KBD", 24576}
+};
+
+#define	LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+/**
+ * Returns: the next pseudo-random number of `state', by SplitMix64.
+ */
+static uint64_t n2t_workload_next(uint64_t *state);
+/**
+ * Returns: a pseudo-random number of `g' in `[0, 1)'.
+ */
+static double n2t_workload_uniform(genstate_t *g);
+/**
+ * Returns: a pseudo-random number of `g' in `[0, n)'.
+ */
+static size_t n2t_workload_below(genstate_t *g, size_t n);
+/**
+ * Makes room in the text of `g' for `n' more bytes.
+ *
+ * Returns: `1' if an error occurs, `0' otherwise.
+ */
+static int n2t_workload_reserve(genstate_t *g, size_t n);
+/**
+ * Appends to the text of `g' up to `max' blanks.
+ */
+static void n2t_workload_indent(genstate_t *g, size_t max);
+/**
+ * Appends to the text of `g' a comment of up to `max_comment' characters.
+ */
+static void n2t_workload_comment(genstate_t *g);
+/**
+ * Declares the next label of `g' at the current instruction, resolving the
+ * A-instructions waiting for it.
+ */
+static void n2t_workload_label(genstate_t *g);
+/**
+ * Appends an A-instruction to `g', referring to a constant, a variable, a
+ * label or a predefined RAM variable.
+ */
+static void n2t_workload_Ainstr(genstate_t *g);
+/**
+ * Appends a C-instruction to `g', either storing its result or jumping.
+ */
+static void n2t_workload_Cinstr(genstate_t *g);
+/**
+ * Records `word' as the next instruction of `g'.
+ */
+static void n2t_workload_emit(genstate_t *g, uint16_t word);
+
+
+void n2t_workload_defaults(workload_t *w, size_t nlines, uint64_t seed) {
+	w->seed = seed;
+	w->nlines = nlines;
+	w->nvariables = 256;
+	w->max_indent = 8;
+	w->max_comment = 40;
+	w->label_density = 0.05;
+	w->comment_ratio = 0.1;
+	w->blank_ratio = 0.05;
+	w->trailing_ratio = 0.1;
+	w->cinstr_ratio = 0.5;
+	w->jump_ratio = 0.2;
+}
+
+int n2t_workload_generate(
+	workload_t const *w, char **src, size_t *len, char **hack, size_t *hacklen,
+	char errmsg[], size_t maxwrite
+) {
+	genstate_t g = {w, w->seed};
+	double const ratios[] = {
+		w->label_density, w->comment_ratio, w->blank_ratio, w->trailing_ratio,
+		w->cinstr_ratio, w->jump_ratio
+	};
+	size_t const line_max = w->max_indent + WORKLOAD_MAX_INSTR +
+		w->max_comment + 4;
+	double x;
+	size_t i, j;
+	int error = 0;
+
+	for (i = 0; i < LENGTH(ratios); i++)
+		error |= !(ratios[i] >= 0 && ratios[i] <= 1);
+
+	if (error) {
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "ratios must lie in [0, 1]");
+
+		return 1;
+	} else if (w->label_density + w->comment_ratio + w->blank_ratio > 1) {
+		if (errmsg) {
+			snprintf(
+				errmsg, maxwrite, "labels, comments and blank lines can not "
+				"make up more than all the lines"
+			);
+		}
+
+		return 1;
+	} else if (w->nvariables > WORKLOAD_MAX_VARIABLES) {
+		if (errmsg) {
+			snprintf(
+				errmsg, maxwrite, "at most %u variables fit in RAM",
+				WORKLOAD_MAX_VARIABLES
+			);
+		}
+
+		return 1;
+	}
+
+	g.nextvar = 16;
+	g.variables = calloc(w->nvariables + 1, sizeof(uint16_t));
+	g.labels = malloc((w->nlines + 1) * sizeof(uint16_t));
+	g.pending = malloc((WORKLOAD_MAX_ADDRESS + 1) * sizeof(uint32_t));
+
+	if (hack)
+		g.words = malloc((w->nlines + 1) * sizeof(uint16_t));
+
+	if (
+		g.variables == NULL || g.labels == NULL || g.pending == NULL ||
+		(hack && g.words == NULL) || n2t_workload_reserve(&g, line_max)
+	) {
+		error = 1;
+	}
+
+	for (i = 0; i < w->nlines && !error; i++) {
+		if ((error = n2t_workload_reserve(&g, line_max)))
+			break;
+
+		x = n2t_workload_uniform(&g);
+		g.last = i + 1 == w->nlines;
+
+		// A label referred to ahead is declared before it gets out of reach,
+		// and at the latest on the last line.
+		if (
+			g.npending &&
+			(g.pc >= WORKLOAD_MAX_ADDRESS || g.last)
+		) {
+			n2t_workload_label(&g);
+		} else if (x < w->label_density) {
+			n2t_workload_label(&g);
+		} else if ((x -= w->label_density) < w->comment_ratio) {
+			n2t_workload_indent(&g, w->max_indent);
+			n2t_workload_comment(&g);
+		} else if ((x -= w->comment_ratio) < w->blank_ratio) {
+			n2t_workload_indent(&g, w->max_indent);
+		} else {
+			n2t_workload_indent(&g, w->max_indent);
+
+			if (n2t_workload_uniform(&g) < w->cinstr_ratio)
+				n2t_workload_Cinstr(&g);
+			else
+				n2t_workload_Ainstr(&g);
+
+			if (n2t_workload_uniform(&g) < w->trailing_ratio) {
+				g.text[g.len++] = ' ';
+				n2t_workload_comment(&g);
+			}
+		}
+
+		g.text[g.len++] = '\n';
+	}
+
+	if (!error && hack) {
+		*hacklen = g.pc * 17;
+
+		if ((*hack = malloc(*hacklen + 1)) == NULL) {
+			error = 1;
+		} else {
+			for (i = 0; i < g.pc; i++) {
+				for (j = 0; j < 16; j++)
+					(*hack)[i * 17 + j] = '0' + ((g.words[i] >> (15 - j)) & 1);
+
+				(*hack)[i * 17 + 16] = '\n';
+			}
+		}
+	}
+
+	free(g.variables);
+	free(g.labels);
+	free(g.pending);
+	free(g.words);
+
+	if (error) {
+		free(g.text);
+
+		if (errmsg)
+			snprintf(errmsg, maxwrite, "could not allocate the program");
+
+		return 1;
+	}
+
+	*src = g.text;
+	*len = g.len;
+
+	return 0;
+}
+
+
+static uint64_t n2t_workload_next(uint64_t *state) {
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+}
+
+static double n2t_workload_uniform(genstate_t *g) {
+	return (n2t_workload_next(&g->state) >> 11) * (1.0 / (1ULL << 53));
+}
+
+static size_t n2t_workload_below(genstate_t *g, size_t n) {
+	return n ? n2t_workload_next(&g->state) % n: 0;
+}
+
+static int n2t_workload_reserve(genstate_t *g, size_t n) {
+	size_t capacity = g->capacity ? g->capacity: 4096;
+	char *text;
+
+	if (g->len + n <= g->capacity)
+		return 0;
+
+	while (capacity < g->len + n)
+		capacity *= 2;
+
+	if ((text = realloc(g->text, capacity)) == NULL)
+		return 1;
+
+	g->text = text;
+	g->capacity = capacity;
+
+	return 0;
+}
+
+static void n2t_workload_indent(genstate_t *g, size_t max) {
+	size_t n = n2t_workload_below(g, max + 1);
+
+	while (n--)
+		g->text[g->len++] = n2t_workload_below(g, 4) ? ' ': '\t';
+}
+
+static void n2t_workload_comment(genstate_t *g) {
+	size_t n = n2t_workload_below(g, g->w->max_comment + 1);
+
+	g->text[g->len++] = '/';
+	g->text[g->len++] = '/';
+
+	while (n--) {
+		g->text[g->len++] = WORKLOAD_COMMENT_CHARSET[
+			n2t_workload_below(g, sizeof(WORKLOAD_COMMENT_CHARSET) - 1)
+		];
+	}
+}
+
+static void n2t_workload_label(genstate_t *g) {
+	size_t i;
+
+	n2t_workload_indent(g, g->w->max_indent);
+	g->len += sprintf(g->text + g->len, "(L%lu)", g->nlabels++);
+
+	if (g->pc > WORKLOAD_MAX_ADDRESS)
+		return;
+
+	g->labels[g->nreachable++] = g->pc;
+
+	for (i = 0; g->words && i < g->npending; i++)
+		g->words[g->pending[i]] = g->pc;
+
+	g->npending = 0;
+}
+
+static void n2t_workload_Ainstr(genstate_t *g) {
+	// Labels ahead can only be referred to while they are sure to be reachable,
+	// and declared on a later line.
+	size_t const nlabels =
+		g->nreachable + (g->pc < WORKLOAD_MAX_ADDRESS && !g->last);
+	size_t kind = n2t_workload_below(g, 4), i;
+	uint16_t address;
+
+	if ((kind == 1 && g->w->nvariables == 0) || (kind == 2 && nlabels == 0))
+		kind = 0;
+
+	switch (kind) {
+		case 1:
+			i = n2t_workload_below(g, g->w->nvariables);
+
+			if (g->variables[i] == 0)
+				g->variables[i] = g->nextvar++;
+
+			address = g->variables[i];
+			g->len += sprintf(g->text + g->len, "@var%lu", i);
+			break;
+		case 2:
+			i = n2t_workload_below(g, nlabels);
+
+			if (i == g->nreachable) {
+				g->pending[g->npending++] = g->pc;
+				i = g->nlabels;
+			}
+
+			address = i < g->nreachable ? g->labels[i]: 0;
+			g->len += sprintf(g->text + g->len, "@L%lu", i);
+			break;
+		case 3:
+			i = n2t_workload_below(g, LENGTH(PREDEFS));
+			address = PREDEFS[i].bits;
+			g->len += sprintf(g->text + g->len, "@%s", PREDEFS[i].mnemonic);
+			break;
+		default:
+			address = n2t_workload_below(g, WORKLOAD_MAX_ADDRESS + 1);
+			g->len += sprintf(g->text + g->len, "@%u", address);
+			break;
+	}
+
+	n2t_workload_emit(g, address);
+}
+
+static void n2t_workload_Cinstr(genstate_t *g) {
+	encoding_t const *comp = &COMPS[n2t_workload_below(g, LENGTH(COMPS))];
+	encoding_t const *other;
+
+	if (n2t_workload_uniform(g) < g->w->jump_ratio) {
+		other = &JUMPS[n2t_workload_below(g, LENGTH(JUMPS))];
+		g->len += sprintf(
+			g->text + g->len, "%s;%s", comp->mnemonic, other->mnemonic
+		);
+		n2t_workload_emit(g, 0xE000 | (comp->bits << 6) | other->bits);
+	} else {
+		other = &DESTS[n2t_workload_below(g, LENGTH(DESTS))];
+		g->len += sprintf(
+			g->text + g->len, "%s=%s", other->mnemonic, comp->mnemonic
+		);
+		n2t_workload_emit(g, 0xE000 | (comp->bits << 6) | (other->bits << 3));
+	}
+}
+
+static void n2t_workload_emit(genstate_t *g, uint16_t word) {
+	if (g->words)
+		g->words[g->pc] = word;
+
+	g->pc++;
+}
@@ -0,0 +1,83 @@
+// MIT License
+// 
+// Copyright (c) 2018 Oscar
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+
+// Variables of a generated program, allocated from address 16 up to the
+// screen memory map.
+#define	WORKLOAD_MAX_VARIABLES (16384 - 16)
+// Largest ROM address an A-instruction can refer to.
+#define	WORKLOAD_MAX_ADDRESS 32767
+
+/**
+ * Parameters of a synthetic Hack program, generated pseudo-randomly from
+ * `seed': the same parameters always yield the same program.
+ *
+ * The program is `nlines' lines long. Each line declares a label with
+ * probability `label_density', is a comment with probability `comment_ratio',
+ * is blank with probability `blank_ratio' and holds an instruction otherwise.
+ * A-instructions refer in turn to constants, to `nvariables' distinct
+ * variables, to labels and to predefined RAM variables; C-instructions make
+ * up a `cinstr_ratio' share of the instructions, and jump rather than store
+ * their result in a `jump_ratio' share of the cases.
+ *
+ * Lines are indented by up to `max_indent' blanks, comments are up to
+ * `max_comment' characters long, both uniformly distributed, and
+ * instructions are followed by a comment with probability `trailing_ratio'.
+ */
+typedef struct {
+	uint64_t seed;
+	size_t nlines, nvariables, max_indent, max_comment;
+	double label_density, comment_ratio, blank_ratio, trailing_ratio;
+	double cinstr_ratio, jump_ratio;
+} workload_t;
+
+
+/**
+ * Sets up `w' with the parameters of a typical program of `nlines' lines,
+ * generated from `seed'.
+ */
+void n2t_workload_defaults(workload_t *w, size_t nlines, uint64_t seed);
+/**
+ * Generates the program described by `w'. Unless `hack' is `NULL', also
+ * computes its expected `.hack' translation, encoded independently of the
+ * assembler; labels beyond `WORKLOAD_MAX_ADDRESS' are thus never referred to.
+ *
+ * Param `src': receives the `*len' bytes of the program, to be freed by the
+ * caller.
+ * Param `hack': receives the `*hacklen' bytes of its translation, to be freed
+ * by the caller.
+ * Param `errmsg': receives a description of the error, if any, `maxwrite'
+ * bytes at most.
+ * Returns: `1' if `w' is invalid or an error occurs, `0' otherwise.
+ */
+int n2t_workload_generate(
+	workload_t const *w, char **src, size_t *len, char **hack, size_t *hacklen,
+	char errmsg[], size_t maxwrite
+);
+
+
+#endif